@@ -18,6 +18,7 @@ rm -f daemon/tests/cmake_install.cmake
 rm -f daemon/tests/CTestTestfile.cmake
 rm -f daemon/tests/Testing
 rm -f daemon/tests/daemon-test
+rm -f daemon/tests/browser-test
 
 rm -f demo/sink-test.wav
 
@@ -0,0 +1,407 @@
+//
+//  benchmark.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Microbenchmarks of the daemon parsers and serializers.
+ *
+ * Usage: daemon-benchmark [min_time_ms] [filter]
+ *
+ * Every benchmark whose name contains filter runs for at least min_time_ms
+ * (default 500) and the results are printed on stdout as a JSON document
+ * with the time per operation in nanoseconds, e.g.:
+ *
+ * { "arch": "x86_64", "compiler": "...", "benchmarks": [
+ *   { "name": "parse_sdp", "iterations": 262144, "ns_per_op": 1840.5 },
+ *   ...
+ * ] }
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+#include "driver_manager.hpp"
+#include "hash.hpp"
+#include "json.hpp"
+#include "log.hpp"
+#include "rtsp_server.hpp"
+#include "sap.hpp"
+#include "session_manager.hpp"
+#include "utils.hpp"
+
+/* results are accumulated here so that the calls cannot be optimized out */
+static volatile size_t g_sink;
+
+static const std::string g_sdp =
+    "v=0\n"
+    "o=- 4 0 IN IP4 10.0.0.12\n"
+    "s=ALSA (on ubuntu)_4\n"
+    "c=IN IP4 239.1.0.12/15\n"
+    "t=0 0\n"
+    "a=clock-domain:PTPv2 0\n"
+    "m=audio 5004 RTP/AVP 98\n"
+    "c=IN IP4 239.1.0.12/15\n"
+    "a=rtpmap:98 L16/48000/8\n"
+    "a=sync-time:0\n"
+    "a=framecount:48\n"
+    "a=ptime:1\n"
+    "a=mediaclk:direct=0\n"
+    "a=ts-refclk:ptp=IEEE1588-2008:00-1D-C1-FF-FE-11-22-33:0\n"
+    "a=recvonly\n";
+
+static const std::string g_rtsp_request =
+    "DESCRIBE rtsp://127.0.0.1:8854/by-name/ALSA%20(on%20ubuntu)_4 RTSP/1.0\r\n"
+    "CSeq: 312\r\n"
+    "User-Agent: daemon-benchmark\r\n"
+    "Accept: application/sdp\r\n"
+    "\r\n";
+
+/* expose the driver and session manager internals used by the benchmarks */
+class BenchmarkDriverManager : public DriverManager {
+ public:
+  BenchmarkDriverManager() { sample_rate = 48000; }
+};
+
+class BenchmarkSessionManager : public SessionManager {
+ public:
+  BenchmarkSessionManager(std::shared_ptr<DriverManager> driver,
+                          std::shared_ptr<Config> config)
+      : SessionManager(driver, config) {}
+
+  using SessionManager::get_source_sdp_;
+  using SessionManager::parse_sdp;
+};
+
+/* bitwise CRC16 used before the table driven one, kept as reference */
+static uint16_t crc16_bitwise(const uint8_t* p, size_t len) {
+  uint8_t x;
+  uint16_t crc = 0xFFFF;
+
+  while (len--) {
+    x = crc >> 8 ^ *p++;
+    x ^= x >> 4;
+    crc = (crc << 8) ^ (static_cast<uint16_t>(x << 12)) ^
+          (static_cast<uint16_t>(x << 5)) ^ (static_cast<uint16_t>(x));
+  }
+  return crc;
+}
+
+struct Result {
+  std::string name;
+  uint64_t iterations{0};
+  double ns_per_op{0};
+};
+
+/* run fn in batches, doubling them, until min_time_ms is reached */
+static Result run(const std::string& name,
+                  int min_time_ms,
+                  const std::function<size_t()>& fn) {
+  using namespace std::chrono;
+  Result res{name};
+  uint64_t batch = 1;
+  nanoseconds elapsed{0};
+  /* warm up */
+  g_sink = g_sink + fn();
+  while (elapsed < milliseconds(min_time_ms)) {
+    auto start = steady_clock::now();
+    for (uint64_t i = 0; i < batch; i++) {
+      g_sink = g_sink + fn();
+    }
+    elapsed += duration_cast<nanoseconds>(steady_clock::now() - start);
+    res.iterations += batch;
+    if (batch < (1 << 20)) {
+      batch *= 2;
+    }
+  }
+  res.ns_per_op = static_cast<double>(elapsed.count()) / res.iterations;
+  return res;
+}
+
+static const char* get_arch() {
+#if defined(__x86_64__)
+  return "x86_64";
+#elif defined(__i386__)
+  return "x86";
+#elif defined(__aarch64__)
+  return "aarch64";
+#elif defined(__arm__)
+  return "arm";
+#else
+  return "unknown";
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  int min_time_ms = argc > 1 ? std::atoi(argv[1]) : 500;
+  std::string filter = argc > 2 ? argv[2] : "";
+  if (min_time_ms <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [min_time_ms] [filter]"
+              << std::endl;
+    return 1;
+  }
+
+  auto config = std::make_shared<Config>();
+  config->set_log_severity(5);
+  config->set_syslog_proto("none");
+  config->set_ip_addr_str("10.0.0.12");
+  config->set_ip_addr(0x0a00000c);
+  config->set_interface_name("lo");
+  config->set_sample_rate(48000);
+  config->set_rtp_mcast_base("239.1.0.1");
+  config->set_sap_mcast_addr("239.255.255.255");
+  log_init(*config);
+
+  auto driver = std::make_shared<BenchmarkDriverManager>();
+  BenchmarkSessionManager session_manager(driver, config);
+
+  /* fixtures, the SDP refclk is not checked against the PTP status */
+  StreamInfo info;
+  info.ignore_refclk_gmid = true;
+  info.stream.m_byNbOfChannels = 8;
+  if (!session_manager.parse_sdp(g_sdp, info)) {
+    std::cerr << "Fatal: cannot parse the benchmark SDP" << std::endl;
+    return 1;
+  }
+  info.session_id = 4;
+  if (crc16(g_sdp) !=
+      crc16_bitwise(reinterpret_cast<const uint8_t*>(g_sdp.c_str()),
+                    g_sdp.length())) {
+    std::cerr << "Fatal: CRC16 mismatch" << std::endl;
+    return 1;
+  }
+
+  StreamSource source;
+  source.id = 4;
+  source.enabled = true;
+  source.name = "ALSA (on ubuntu)_4";
+  source.io = "Audio Device";
+  source.max_samples_per_packet = 48;
+  source.codec = "L16";
+  source.address = "239.1.0.12";
+  source.ttl = 15;
+  source.payload_type = 98;
+  source.dscp = 34;
+  source.map = {0, 1, 2, 3, 4, 5, 6, 7};
+
+  StreamSink sink;
+  sink.id = 4;
+  sink.name = "ALSA Sink 4";
+  sink.io = "Audio Device";
+  sink.use_sdp = true;
+  sink.sdp = g_sdp;
+  sink.delay = 576;
+  sink.map = {0, 1, 2, 3, 4, 5, 6, 7};
+
+  std::list<StreamSource> sources;
+  std::list<StreamSink> sinks;
+  for (uint8_t id = 0; id <= SessionManager::stream_id_max; id++) {
+    source.id = sink.id = id;
+    sources.push_back(source);
+    sinks.push_back(sink);
+  }
+  source.id = sink.id = 4;
+
+  SinkStreamStatus status;
+  status.is_receiving_rtp_packet = true;
+  status.min_time = 120;
+
+  SinkDelayTuning tuning;
+  tuning.mode = "recommend";
+  tuning.delay = 576;
+  tuning.recommended_delay = 384;
+  tuning.window.samples = 60;
+  tuning.history.resize(SessionManager::sink_delay_tuning_history_max,
+                        tuning.window);
+
+  std::list<SinkStatusSample> samples;
+  for (uint32_t t = 0; t < 3600; t += 10) {
+    samples.push_back({t, static_cast<uint8_t>(t % 20 ? 0x10 : 0x11),
+                       static_cast<int32_t>(t % 97)});
+  }
+
+  PTPConfig ptp_config{0, 48};
+  PTPStatus ptp_status{"locked", "00-1D-C1-FF-FE-11-22-33", 0, 1200, 1500};
+
+  RemoteSource remote;
+  remote.id = "d00d1c6b3a1d";
+  remote.source = "SAP";
+  remote.address = "10.0.0.12";
+  remote.name = "ALSA (on ubuntu)_4";
+  remote.sdp = g_sdp;
+  remote.last_seen = 1234;
+  remote.announce_period = 30;
+  remote.origins.push_back({"SAP", "sap:4660", "10.0.0.12", {}, {}, 1234, 30});
+  remote.origins.push_back(
+      {"mDNS", "rtsp:29b1", "10.0.0.12", remote.name, "local", 1200, 0});
+  std::list<RemoteSource> remotes(64, remote);
+
+  StreamJob job{12, "add_sink", 4, "done", {}, 3};
+  std::list<StreamJob> jobs(SessionManager::job_history_max, job);
+
+  const std::string config_json = config_to_json(*config);
+  const std::string source_json = source_to_json(source);
+  const std::string sink_json = sink_to_json(sink);
+  const std::string ptp_config_json = ptp_config_to_json(ptp_config);
+  const std::string sources_json = sources_to_json(sources);
+  const std::string sinks_json = sinks_to_json(sinks);
+  const std::string streams_json = streams_to_json(sources, sinks);
+
+  uint8_t sap_packet[SAP::max_length];
+  size_t sap_length = SAP::encode(true, 0x1234, 0x0a00000c, g_sdp, sap_packet);
+
+  /* benchmarks */
+  std::vector<std::pair<std::string, std::function<size_t()> > > benchmarks{
+      {"parse_sdp",
+       [&]() {
+         StreamInfo parsed;
+         parsed.ignore_refclk_gmid = true;
+         parsed.stream.m_byNbOfChannels = 8;
+         return session_manager.parse_sdp(g_sdp, parsed);
+       }},
+      {"get_source_sdp_",
+       [&]() { return session_manager.get_source_sdp_(4, info).length(); }},
+      {"sdp_get_subject", [&]() { return sdp_get_subject(g_sdp).length(); }},
+      {"crc16", [&]() { return crc16(g_sdp); }},
+      {"crc16_bitwise",
+       [&]() {
+         return crc16_bitwise(reinterpret_cast<const uint8_t*>(g_sdp.c_str()),
+                              g_sdp.length());
+       }},
+      {"hash64", [&]() { return hash64(g_sdp); }},
+      {"parse_url",
+       [&]() {
+         auto const [ok, protocol, host, port, path] =
+             parse_url("http://10.0.0.12:8080/api/sdp/by-name/source_4");
+         return ok + path.length();
+       }},
+      {"sap_encode",
+       [&]() {
+         uint8_t buffer[SAP::max_length];
+         return SAP::encode(true, 0x1234, 0x0a00000c, g_sdp, buffer);
+       }},
+      {"sap_decode",
+       [&]() {
+         bool is_announce;
+         uint16_t msg_id_hash;
+         uint32_t addr;
+         std::string sdp;
+         SAP::decode(sap_packet, sap_length, is_announce, msg_id_hash, addr,
+                     sdp);
+         return sdp.length();
+       }},
+      {"rtsp_parse_request",
+       [&]() {
+         std::string request;
+         std::vector<std::string> fields;
+         int32_t cseq{-1};
+         size_t consumed{0};
+         RtspSession::parse_request(g_rtsp_request.c_str(), request, fields,
+                                    cseq, consumed);
+         return consumed;
+       }},
+      {"config_to_json", [&]() { return config_to_json(*config).length(); }},
+      {"source_to_json", [&]() { return source_to_json(source).length(); }},
+      {"sink_to_json", [&]() { return sink_to_json(sink).length(); }},
+      {"sink_status_to_json",
+       [&]() { return sink_status_to_json(status).length(); }},
+      {"sink_delay_tuning_to_json",
+       [&]() { return sink_delay_tuning_to_json(tuning).length(); }},
+      {"sink_status_history_to_json",
+       [&]() { return sink_status_history_to_json(3600, samples).length(); }},
+      {"ptp_config_to_json",
+       [&]() { return ptp_config_to_json(ptp_config).length(); }},
+      {"ptp_status_to_json",
+       [&]() { return ptp_status_to_json(ptp_status).length(); }},
+      {"sources_to_json", [&]() { return sources_to_json(sources).length(); }},
+      {"sinks_to_json", [&]() { return sinks_to_json(sinks).length(); }},
+      {"streams_to_json",
+       [&]() { return streams_to_json(sources, sinks).length(); }},
+      {"remote_source_to_json",
+       [&]() { return remote_source_to_json(remote).length(); }},
+      {"remote_sources_to_json",
+       [&]() { return remote_sources_to_json(remotes).length(); }},
+      {"job_to_json", [&]() { return job_to_json(job).length(); }},
+      {"jobs_to_json", [&]() { return jobs_to_json(jobs).length(); }},
+      {"json_to_config",
+       [&]() { return json_to_config(config_json, *config).get_http_port(); }},
+      {"json_to_source",
+       [&]() { return json_to_source("4", source_json).name.length(); }},
+      {"json_to_sink",
+       [&]() { return json_to_sink("4", sink_json).sdp.length(); }},
+      {"json_to_ptp_config",
+       [&]() { return json_to_ptp_config(ptp_config_json).dscp; }},
+      {"json_to_sources",
+       [&]() {
+         std::list<StreamSource> parsed;
+         json_to_sources(sources_json, parsed);
+         return parsed.size();
+       }},
+      {"json_to_sinks",
+       [&]() {
+         std::list<StreamSink> parsed;
+         json_to_sinks(sinks_json, parsed);
+         return parsed.size();
+       }},
+      {"json_to_streams",
+       [&]() {
+         std::list<StreamSource> parsed_sources;
+         std::list<StreamSink> parsed_sinks;
+         json_to_streams(streams_json, parsed_sources, parsed_sinks);
+         return parsed_sources.size() + parsed_sinks.size();
+       }},
+  };
+
+  std::stringstream ss;
+  ss << "{\n  \"arch\": \"" << get_arch() << "\""
+     << ",\n  \"compiler\": \"" << __VERSION__ << "\""
+     << ",\n  \"min_time_ms\": " << min_time_ms
+     << ",\n  \"benchmarks\": [";
+  int count = 0;
+  for (auto const& [name, fn] : benchmarks) {
+    if (name.find(filter) == std::string::npos) {
+      continue;
+    }
+    Result res;
+    try {
+      res = run(name, min_time_ms, fn);
+    } catch (std::exception const& e) {
+      std::cerr << "Fatal: benchmark " << name << " failed: " << e.what()
+                << std::endl;
+      return 1;
+    }
+    if (count++) {
+      ss << ",";
+    }
+    ss << "\n    { \"name\": \"" << res.name << "\""
+       << ", \"iterations\": " << res.iterations
+       << ", \"ns_per_op\": " << std::fixed << std::setprecision(1)
+       << res.ns_per_op << " }";
+  }
+  ss << "\n  ]\n}\n";
+  std::cout << ss.str();
+  return 0;
+}
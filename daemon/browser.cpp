@@ -17,8 +17,14 @@
 //  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <sys/socket.h>
+
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <iomanip>
 
+#include "hash.hpp"
 #include "utils.hpp"
 #include "browser.hpp"
 
@@ -43,76 +49,389 @@ std::list<RemoteSource> Browser::get_remote_sources(
   std::shared_lock sources_lock(sources_mutex_);
   // return list of remote sources ordered by name
   for (const auto& source : sources_.get<name_tag>()) {
-    if (boost::iequals(source.source, _source) ||
-        boost::iequals("all", _source)) {
+    if (boost::iequals("all", _source) ||
+        std::any_of(source.origins.begin(), source.origins.end(),
+                    [&_source](const RemoteOrigin& origin) {
+                      return boost::iequals(origin.source, _source);
+                    })) {
       sources_list.push_back(source);
     }
   }
   return sources_list;
 }
 
-bool Browser::worker() {
-  sap_.set_multicast_interface(config_->get_ip_addr_str());
-  // Join SAP muticast address
-  igmp_.join(config_->get_ip_addr_str(), config_->get_sap_mcast_addr());
-  auto sap_timepoint = steady_clock::now();
-  int sap_interval = 10;
-  auto mdns_timepoint = steady_clock::now();
-  int mdns_interval = 10;
+BrowserStats Browser::get_stats() const {
+  std::shared_lock sources_lock(sources_mutex_);
+  BrowserStats stats{stats_};
+  stats.sources = sources_.size();
+  stats.sdp_bytes = sdp_bytes_;
+  return stats;
+}
 
-  while (running_) {
-    bool is_announce;
-    uint16_t msg_id_hash;
-    uint32_t addr;
-    std::string sdp;
+std::string Browser::get_origin_key(const RemoteOrigin& origin) {
+  /* mDNS ids change with the SDP, name and domain don't */
+  return origin.source == "mDNS" ? "mdns:" + origin.name + "@" + origin.domain
+                                 : origin.id;
+}
 
-    if (sap_.receive(is_announce, msg_id_hash, addr, sdp)) {
-      std::stringstream ss;
-      ss << "sap:" << msg_id_hash;
-      std::string id(ss.str());
-      BOOST_LOG_TRIVIAL(debug) << "browser:: received SAP message for " << id;
+/* source attributes not coming from the SDP are taken from the origins */
+static void update_from_origins(RemoteSource& source) {
+  const auto& first = source.origins.front();
+  source.source = first.source;
+  source.address = first.address;
+  source.interface = first.interface;
+  source.name =
+      first.source == "mDNS" ? first.name : sdp_get_subject(source.sdp);
+  source.domain.clear();
+  source.last_seen = 0;
+  source.announce_period = 0;
+  for (const auto& origin : source.origins) {
+    if (origin.source == "mDNS" && source.domain.empty()) {
+      source.domain = origin.domain;
+    }
+    if (origin.source == "SAP" && !source.announce_period) {
+      source.announce_period = origin.announce_period;
+    }
+    source.last_seen = std::max(source.last_seen, origin.last_seen);
+  }
+}
 
-      std::unique_lock sources_lock(sources_mutex_);
+/* the SDP must describe an AES67 compatible audio stream */
+static bool sdp_is_aes67(const std::string& sdp) {
+  bool connection = false;
+  bool media = false;
+  bool rtpmap = false;
+  std::stringstream ss(sdp);
+  std::string line;
+  while (getline(ss, line, '\n')) {
+    if (line.rfind("c=IN IP4 ", 0) == 0) {
+      connection = true;
+    } else if (line.rfind("m=audio ", 0) == 0) {
+      media = line.find(" RTP/AVP ") != std::string::npos;
+    } else if (line.rfind("a=rtpmap:", 0) == 0) {
+      rtpmap = rtpmap || line.find(" L16/") != std::string::npos ||
+               line.find(" L24/") != std::string::npos ||
+               line.find(" L32/") != std::string::npos ||
+               line.find(" AM824/") != std::string::npos;
+    }
+  }
+  return connection && media && rtpmap;
+}
+
+bool Browser::admit_(const RemoteOrigin& origin, const std::string& sdp) {
+  if (sdp.length() > config_->get_browser_max_sdp_bytes()) {
+    stats_.rejected_size++;
+    return false;
+  }
+  if (!allowed_subnets_.empty()) {
+    boost::system::error_code ec;
+    uint32_t addr = ip::address_v4::from_string(origin.address, ec).to_ulong();
+    if (ec || std::none_of(allowed_subnets_.begin(), allowed_subnets_.end(),
+                           [addr](const auto& subnet) {
+                             return (addr & subnet.second) == subnet.first;
+                           })) {
+      stats_.rejected_filtered++;
+      return false;
+    }
+  }
+  if (!allowed_domains_.empty() && origin.source == "mDNS" &&
+      std::none_of(allowed_domains_.begin(), allowed_domains_.end(),
+                   [&origin](const std::string& domain) {
+                     return boost::iequals(
+                         boost::trim_right_copy_if(origin.domain,
+                                                   boost::is_any_of(".")),
+                         domain);
+                   })) {
+    stats_.rejected_filtered++;
+    return false;
+  }
+  if (!std::get<0>(sdp_get_origin(sdp)) || !sdp_is_aes67(sdp)) {
+    stats_.rejected_invalid++;
+    return false;
+  }
+  return true;
+}
+
+void Browser::erase_origins_(const RemoteSource& source) {
+  for (const auto& origin : source.origins) {
+    origins_.erase(get_origin_key(origin));
+  }
+}
+
+void Browser::evict_(size_t sdp_length,
+                     const std::string& keep_id,
+                     notifications_t& notifications) {
+  auto& idx = sources_.get<last_seen_tag>();
+  auto it = idx.begin();
+  while (it != idx.end() &&
+         (sources_.size() >= config_->get_browser_max_sources() ||
+          sdp_bytes_ + sdp_length > config_->get_browser_max_sdp_bytes())) {
+    if (it->id == keep_id) {
+      ++it;
+      continue;
+    }
+    BOOST_LOG_TRIVIAL(info) << "browser:: evicting source " << it->id
+                            << " name " << it->name;
+    stats_.evicted++;
+    sdp_bytes_ -= it->sdp.length();
+    erase_origins_(*it);
+    notifications.emplace_back(ObserverType::remove_source, *it);
+    it = idx.erase(it);
+  }
+}
+
+void Browser::add_origin_(const RemoteOrigin& origin,
+                          const std::string& sdp,
+                          notifications_t& notifications) {
+  uint64_t sdp_hash = hash64(sdp);
+  auto key = get_origin_key(origin);
+  auto key_it = origins_.find(key);
+  auto it = key_it != origins_.end() ? sources_.find(key_it->second)
+                                     : sources_.end();
+  /* a refresh of an admitted SDP doesn't need to be checked again */
+  if ((it == sources_.end() || it->sdp_hash != sdp_hash) &&
+      !admit_(origin, sdp)) {
+    BOOST_LOG_TRIVIAL(debug) << "browser:: rejected " << origin.source
+                             << " source " << origin.id;
+    return;
+  }
+
+  auto [res, username, session_id, version, address] = sdp_get_origin(sdp);
+  std::string id;
+  if (res) {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0')
+       << hash64(username + " " + session_id + " " + address);
+    id = ss.str();
+  } else {
+    /* no origin in the SDP, cannot be merged */
+    id = origin.id;
+  }
+
+  if (key_it != origins_.end() && key_it->second != id) {
+    /* the origin now announces a different session */
+    remove_origin_(key, notifications);
+  }
+
+  it = sources_.find(id);
+  if (it == sources_.end()) {
+    evict_(sdp.length(), {}, notifications);
+    BOOST_LOG_TRIVIAL(info) << "browser:: adding " << origin.source
+                            << " source " << id << " origin " << origin.id;
+    RemoteSource source;
+    source.id = id;
+    source.sdp = sdp;
+    source.sdp_hash = sdp_hash;
+    source.origins.push_back(origin);
+    update_from_origins(source);
+    sources_.insert(source);
+    sdp_bytes_ += sdp.length();
+    origins_[key] = id;
+    notifications.emplace_back(ObserverType::add_source, source);
+    return;
+  }
+
+  auto upd_source{*it};
+  bool changed = false;
+  bool refreshed = false;
+  auto origin_it = std::find_if(
+      upd_source.origins.begin(), upd_source.origins.end(),
+      [&key](const RemoteOrigin& o) { return get_origin_key(o) == key; });
+  if (origin_it == upd_source.origins.end()) {
+    BOOST_LOG_TRIVIAL(info) << "browser:: adding " << origin.source
+                            << " origin " << origin.id << " to source " << id;
+    upd_source.origins.push_back(origin);
+    origins_[key] = id;
+    changed = true;
+  } else {
+    if (origin_it->id != origin.id || origin_it->address != origin.address) {
+      origin_it->id = origin.id;
+      origin_it->address = origin.address;
+      changed = true;
+    }
+    /* copies of a SAP announcement received via the other discovery
+     * interfaces don't refresh the origin, it is timed by the interface it
+     * was first learned on */
+    if (origin.interface == origin_it->interface &&
+        origin.last_seen != origin_it->last_seen) {
+      if (origin.source == "SAP") {
+        origin_it->announce_period = origin.last_seen - origin_it->last_seen;
+      }
+      origin_it->last_seen = origin.last_seen;
+      refreshed = true;
+    }
+  }
+
+  if (sdp_hash != upd_source.sdp_hash) {
+    /* with multiple origins keep the most recent version of the session */
+    auto [cur_res, cur_username, cur_session_id, cur_version, cur_address] =
+        sdp_get_origin(upd_source.sdp);
+    if (!cur_res || version >= cur_version || upd_source.origins.size() == 1) {
+      BOOST_LOG_TRIVIAL(info) << "browser:: updating " << origin.source
+                              << " source " << id << " SDP";
+      sdp_bytes_ += sdp.length();
+      sdp_bytes_ -= upd_source.sdp.length();
+      upd_source.sdp = sdp;
+      upd_source.sdp_hash = sdp_hash;
+      changed = true;
+    }
+  }
+
+  if (changed || refreshed) {
+    update_from_origins(upd_source);
+    sources_.replace(it, upd_source);
+    if (sdp_bytes_ > config_->get_browser_max_sdp_bytes()) {
+      evict_(0, id, notifications);
+    }
+  }
+  if (changed) {
+    notifications.emplace_back(ObserverType::update_source, upd_source);
+  }
+}
+
+void Browser::remove_origin_(const std::string& key,
+                             notifications_t& notifications) {
+  auto key_it = origins_.find(key);
+  if (key_it == origins_.end()) {
+    return;
+  }
+  auto it = sources_.find(key_it->second);
+  origins_.erase(key_it);
+  if (it == sources_.end()) {
+    return;
+  }
+
+  auto upd_source{*it};
+  upd_source.origins.remove_if(
+      [&key](const RemoteOrigin& o) { return get_origin_key(o) == key; });
+  if (upd_source.origins.empty()) {
+    BOOST_LOG_TRIVIAL(info) << "browser:: removing source " << it->id
+                            << " name " << it->name;
+    notifications.emplace_back(ObserverType::remove_source, *it);
+    sdp_bytes_ -= it->sdp.length();
+    sources_.erase(it);
+  } else {
+    BOOST_LOG_TRIVIAL(info) << "browser:: removing origin " << key
+                            << " from source " << it->id;
+    update_from_origins(upd_source);
+    sources_.replace(it, upd_source);
+    notifications.emplace_back(ObserverType::update_source, upd_source);
+  }
+}
 
-      auto it = sources_.get<id_tag>().find(id);
-      if (it == sources_.end()) {
-        // Source is not in the map
-        if (is_announce) {
-          // annoucement, add new source
-          sources_.insert(
-              {id,
-               "SAP",
-               ip::address_v4(ntohl(addr)).to_string(),
-               sdp_get_subject(sdp),
-               {},
-               sdp,
-               static_cast<uint32_t>(
-                   duration_cast<second_t>(steady_clock::now() - startup_)
-                       .count()),
-               config_->get_sap_interval()});
+bool Browser::open_sap_listener_(const DiscoveryInterface& intf,
+                                 bool bind_to_device) {
+  auto listener = std::make_unique<SapListener>(io_service_);
+  listener->interface_name = intf.name;
+  boost::system::error_code ec;
+  listener->socket.open(ip::udp::v4(), ec);
+  if (!ec) {
+    listener->socket.set_option(ip::udp::socket::reuse_address(true), ec);
+  }
+  /* receive only the SAP messages arrived on this interface */
+  if (!ec && bind_to_device &&
+      setsockopt(listener->socket.native_handle(), SOL_SOCKET,
+                 SO_BINDTODEVICE, intf.name.c_str(), intf.name.length()) < 0) {
+    ec.assign(errno, boost::system::system_category());
+  }
+  if (!ec) {
+    listener->socket.bind(ip::udp::endpoint(ip::address_v4::any(), SAP::port),
+                          ec);
+  }
+  if (ec) {
+    BOOST_LOG_TRIVIAL(error) << "browser:: cannot receive SAP on "
+                             << intf.name << " : " << ec.message();
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "browser:: receiving SAP on " << intf.name;
+  sap_receive_(*listener);
+  sap_listeners_.push_back(std::move(listener));
+  return true;
+}
+
+void Browser::sap_receive_(SapListener& listener) {
+  listener.socket.async_receive_from(
+      boost::asio::buffer(listener.buffer), listener.endpoint,
+      [this, &listener](const boost::system::error_code& ec,
+                        std::size_t length) {
+        if (ec == boost::asio::error::operation_aborted) {
+          return;
         }
-      } else {
-        // Source is already in the map
-        if (is_announce) {
-          BOOST_LOG_TRIVIAL(debug)
-              << "browser:: refreshing SAP source " << it->id;
-          // annoucement, update last seen and announce period
-          uint32_t last_seen =
-              duration_cast<second_t>(steady_clock::now() - startup_).count();
-          auto upd_source{*it};
-          if ((last_seen - upd_source.last_seen) != 0) {
-              upd_source.announce_period = last_seen - upd_source.last_seen;
-              upd_source.last_seen = last_seen;
-              sources_.replace(it, upd_source);
-          }
-        } else {
-          BOOST_LOG_TRIVIAL(info) << "browser:: removing SAP source " << it->id
-                                  << " name " << it->name;
-          // deletion, remove entry
-          sources_.erase(it);
+        bool is_announce;
+        uint16_t msg_id_hash;
+        uint32_t addr;
+        std::string sdp;
+        if (!ec && SAP::decode(listener.buffer.data(), length, is_announce,
+                               msg_id_hash, addr, sdp)) {
+          on_sap_message_(listener.interface_name, is_announce, msg_id_hash,
+                          addr, sdp);
         }
-      }
+        sap_receive_(listener);
+      });
+}
+
+void Browser::sap_tick_() {
+  sap_tick_timer_.expires_from_now(boost::posix_time::seconds(1));
+  sap_tick_timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (!ec) {
+      sap_tick_();
+    }
+  });
+}
+
+void Browser::on_sap_message_(const std::string& interface,
+                              bool is_announce,
+                              uint16_t msg_id_hash,
+                              uint32_t addr,
+                              const std::string& sdp) {
+  std::stringstream ss;
+  ss << "sap:" << msg_id_hash;
+  std::string id(ss.str());
+  BOOST_LOG_TRIVIAL(debug) << "browser:: received SAP message for " << id
+                           << " on " << interface;
+
+  notifications_t notifications;
+  std::unique_lock sources_lock(sources_mutex_);
+  if (is_announce) {
+    // annoucement, add new source or refresh the existing one
+    RemoteOrigin origin{
+        "SAP",
+        id,
+        ip::address_v4(ntohl(addr)).to_string(),
+        {},
+        {},
+        static_cast<uint32_t>(
+            duration_cast<second_t>(steady_clock::now() - startup_).count()),
+        config_->get_sap_interval(),
+        interface};
+    add_origin_(origin, sdp, notifications);
+  } else {
+    // deletion, remove origin
+    remove_origin_(id, notifications);
+  }
+  sources_lock.unlock();
+  notify(notifications);
+}
+
+bool Browser::worker() {
+  const auto& interfaces = config_->get_discovery_if_list();
+  for (const auto& intf : interfaces) {
+    /* with more interfaces each socket is bound to its own device */
+    if (!intf.ip_str.empty() &&
+        open_sap_listener_(intf, interfaces.size() > 1)) {
+      // Join SAP muticast address
+      igmp_.join(intf.ip_str, config_->get_sap_mcast_addr());
     }
+  }
+  sap_tick_();
+  auto sap_timepoint = steady_clock::now();
+  int sap_interval = 10;
+  auto mdns_timepoint = steady_clock::now();
+  int mdns_interval = 10;
+
+  while (running_) {
+    // handle a SAP message from any interface or wait for the next tick
+    io_service_.run_one();
 
     // check if it's time to update the SAP remote sources
     if ((duration_cast<second_t>(steady_clock::now() - sap_timepoint).count()) >
@@ -122,18 +441,24 @@ bool Browser::worker() {
       auto offset =
           duration_cast<second_t>(steady_clock::now() - startup_).count();
 
+      notifications_t notifications;
       std::unique_lock sources_lock(sources_mutex_);
-      for (auto it = sources_.begin(); it != sources_.end();) {
-        if (it->source == "SAP" &&
-            (offset - it->last_seen) > (it->announce_period * 10)) {
-          // remove from remote SAP sources
-          BOOST_LOG_TRIVIAL(info)
-              << "browser:: SAP source " << it->id << " timeout";
-          it = sources_.erase(it);
-        } else {
-          it++;
+      std::list<std::string> expired;
+      for (const auto& source : sources_) {
+        for (const auto& origin : source.origins) {
+          if (origin.source == "SAP" &&
+              (offset - origin.last_seen) > (origin.announce_period * 10)) {
+            BOOST_LOG_TRIVIAL(info)
+                << "browser:: SAP source " << origin.id << " timeout";
+            expired.push_back(origin.id);
+          }
         }
       }
+      for (const auto& key : expired) {
+        remove_origin_(key, notifications);
+      }
+      sources_lock.unlock();
+      notify(notifications);
     }
 
     // check if it's time to process the mDNS RTSP sources
@@ -144,60 +469,136 @@ bool Browser::worker() {
     }
   }
 
+  sap_tick_timer_.cancel();
+  for (auto& listener : sap_listeners_) {
+    boost::system::error_code ec;
+    listener->socket.close(ec);
+  }
+  /* run the aborted handlers before releasing the listeners */
+  io_service_.poll();
+  io_service_.reset();
+  sap_listeners_.clear();
+
   return true;
 }
 
+void Browser::add_observer(ObserverType type, Observer cb) {
+  switch (type) {
+    case ObserverType::add_source:
+      add_source_observers.push_back(cb);
+      break;
+    case ObserverType::update_source:
+      update_source_observers.push_back(cb);
+      break;
+    case ObserverType::remove_source:
+      remove_source_observers.push_back(cb);
+      break;
+  }
+}
+
+void Browser::notify(ObserverType type, const RemoteSource& source) const {
+  switch (type) {
+    case ObserverType::add_source:
+      for (auto cb : add_source_observers) {
+        cb(source);
+      }
+      break;
+    case ObserverType::update_source:
+      for (auto cb : update_source_observers) {
+        cb(source);
+      }
+      break;
+    case ObserverType::remove_source:
+      for (auto cb : remove_source_observers) {
+        cb(source);
+      }
+      break;
+  }
+}
+
+void Browser::notify(const notifications_t& notifications) const {
+  for (const auto& [type, source] : notifications) {
+    notify(type, source);
+  }
+}
+
 void Browser::on_change_rtsp_source(const std::string& name,
                                     const std::string& domain,
+                                    const std::string& interface,
                                     const RtspSource& s) {
-  uint32_t last_seen =
-      duration_cast<second_t>(steady_clock::now() - startup_).count();
+  RemoteOrigin origin{
+      s.source,
+      s.id,
+      s.address,
+      name,
+      domain,
+      static_cast<uint32_t>(
+          duration_cast<second_t>(steady_clock::now() - startup_).count()),
+      0,
+      interface};
+  notifications_t notifications;
   std::unique_lock sources_lock(sources_mutex_);
-  /* search by name */
-  auto rng = sources_.get<name_tag>().equal_range(name);
-  while (rng.first != rng.second) {
-    const auto& it = rng.first;
-    if (it->source == "mDNS" && it->domain == domain) {
-      /* mDNS source with same name and domain -> update */
-      BOOST_LOG_TRIVIAL(info) << "browser:: updating RTSP source " << s.id
-                              << " name " << name << " domain " << domain;
-      auto upd_source{*it};
-      upd_source.id = s.id;
-      upd_source.sdp = s.sdp;
-      upd_source.address = s.address;
-      upd_source.last_seen = last_seen;
-      sources_.get<name_tag>().replace(it, upd_source);
-      return;
-    }
-    ++rng.first;
-  }
-  /* entry not found -> add */
-  BOOST_LOG_TRIVIAL(info) << "browser:: adding RTSP source " << s.id << " name "
-                          << name << " domain " << domain;
-  sources_.insert(
-      {s.id, s.source, s.address, name, domain, s.sdp, last_seen, 0});
+  add_origin_(origin, s.sdp, notifications);
+  sources_lock.unlock();
+  notify(notifications);
 }
 
 void Browser::on_remove_rtsp_source(const std::string& name,
                                     const std::string& domain) {
+  notifications_t notifications;
   std::unique_lock sources_lock(sources_mutex_);
-  auto& name_idx = sources_.get<name_tag>();
-  auto rng = name_idx.equal_range(name);
-  while (rng.first != rng.second) {
-    const auto& it = rng.first;
-    if (it->source == "mDNS" && it->domain == domain) {
-      BOOST_LOG_TRIVIAL(info)
-          << "browser:: removing RTSP source " << it->id << " name " << it->name
-          << " domain " << it->domain;
-      name_idx.erase(it);
-      break;
+  remove_origin_(get_origin_key({"mDNS", {}, {}, name, domain, 0, 0, {}}),
+                 notifications);
+  sources_lock.unlock();
+  notify(notifications);
+}
+
+void Browser::init_filters_() {
+  allowed_subnets_.clear();
+  std::vector<std::string> items;
+  auto subnets = config_->get_browser_allowed_subnets();
+  boost::trim(subnets);
+  if (!subnets.empty()) {
+    boost::split(items, subnets, boost::is_any_of(" "),
+                 boost::token_compress_on);
+  }
+  for (const auto& item : items) {
+    /* a.b.c.d/len */
+    auto pos = item.find('/');
+    boost::system::error_code ec;
+    auto net = ip::address_v4::from_string(item.substr(0, pos), ec);
+    int len = 32;
+    try {
+      if (pos != std::string::npos) {
+        len = std::stoi(item.substr(pos + 1));
+      }
+    } catch (...) {
+      len = -1;
+    }
+    if (ec || len < 0 || len > 32) {
+      BOOST_LOG_TRIVIAL(error)
+          << "browser:: invalid allowed subnet " << item << ", ignored";
+      continue;
+    }
+    uint32_t mask = len ? ~0U << (32 - len) : 0;
+    allowed_subnets_.emplace_back(net.to_ulong() & mask, mask);
+  }
+  allowed_domains_.clear();
+  auto domains = config_->get_browser_allowed_domains();
+  boost::trim(domains);
+  if (!domains.empty()) {
+    boost::split(items, domains, boost::is_any_of(" "),
+                 boost::token_compress_on);
+    for (const auto& item : items) {
+      allowed_domains_.push_back(
+          boost::trim_right_copy_if(item, boost::is_any_of(".")));
     }
-    ++rng.first;
   }
 }
 
 bool Browser::init() {
   if (!running_) {
+    init_filters_();
     /* init mDNS client */
     if (config_->get_mdns_enabled() && !MDNSClient::init()) {
       return false;
@@ -25,11 +25,14 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
+#include <array>
 #include <chrono>
 #include <future>
 #include <list>
+#include <memory>
 #include <shared_mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "config.hpp"
 #include "igmp.hpp"
@@ -38,15 +41,44 @@
 
 using namespace boost::multi_index;
 
+/* discovery method of a remote source */
+struct RemoteOrigin {
+  std::string source;  /* SAP or mDNS */
+  std::string id;      /* sap:<msg id hash> or rtsp:<crc16> */
+  std::string address;
+  std::string name;    /* mDNS only */
+  std::string domain;  /* mDNS only */
+  uint32_t last_seen{0};       /* seconds from daemon startup */
+  uint32_t announce_period{0}; /* period between annoucements */
+  std::string interface;       /* discovery network interface */
+};
+
+/*
+ * Remote session identified by the SDP origin (o= username, session id and
+ * unicast address), the same session discovered via SAP and via mDNS is
+ * a single source with two origins.
+ */
 struct RemoteSource {
   std::string id;
-  std::string source;
-  std::string address;
+  std::string source;  /* first origin */
+  std::string address;   /* first origin */
+  std::string interface; /* first origin */
   std::string name;
   std::string domain; /* mDNS only */
   std::string sdp;
   uint32_t last_seen{0};       /* seconds from daemon startup */
-  uint32_t announce_period{0}; /* period between annoucements */
+  uint32_t announce_period{0}; /* period between SAP annoucements */
+  uint64_t sdp_hash{0};        /* internal only, used to detect SDP changes */
+  std::list<RemoteOrigin> origins;
+};
+
+struct BrowserStats {
+  size_t sources{0};
+  size_t sdp_bytes{0};
+  uint64_t rejected_invalid{0};  /* SDP not AES67 compatible */
+  uint64_t rejected_filtered{0}; /* subnet or domain not allowed */
+  uint64_t rejected_size{0};     /* SDP larger than the catalog */
+  uint64_t evicted{0};
 };
 
 class Browser : public MDNSClient {
@@ -62,16 +94,60 @@ class Browser : public MDNSClient {
 
   std::list<RemoteSource> get_remote_sources(
       const std::string& source = "all") const;
+  BrowserStats get_stats() const;
+
+  enum class ObserverType { add_source, update_source, remove_source };
+  using Observer = std::function<void(const RemoteSource& source)>;
+  void add_observer(ObserverType type, Observer cb);
 
  protected:
   // singleton, use create() to build
   Browser(std::shared_ptr<Config> config)
       : MDNSClient(config), startup_(std::chrono::steady_clock::now()){};
 
+  using notifications_t = std::list<std::pair<ObserverType, RemoteSource> >;
+
   bool worker();
+  void notify(ObserverType type, const RemoteSource& source) const;
+  void notify(const notifications_t& notifications) const;
+
+  /* origins are identified by the SAP id or by the mDNS name and domain */
+  static std::string get_origin_key(const RemoteOrigin& origin);
+  /* add or refresh the origin, called with sources_mutex_ held */
+  void add_origin_(const RemoteOrigin& origin,
+                   const std::string& sdp,
+                   notifications_t& notifications);
+  void remove_origin_(const std::string& key, notifications_t& notifications);
+  /* admission filters, called with sources_mutex_ held */
+  void init_filters_();
+  bool admit_(const RemoteOrigin& origin, const std::string& sdp);
+  /* evict the least recently seen sources other than keep_id until there is
+   * room for a source and sdp_length bytes, called with sources_mutex_ held */
+  void evict_(size_t sdp_length,
+              const std::string& keep_id,
+              notifications_t& notifications);
+  void erase_origins_(const RemoteSource& source);
+
+  /* SAP socket of a discovery interface */
+  struct SapListener {
+    explicit SapListener(io_service& io_service) : socket(io_service) {}
+    std::string interface_name;
+    ip::udp::socket socket;
+    ip::udp::endpoint endpoint;
+    std::array<uint8_t, SAP::max_length> buffer;
+  };
+  bool open_sap_listener_(const DiscoveryInterface& intf, bool bind_to_device);
+  void sap_receive_(SapListener& listener);
+  void on_sap_message_(const std::string& interface,
+                       bool is_announce,
+                       uint16_t msg_id_hash,
+                       uint32_t addr,
+                       const std::string& sdp);
+  void sap_tick_();
 
   virtual void on_change_rtsp_source(const std::string& name,
                                      const std::string& domain,
+                                     const std::string& interface,
                                      const RtspSource& source) override;
   virtual void on_remove_rtsp_source(const std::string& name,
                                      const std::string& domain) override;
@@ -88,13 +164,35 @@ class Browser : public MDNSClient {
   using by_name = ordered_non_unique<
       tag<name_tag>,
       member<RemoteSource, std::string, &RemoteSource::name>>;
+  struct last_seen_tag {};
+  using by_last_seen = ordered_non_unique<
+      tag<last_seen_tag>,
+      member<RemoteSource, uint32_t, &RemoteSource::last_seen>>;
   using sources_t =
-      multi_index_container<RemoteSource, indexed_by<by_id, by_name>>;
+      multi_index_container<RemoteSource,
+                            indexed_by<by_id, by_name, by_last_seen>>;
 
   sources_t sources_;
+  /* origin key to source id */
+  std::unordered_map<std::string, std::string> origins_;
+  size_t sdp_bytes_{0};
+  BrowserStats stats_;
   mutable std::shared_mutex sources_mutex_;
 
-  SAP sap_{config_->get_sap_mcast_addr()};
+  /* admission filters, from config */
+  std::list<std::pair<uint32_t /* net */, uint32_t /* mask */>>
+      allowed_subnets_;
+  std::list<std::string> allowed_domains_;
+
+  std::list<Observer> add_source_observers;
+  std::list<Observer> update_source_observers;
+  std::list<Observer> remove_source_observers;
+
+  /* the SAP sockets of all the discovery interfaces share the worker
+   * reactor, the tick wakes it up for the periodic checks */
+  io_service io_service_;
+  deadline_timer sap_tick_timer_{io_service_};
+  std::list<std::unique_ptr<SapListener> > sap_listeners_;
   IGMP igmp_;
   std::chrono::time_point<std::chrono::steady_clock> startup_;
 };
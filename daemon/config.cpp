@@ -21,10 +21,12 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/foreach.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <algorithm>
 #include <exception>
 #include <iostream>
 #include <sstream>
@@ -69,6 +71,14 @@ std::shared_ptr<Config> Config::parse(const std::string& filename) {
   if (ec) {
     config.rtp_mcast_base_ = "239.1.0.1";
   }
+  /* the pool must be non empty and within the multicast range */
+  auto mcast_base =
+      ip::address_v4::from_string(config.rtp_mcast_base_.c_str()).to_ulong();
+  if (config.rtp_mcast_pool_size_ == 0)
+    config.rtp_mcast_pool_size_ = 256;
+  if (mcast_base < 0xf0000000 &&
+      mcast_base + config.rtp_mcast_pool_size_ > 0xf0000000)
+    config.rtp_mcast_pool_size_ = 0xf0000000 - mcast_base;
   ip::address_v4::from_string(config.sap_mcast_addr_.c_str(), ec);
   if (ec) {
     config.sap_mcast_addr_ = "224.2.127.254";
@@ -76,6 +86,28 @@ std::shared_ptr<Config> Config::parse(const std::string& filename) {
   if (config.ptp_domain_ > 127)
     if (config.ptp_domain_ > 127)
       config.ptp_domain_ = 0;
+  if (config.sink_delay_tuning_ != "off" &&
+      config.sink_delay_tuning_ != "recommend" &&
+      config.sink_delay_tuning_ != "apply")
+    config.sink_delay_tuning_ = "off";
+  if (config.sink_delay_tuning_window_ < 10 ||
+      config.sink_delay_tuning_window_ > 3600)
+    config.sink_delay_tuning_window_ = 60;
+  if (config.sink_delay_tuning_margin_ > 4000)
+    config.sink_delay_tuning_margin_ = 48;
+  if (config.sink_status_history_hours_ > 24)
+    config.sink_status_history_hours_ = 24;
+  if (config.driver_backend_ != "kernel" &&
+      config.driver_backend_ != "userspace")
+    config.driver_backend_ = "kernel";
+  if (config.driver_channels_ == 0 || config.driver_channels_ > 64)
+    config.driver_channels_ = 8;
+  if (config.browser_max_sources_ == 0)
+    config.browser_max_sources_ = 512;
+  if (config.browser_max_sdp_bytes_ < 4096)
+    config.browser_max_sdp_bytes_ = 524288;
+  if (config.sdp_url_watch_interval_ && config.sdp_url_watch_interval_ < 5)
+    config.sdp_url_watch_interval_ = 5;
 
   auto [mac_addr, mac_str] = get_interface_mac(config.interface_name_);
   if (mac_str.empty()) {
@@ -103,6 +135,32 @@ std::shared_ptr<Config> Config::parse(const std::string& filename) {
     config.ip_str_ = ip_str;
   }
 
+  /* discovery always runs on interface_name */
+  config.discovery_if_list_.clear();
+  config.discovery_if_list_.push_back(
+      {config.interface_name_, config.ip_str_, interface_idx});
+  std::vector<std::string> names;
+  auto interfaces = boost::trim_copy(config.discovery_interfaces_);
+  if (!interfaces.empty()) {
+    boost::split(names, interfaces, boost::is_any_of(" "),
+                 boost::token_compress_on);
+  }
+  for (const auto& name : names) {
+    if (std::any_of(config.discovery_if_list_.begin(),
+                    config.discovery_if_list_.end(),
+                    [&name](const auto& intf) { return intf.name == name; })) {
+      continue;
+    }
+    auto idx = get_interface_index(name);
+    auto [addr, addr_str] = get_interface_ip(name);
+    if (idx < 0 || addr_str.empty()) {
+      std::cerr << "Cannot retrieve IPv4 address for discovery interface "
+                << name << ", ignored" << std::endl;
+      continue;
+    }
+    config.discovery_if_list_.push_back({name, addr_str, idx});
+  }
+
   config.config_filename_ = filename;
   config.need_restart_ = false;
 
@@ -21,9 +21,17 @@
 #define _CONFIG_HPP_
 
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <string>
 
+/* network interface used by SAP and mDNS discovery */
+struct DiscoveryInterface {
+  std::string name;
+  std::string ip_str;
+  int idx{-1};
+};
+
 class Config {
  public:
   /* save new config to json file */
@@ -42,6 +50,7 @@ class Config {
   uint32_t get_sample_rate() const { return sample_rate_; };
   const std::string& get_rtp_mcast_base() const { return rtp_mcast_base_; };
   const std::string& get_sap_mcast_addr() const { return sap_mcast_addr_; };
+  uint16_t get_rtp_mcast_pool_size() const { return rtp_mcast_pool_size_; };
   uint16_t get_rtp_port() const { return rtp_port_; };
   uint8_t get_ptp_domain() const { return ptp_domain_; };
   uint8_t get_ptp_dscp() const { return ptp_dscp_; };
@@ -51,6 +60,42 @@ class Config {
   const std::string& get_status_file() const { return status_file_; };
   const std::string& get_interface_name() const { return interface_name_; };
   const std::string& get_config_filename() const { return config_filename_; };
+  const std::string& get_sink_delay_tuning() const {
+    return sink_delay_tuning_;
+  };
+  uint16_t get_sink_delay_tuning_window() const {
+    return sink_delay_tuning_window_;
+  };
+  uint16_t get_sink_delay_tuning_margin() const {
+    return sink_delay_tuning_margin_;
+  };
+  uint8_t get_sink_status_history_hours() const {
+    return sink_status_history_hours_;
+  };
+  const std::string& get_driver_backend() const { return driver_backend_; };
+  const std::string& get_driver_playback_path() const {
+    return driver_playback_path_;
+  };
+  const std::string& get_driver_capture_path() const {
+    return driver_capture_path_;
+  };
+  uint8_t get_driver_channels() const { return driver_channels_; };
+  uint16_t get_browser_max_sources() const { return browser_max_sources_; };
+  uint32_t get_browser_max_sdp_bytes() const {
+    return browser_max_sdp_bytes_;
+  };
+  const std::string& get_browser_allowed_subnets() const {
+    return browser_allowed_subnets_;
+  };
+  const std::string& get_browser_allowed_domains() const {
+    return browser_allowed_domains_;
+  };
+  const std::string& get_discovery_interfaces() const {
+    return discovery_interfaces_;
+  };
+  uint16_t get_sdp_url_watch_interval() const {
+    return sdp_url_watch_interval_;
+  };
 
   /* attributes set during init */
   const std::array<uint8_t, 6>& get_mac_addr() const { return mac_addr_; };
@@ -60,6 +105,10 @@ class Config {
   bool get_need_restart() const { return need_restart_; };
   bool get_mdns_enabled() const { return mdns_enabled_; };
   int get_interface_idx() { return interface_idx_; };
+  /* interface_name followed by the other discovery interfaces */
+  const std::list<DiscoveryInterface>& get_discovery_if_list() const {
+    return discovery_if_list_;
+  };
 
   void set_http_port(uint16_t http_port) { http_port_ = http_port; };
   void set_rtsp_port(uint16_t rtsp_port) { rtsp_port_ = rtsp_port; };
@@ -83,6 +132,9 @@ class Config {
   void set_sap_mcast_addr(const std::string& sap_mcast_addr) {
     sap_mcast_addr_ = sap_mcast_addr;
   };
+  void set_rtp_mcast_pool_size(uint16_t rtp_mcast_pool_size) {
+    rtp_mcast_pool_size_ = rtp_mcast_pool_size;
+  };
   void set_rtp_port(uint16_t rtp_port) { rtp_port_ = rtp_port; };
   void set_ptp_domain(uint8_t ptp_domain) { ptp_domain_ = ptp_domain; };
   void set_ptp_dscp(uint8_t ptp_dscp) { ptp_dscp_ = ptp_dscp; };
@@ -101,6 +153,46 @@ class Config {
   void set_interface_name(const std::string& interface_name) {
     interface_name_ = interface_name;
   };
+  void set_sink_delay_tuning(const std::string& sink_delay_tuning) {
+    sink_delay_tuning_ = sink_delay_tuning;
+  };
+  void set_sink_delay_tuning_window(uint16_t window) {
+    sink_delay_tuning_window_ = window;
+  };
+  void set_sink_delay_tuning_margin(uint16_t margin) {
+    sink_delay_tuning_margin_ = margin;
+  };
+  void set_sink_status_history_hours(uint8_t hours) {
+    sink_status_history_hours_ = hours;
+  };
+  void set_driver_backend(const std::string& backend) {
+    driver_backend_ = backend;
+  };
+  void set_driver_playback_path(const std::string& path) {
+    driver_playback_path_ = path;
+  };
+  void set_driver_capture_path(const std::string& path) {
+    driver_capture_path_ = path;
+  };
+  void set_driver_channels(uint8_t channels) { driver_channels_ = channels; };
+  void set_browser_max_sources(uint16_t max_sources) {
+    browser_max_sources_ = max_sources;
+  };
+  void set_browser_max_sdp_bytes(uint32_t max_sdp_bytes) {
+    browser_max_sdp_bytes_ = max_sdp_bytes;
+  };
+  void set_browser_allowed_subnets(const std::string& subnets) {
+    browser_allowed_subnets_ = subnets;
+  };
+  void set_browser_allowed_domains(const std::string& domains) {
+    browser_allowed_domains_ = domains;
+  };
+  void set_discovery_interfaces(const std::string& interfaces) {
+    discovery_interfaces_ = interfaces;
+  };
+  void set_sdp_url_watch_interval(uint16_t interval) {
+    sdp_url_watch_interval_ = interval;
+  };
   void set_ip_addr_str(const std::string& ip_str) { ip_str_ = ip_str; };
   void set_ip_addr(uint32_t ip_addr) { ip_addr_ = ip_addr; };
   void set_mac_addr_str(const std::string& mac_str) { mac_str_ = mac_str; };
@@ -109,6 +201,9 @@ class Config {
   };
   void set_mdns_enabled(bool enabled) { mdns_enabled_ = enabled; };
   void set_interface_idx(int index) { interface_idx_ = index; };
+  void set_discovery_if_list(const std::list<DiscoveryInterface>& list) {
+    discovery_if_list_ = list;
+  };
 
  private:
   /* from json */
@@ -122,6 +217,7 @@ class Config {
   uint32_t sample_rate_{48000};
   std::string rtp_mcast_base_{"239.1.0.1"};
   std::string sap_mcast_addr_{"224.2.127.254"};
+  uint16_t rtp_mcast_pool_size_{256};
   uint16_t rtp_port_{5004};
   uint8_t ptp_domain_{0};
   uint8_t ptp_dscp_{46};
@@ -131,6 +227,20 @@ class Config {
   std::string status_file_{"./status.json"};
   std::string interface_name_{"eth0"};
   bool mdns_enabled_{true};
+  std::string sink_delay_tuning_{"off"}; /* off, recommend or apply */
+  uint16_t sink_delay_tuning_window_{60};
+  uint16_t sink_delay_tuning_margin_{48};
+  uint8_t sink_status_history_hours_{24}; /* 0 to disable */
+  std::string driver_backend_{"kernel"}; /* kernel or userspace */
+  std::string driver_playback_path_{""};
+  std::string driver_capture_path_{""};
+  uint8_t driver_channels_{8};
+  uint16_t browser_max_sources_{512};
+  uint32_t browser_max_sdp_bytes_{524288};
+  std::string browser_allowed_subnets_{""}; /* empty for all */
+  std::string browser_allowed_domains_{""}; /* empty for all */
+  std::string discovery_interfaces_{""};    /* in addition to interface_name */
+  uint16_t sdp_url_watch_interval_{0};      /* secs, 0 to disable */
 
   /* set during init */
   std::array<uint8_t, 6> mac_addr_{0, 0, 0, 0, 0, 0};
@@ -138,6 +248,7 @@ class Config {
   uint32_t ip_addr_{0};
   std::string ip_str_;
   int interface_idx_;
+  std::list<DiscoveryInterface> discovery_if_list_;
   std::string config_filename_;
 
   /* reconfig needs daemon restart */
@@ -0,0 +1,181 @@
+//
+//  daemon_core.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdexcept>
+
+#include "http_server.hpp"
+#include "interface.hpp"
+#include "log.hpp"
+#include "mdns_server.hpp"
+#include "rtsp_server.hpp"
+#include "daemon_core.hpp"
+
+static std::string version("bondagit-1.3.1");
+
+const std::string& get_version() {
+  return version;
+}
+
+DaemonCore::DaemonCore(std::shared_ptr<Config> config, bool http_enabled)
+    : config_(config), http_enabled_(http_enabled) {
+  driver_ = DriverManager::create();
+  if (driver_ == nullptr) {
+    throw std::runtime_error(std::string("DriverManager:: create failed"));
+  }
+  session_manager_ = SessionManager::create(driver_, config_);
+  if (session_manager_ == nullptr) {
+    throw std::runtime_error(std::string("SessionManager:: create failed"));
+  }
+  browser_ = Browser::create(config_);
+  if (browser_ == nullptr) {
+    throw std::runtime_error(std::string("Browser:: create failed"));
+  }
+
+  /* remote sessions are tracked to avoid multicast address collisions */
+  auto on_remote_source = [this](const RemoteSource& source) {
+    session_manager_->add_remote_session(source.id, source.address,
+                                         source.sdp);
+  };
+  browser_->add_observer(Browser::ObserverType::add_source, on_remote_source);
+  browser_->add_observer(Browser::ObserverType::update_source,
+                         on_remote_source);
+  browser_->add_observer(Browser::ObserverType::remove_source,
+                         [this](const RemoteSource& source) {
+                           session_manager_->remove_remote_session(source.id);
+                         });
+}
+
+DaemonCore::~DaemonCore() {
+  try {
+    terminate();
+  } catch (std::exception& e) {
+    BOOST_LOG_TRIVIAL(error) << "daemon_core:: terminate failed: " << e.what();
+  }
+}
+
+void DaemonCore::init() {
+  if (running_) {
+    return;
+  }
+
+  /* setup and init driver */
+  if (!driver_->init(*config_)) {
+    throw std::runtime_error(std::string("DriverManager:: init failed"));
+  }
+
+  /* start session manager */
+  if (!session_manager_->init()) {
+    throw std::runtime_error(std::string("SessionManager:: init failed"));
+  }
+
+  /* start mDNS server */
+  mdns_server_ = std::make_unique<MDNSServer>(session_manager_, config_);
+  if (config_->get_mdns_enabled() && !mdns_server_->init()) {
+    throw std::runtime_error(std::string("MDNSServer:: init failed"));
+  }
+
+  /* start rtsp server */
+  rtsp_server_ = std::make_unique<RtspServer>(session_manager_, config_);
+  if (!rtsp_server_->init()) {
+    throw std::runtime_error(std::string("RtspServer:: init failed"));
+  }
+
+  /* start browser */
+  if (!browser_->init()) {
+    throw std::runtime_error(std::string("Browser:: init failed"));
+  }
+
+  /* start http server */
+  if (http_enabled_) {
+    http_server_ =
+        std::make_unique<HttpServer>(session_manager_, browser_, config_);
+    if (!http_server_->init()) {
+      throw std::runtime_error(std::string("HttpServer:: init failed"));
+    }
+  }
+
+  /* load session status from file */
+  session_manager_->load_status();
+  running_ = true;
+}
+
+void DaemonCore::terminate() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+
+  /* save session status to file */
+  session_manager_->save_status();
+
+  /* stop http server */
+  if (http_server_ != nullptr && !http_server_->terminate()) {
+    throw std::runtime_error(std::string("HttpServer:: terminate failed"));
+  }
+
+  /* stop browser */
+  if (!browser_->terminate()) {
+    throw std::runtime_error(std::string("Browser:: terminate failed"));
+  }
+
+  /* stop rtsp server */
+  if (!rtsp_server_->terminate()) {
+    throw std::runtime_error(std::string("RtspServer:: terminate failed"));
+  }
+
+  /* stop mDNS server */
+  if (config_->get_mdns_enabled()) {
+    if (!mdns_server_->terminate()) {
+      throw std::runtime_error(std::string("MDNServer:: terminate failed"));
+    }
+  }
+
+  /* stop session manager */
+  if (!session_manager_->terminate()) {
+    throw std::runtime_error(std::string("SessionManager:: terminate failed"));
+  }
+
+  /* stop driver manager */
+  if (!driver_->terminate()) {
+    throw std::runtime_error(std::string("DriverManager:: terminate failed"));
+  }
+}
+
+bool DaemonCore::need_restart() const {
+  auto [ip_addr, ip_str] = get_interface_ip(config_->get_interface_name());
+  if (config_->get_ip_addr_str() != ip_str) {
+    BOOST_LOG_TRIVIAL(warning) << "daemon_core:: IP address changed";
+    return true;
+  }
+
+  for (const auto& intf : config_->get_discovery_if_list()) {
+    if (get_interface_ip(intf.name).second != intf.ip_str) {
+      BOOST_LOG_TRIVIAL(warning) << "daemon_core:: IP address of discovery "
+                                 << "interface " << intf.name << " changed";
+      return true;
+    }
+  }
+
+  if (config_->get_need_restart()) {
+    BOOST_LOG_TRIVIAL(warning) << "daemon_core:: config changed";
+    return true;
+  }
+
+  return false;
+}
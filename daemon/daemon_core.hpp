@@ -0,0 +1,86 @@
+//
+//  daemon_core.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _DAEMON_CORE_HPP_
+#define _DAEMON_CORE_HPP_
+
+#include <memory>
+#include <string>
+
+#include "browser.hpp"
+#include "config.hpp"
+#include "driver_manager.hpp"
+#include "session_manager.hpp"
+
+class MDNSServer;
+class RtspServer;
+class HttpServer;
+
+const std::string& get_version();
+
+/*
+ * DaemonCore bundles the driver, the session manager, the browser and the
+ * SAP, mDNS, RTSP and (optionally) HTTP servers behind a single object so
+ * that the daemon control plane can be embedded in another process.
+ *
+ * The components are created by the constructor and started by init().
+ * Event observers (SessionManager::add_source_observer,
+ * SessionManager::add_sink_observer, SessionManager::add_ptp_status_observer
+ * and Browser::add_observer) must be registered before calling init().
+ * Observers are invoked from the daemon worker threads and from the HTTP
+ * server threads serving the REST API. Sink observers are called without
+ * any session manager lock held, source observers are called with the
+ * sources lock held and must not call back into the SessionManager.
+ *
+ * Errors during init() and terminate() are reported via std::runtime_error.
+ */
+class DaemonCore {
+ public:
+  DaemonCore() = delete;
+  DaemonCore(const DaemonCore&) = delete;
+  DaemonCore& operator=(const DaemonCore&) = delete;
+  explicit DaemonCore(std::shared_ptr<Config> config, bool http_enabled = true);
+  virtual ~DaemonCore();
+
+  void init();
+  void terminate();
+
+  /* true if the interface IP or the configuration changed */
+  bool need_restart() const;
+
+  std::shared_ptr<Config> get_config() const { return config_; };
+  std::shared_ptr<DriverManager> get_driver() const { return driver_; };
+  std::shared_ptr<SessionManager> get_session_manager() const {
+    return session_manager_;
+  };
+  std::shared_ptr<Browser> get_browser() const { return browser_; };
+
+ private:
+  std::shared_ptr<Config> config_;
+  bool http_enabled_{true};
+  bool running_{false};
+  std::shared_ptr<DriverManager> driver_;
+  std::shared_ptr<SessionManager> session_manager_;
+  std::shared_ptr<Browser> browser_;
+  std::unique_ptr<MDNSServer> mdns_server_;
+  std::unique_ptr<RtspServer> rtsp_server_;
+  std::unique_ptr<HttpServer> http_server_;
+};
+
+#endif
@@ -71,7 +71,14 @@ std::shared_ptr<DriverManager> DriverManager::create() {
 }
 
 bool DriverManager::init(const Config& config) {
-  if (!DriverHandler::init(config)) {
+  if (config.get_driver_backend() == "userspace") {
+    BOOST_LOG_TRIVIAL(info) << "driver_manager:: using userspace driver";
+    userspace_ = std::make_unique<UserspaceDriver>();
+    if (!userspace_->init(config)) {
+      userspace_.reset();
+      return false;
+    }
+  } else if (!DriverHandler::init(config)) {
     return false;
   }
 
@@ -94,6 +101,11 @@ bool DriverManager::init(const Config& config) {
 bool DriverManager::terminate() {
   stop();
   bye();
+  if (userspace_) {
+    bool res = userspace_->terminate();
+    userspace_.reset();
+    return res;
+  }
   return DriverHandler::terminate();
 }
 
@@ -247,6 +259,29 @@ std::error_code DriverManager::get_number_of_outputs(int32_t& outputs) {
   return retcode_;
 }
 
+void DriverManager::add_event_observer(EventObserver cb) {
+  event_observers.push_back(cb);
+}
+
+void DriverManager::send_command(enum MT_ALSA_msg_id id,
+                                 size_t size,
+                                 const uint8_t* data) {
+  if (!userspace_) {
+    DriverHandler::send_command(id, size, data);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(userspace_mutex_);
+  uint8_t resp[max_payload];
+  size_t resp_size = 0;
+  auto ret = userspace_->command(id, size, data, resp_size, resp);
+  if (ret) {
+    on_command_error(id, ret);
+  } else {
+    on_command_done(id, resp_size, resp);
+  }
+}
+
 void DriverManager::on_command_done(enum MT_ALSA_msg_id id,
                                     size_t size,
                                     const uint8_t* data) {
@@ -300,6 +335,9 @@ void DriverManager::on_event(enum MT_ALSA_msg_id id,
             << "driver_manager:: event SetSampleRate " << sample_rate;
       }
       resp_size = 0;
+      for (auto cb : event_observers) {
+        cb(id);
+      }
       break;
     case MT_ALSA_Msg_GetMasterOutputVolume:
       resp_size = sizeof(int32_t);
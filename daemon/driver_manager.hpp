@@ -21,11 +21,14 @@
 #define _DRIVER_MANAGER_HPP_
 
 #include <boost/asio.hpp>
+#include <functional>
+#include <list>
 #include <mutex>
 
 #include "RTP_stream_info.h"
 #include "audio_streamer_clock_PTP_defs.h"
 #include "driver_handler.hpp"
+#include "userspace_driver.hpp"
 
 class DriverManager : public DriverHandler {
  public:
@@ -57,6 +60,10 @@ class DriverManager : public DriverHandler {
   int32_t get_current_output_switch() { return output_switch; };
   uint32_t get_current_sample_rate() { return sample_rate; };
 
+  /* observers are invoked from the driver event thread */
+  using EventObserver = std::function<void(enum MT_ALSA_msg_id id)>;
+  void add_event_observer(EventObserver cb);
+
  protected:
   // singleton, use create to build
   DriverManager(){};
@@ -68,6 +75,9 @@ class DriverManager : public DriverHandler {
   std::error_code reset();
   std::error_code bye();
 
+  void send_command(enum MT_ALSA_msg_id id,
+                    size_t size = 0,
+                    const uint8_t* data = nullptr) override;
   void on_command_done(enum MT_ALSA_msg_id id,
                        size_t size = 0,
                        const uint8_t* data = nullptr) override;
@@ -85,6 +95,12 @@ class DriverManager : public DriverHandler {
   int32_t output_volume{-20};
   int32_t output_switch{0};
   uint32_t sample_rate{0};
+
+  std::list<EventObserver> event_observers;
+
+  /* userspace data plane, used in place of the kernel module if set */
+  std::unique_ptr<UserspaceDriver> userspace_;
+  std::mutex userspace_mutex_; /* one command at a time */
 };
 
 #endif
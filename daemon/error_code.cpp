@@ -97,6 +97,10 @@ std::string DaemonErrCategory::message(int ev) const {
       return "stream name is in use";
     case DaemonErrc::cannot_retrieve_mac:
       return "cannot retrieve MAC address for IP";
+    case DaemonErrc::job_id_not_found:
+      return "job id not found";
+    case DaemonErrc::mcast_pool_exhausted:
+      return "no free multicast address";
     case DaemonErrc::stream_id_not_in_use:
       return "stream not in use";
     case DaemonErrc::invalid_url:
@@ -117,6 +121,8 @@ std::string DaemonErrCategory::message(int ev) const {
       return "failed to receive event from driver";
     case DaemonErrc::invalid_driver_response:
       return "unexpected driver command response code";
+    case DaemonErrc::job_cancelled:
+      return "job cancelled on shutdown";
     default:
       return "(unrecognized daemon error)";
   }
@@ -0,0 +1,153 @@
+//
+//  hash.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cstring>
+
+#include "hash.hpp"
+
+/* slice-by-8 tables, crc_tables[k][b] is the CRC of byte b followed by
+ * k zero bytes */
+using crc_tables_t = std::array<std::array<uint16_t, 256>, 8>;
+
+static crc_tables_t make_crc_tables() {
+  crc_tables_t tables{};
+  for (int b = 0; b < 256; b++) {
+    uint16_t crc = b << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    tables[0][b] = crc;
+  }
+  for (int k = 1; k < 8; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint16_t prev = tables[k - 1][b];
+      tables[k][b] = (prev << 8) ^ tables[0][prev >> 8];
+    }
+  }
+  return tables;
+}
+
+static const crc_tables_t crc_tables = make_crc_tables();
+
+uint16_t crc16(const uint8_t* p, size_t len) {
+  uint16_t crc = 0xFFFF;
+
+  while (len >= 8) {
+    crc = crc_tables[7][p[0] ^ (crc >> 8)] ^
+          crc_tables[6][p[1] ^ (crc & 0xFF)] ^ crc_tables[5][p[2]] ^
+          crc_tables[4][p[3]] ^ crc_tables[3][p[4]] ^ crc_tables[2][p[5]] ^
+          crc_tables[1][p[6]] ^ crc_tables[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = (crc << 8) ^ crc_tables[0][(crc >> 8) ^ *p++];
+  }
+  return crc;
+}
+
+constexpr static uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr static uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr static uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+constexpr static uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr static uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+/* little endian reads, so that the hash is the same on every platform */
+static inline uint64_t read64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap32(v);
+#endif
+  return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * prime64_2;
+  acc = rotl64(acc, 31);
+  return acc * prime64_1;
+}
+
+static inline uint64_t merge_round64(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * prime64_1 + prime64_4;
+}
+
+uint64_t hash64(const uint8_t* p, size_t len, uint64_t seed) {
+  const uint8_t* end = p + len;
+  uint64_t h;
+
+  if (len >= 32) {
+    uint64_t v1 = seed + prime64_1 + prime64_2;
+    uint64_t v2 = seed + prime64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - prime64_1;
+    do {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+      p += 32;
+    } while (p + 32 <= end);
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = merge_round64(h, v1);
+    h = merge_round64(h, v2);
+    h = merge_round64(h, v3);
+    h = merge_round64(h, v4);
+  } else {
+    h = seed + prime64_5;
+  }
+  h += len;
+
+  while (p + 8 <= end) {
+    h ^= round64(0, read64(p));
+    h = rotl64(h, 27) * prime64_1 + prime64_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(read32(p)) * prime64_1;
+    h = rotl64(h, 23) * prime64_2 + prime64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= *p++ * prime64_5;
+    h = rotl64(h, 11) * prime64_1;
+  }
+
+  h ^= h >> 33;
+  h *= prime64_2;
+  h ^= h >> 29;
+  h *= prime64_3;
+  h ^= h >> 32;
+  return h;
+}
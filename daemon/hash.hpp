@@ -0,0 +1,42 @@
+//
+//  hash.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _HASH_HPP_
+#define _HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* CRC-16 (poly 0x1021, init 0xFFFF) used for the SAP message id hash and the
+ * RTSP source ids, it must not change for wire compatibility */
+uint16_t crc16(const uint8_t* p, size_t len);
+inline uint16_t crc16(const std::string& s) {
+  return crc16(reinterpret_cast<const uint8_t*>(s.c_str()), s.length());
+}
+
+/* 64-bit content hash (XXH64) for internal change detection and identity,
+ * never sent on the wire */
+uint64_t hash64(const uint8_t* p, size_t len, uint64_t seed = 0);
+inline uint64_t hash64(const std::string& s, uint64_t seed = 0) {
+  return hash64(reinterpret_cast<const uint8_t*>(s.c_str()), s.length(),
+                seed);
+}
+
+#endif
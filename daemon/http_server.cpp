@@ -20,10 +20,13 @@
 #include <boost/foreach.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 
-#include "main.hpp"
+#include "daemon_core.hpp"
+#include "hash.hpp"
 #include "json.hpp"
 #include "log.hpp"
 #include "http_server.hpp"
@@ -78,6 +81,18 @@ static inline void set_error(int status,
   res.body = message;
 }
 
+static inline bool is_async_request(const Request& req) {
+  return req.has_param("async") && (req.get_param_value("async") == "true" ||
+                                    req.get_param_value("async") == "1");
+}
+
+static inline void set_job_accepted(uint32_t job_id, Response& res) {
+  res.status = 202;
+  set_headers(res, "application/json");
+  res.set_header("Location", "/api/job/" + std::to_string(job_id));
+  res.body = "{ \"job_id\": " + std::to_string(job_id) + " }\n";
+}
+
 bool HttpServer::init() {
   /* setup http operations */
   if (!svr_.is_valid()) {
@@ -170,6 +185,14 @@ bool HttpServer::init() {
     res.body = sources_to_json(sources);
   });
 
+  /* get sources using the multicast address of a remote session */
+  svr_.Get("/api/sources/collisions",
+           [this](const Request& req, Response& res) {
+             set_headers(res, "application/json");
+             res.body = mcast_collisions_to_json(
+                 session_manager_->get_mcast_collisions());
+           });
+
   /* get all sinks */
   svr_.Get("/api/sinks", [this](const Request& req, Response& res) {
     auto const sinks = session_manager_->get_sinks();
@@ -199,9 +222,20 @@ bool HttpServer::init() {
         auto ret = session_manager_->get_source_sdp(id, res.body);
         if (ret) {
           set_error(ret, "get source " + std::to_string(id) + " failed", res);
+          return;
+        }
+        /* sinks watching this URL revalidate it with the ETag */
+        std::stringstream ss;
+        ss << "\"" << std::hex << std::setw(16) << std::setfill('0')
+           << hash64(res.body) << "\"";
+        if (req.get_header_value("If-None-Match") == ss.str()) {
+          res.status = 304;
+          res.body.clear();
+          set_headers(res);
         } else {
           set_headers(res, "application/sdp");
         }
+        res.set_header("ETag", ss.str());
       });
 
   /* get stream status */
@@ -225,10 +259,68 @@ bool HttpServer::init() {
         }
       });
 
+  /* get sink delay tuning */
+  svr_.Get(
+      "/api/sink/delay/([0-9]+)", [this](const Request& req, Response& res) {
+        uint32_t id;
+        try {
+          id = std::stoi(req.matches[1]);
+        } catch (...) {
+          set_error(400, "failed to convert id", res);
+          return;
+        }
+        SinkDelayTuning tuning;
+        auto ret = session_manager_->get_sink_delay_tuning(id, tuning);
+        if (ret) {
+          set_error(ret,
+                    "failed to get sink " + std::to_string(id) +
+                        " delay tuning",
+                    res);
+        } else {
+          set_headers(res, "application/json");
+          res.body = sink_delay_tuning_to_json(tuning);
+        }
+      });
+
+  /* get sink status history */
+  svr_.Get("/api/sink/status/([0-9]+)/history",
+           [this](const Request& req, Response& res) {
+             uint32_t id, from = 0, to = UINT32_MAX;
+             try {
+               id = std::stoi(req.matches[1]);
+               if (req.has_param("from")) {
+                 from = std::stoul(req.get_param_value("from"));
+               }
+               if (req.has_param("to")) {
+                 to = std::stoul(req.get_param_value("to"));
+               }
+             } catch (...) {
+               set_error(400, "failed to convert id or time range", res);
+               return;
+             }
+             std::list<SinkStatusSample> samples;
+             uint32_t now;
+             auto ret = session_manager_->get_sink_status_history(
+                 id, from, to, samples, now);
+             if (ret) {
+               set_error(ret,
+                         "failed to get sink " + std::to_string(id) +
+                             " status history",
+                         res);
+             } else {
+               set_headers(res, "application/json");
+               res.body = sink_status_history_to_json(now, samples);
+             }
+           });
+
   /* add a source */
   svr_.Put("/api/source/([0-9]+)", [this](const Request& req, Response& res) {
     try {
       StreamSource source = json_to_source(req.matches[1], req.body);
+      if (is_async_request(req)) {
+        set_job_accepted(session_manager_->add_source_job(source), res);
+        return;
+      }
       auto ret = session_manager_->add_source(source);
       if (ret) {
         set_error(ret, "failed to add source " + std::to_string(source.id),
@@ -263,6 +355,10 @@ bool HttpServer::init() {
   svr_.Put("/api/sink/([0-9]+)", [this](const Request& req, Response& res) {
     try {
       StreamSink sink = json_to_sink(req.matches[1], req.body);
+      if (is_async_request(req)) {
+        set_job_accepted(session_manager_->add_sink_job(sink), res);
+        return;
+      }
       auto ret = session_manager_->add_sink(sink);
       if (ret) {
         set_error(ret, "failed to add sink " + std::to_string(sink.id), res);
@@ -291,6 +387,36 @@ bool HttpServer::init() {
     }
   });
 
+  /* get all jobs */
+  svr_.Get("/api/jobs", [this](const Request& req, Response& res) {
+    auto const jobs = session_manager_->get_jobs();
+    set_headers(res, "application/json");
+    res.body = jobs_to_json(jobs);
+  });
+
+  /* get a job, optionally waiting for its completion */
+  svr_.Get("/api/job/([0-9]+)", [this](const Request& req, Response& res) {
+    uint32_t id;
+    int wait = 0;
+    try {
+      id = std::stoi(req.matches[1]);
+      if (req.has_param("wait")) {
+        wait = std::stoi(req.get_param_value("wait"));
+      }
+    } catch (...) {
+      set_error(400, "failed to convert id or wait", res);
+      return;
+    }
+    StreamJob job;
+    auto ret = session_manager_->get_job(id, job, wait);
+    if (ret) {
+      set_error(404, "failed to get job " + std::to_string(id), res);
+    } else {
+      set_headers(res, "application/json");
+      res.body = job_to_json(job);
+    }
+  });
+
   /* get remote sources */
   svr_.Get("/api/browse/sources/(all|mdns|sap)",
            [this](const Request& req, Response& res) {
@@ -299,8 +425,14 @@ bool HttpServer::init() {
              res.body = remote_sources_to_json(sources);
            });
 
+  /* get remote sources catalog statistics */
+  svr_.Get("/api/browse/stats", [this](const Request& req, Response& res) {
+    set_headers(res, "application/json");
+    res.body = browser_stats_to_json(browser_->get_stats());
+  });
+
   svr_.set_logger([](const Request& req, const Response& res) {
-    if (res.status == 200) {
+    if (res.status == 200 || res.status == 202) {
       BOOST_LOG_TRIVIAL(info) << "http_server:: " << req.method << " "
                               << req.path << " response " << res.status;
     } else {
@@ -39,13 +39,15 @@ class IGMP {
   };
 
   bool join(const std::string& interface_ip, const std::string& mcast_ip) {
-    uint32_t mcast_ip_addr =
-        ip::address_v4::from_string(mcast_ip.c_str()).to_ulong();
+    /* groups are reference counted per interface */
+    std::pair<uint32_t, uint32_t> group{
+        ip::address_v4::from_string(interface_ip.c_str()).to_ulong(),
+        ip::address_v4::from_string(mcast_ip.c_str()).to_ulong()};
     std::lock_guard<std::mutex> lock(mutex);
 
-    auto it = mcast_ref.find(mcast_ip_addr);
+    auto it = mcast_ref.find(group);
     if (it != mcast_ref.end() && (*it).second > 0) {
-      mcast_ref[mcast_ip_addr]++;
+      mcast_ref[group]++;
       return true;
     }
 
@@ -69,21 +71,22 @@ class IGMP {
 
     BOOST_LOG_TRIVIAL(info) << "igmp:: joined multicast group " << mcast_ip
                             << " on " << interface_ip;
-    mcast_ref[mcast_ip_addr] = 1;
+    mcast_ref[group] = 1;
     return true;
   }
 
   bool leave(const std::string& interface_ip, const std::string& mcast_ip) {
-    uint32_t mcast_ip_addr =
-        ip::address_v4::from_string(mcast_ip.c_str()).to_ulong();
+    std::pair<uint32_t, uint32_t> group{
+        ip::address_v4::from_string(interface_ip.c_str()).to_ulong(),
+        ip::address_v4::from_string(mcast_ip.c_str()).to_ulong()};
     std::lock_guard<std::mutex> lock(mutex);
 
-    auto it = mcast_ref.find(mcast_ip_addr);
+    auto it = mcast_ref.find(group);
     if (it == mcast_ref.end() || (*it).second == 0) {
       return false;
     }
 
-    if (--mcast_ref[mcast_ip_addr] > 0) {
+    if (--mcast_ref[group] > 0) {
       return true;
     }
 
@@ -107,7 +110,7 @@ class IGMP {
   io_service io_service_;
   ip::udp::socket socket_{io_service_};
   udp::endpoint listen_endpoint_{udp::endpoint(address_v4::any(), 0)};
-  std::unordered_map<uint32_t, int> mcast_ref;
+  std::map<std::pair<uint32_t, uint32_t>, int> mcast_ref;
   std::mutex mutex;
 };
 
@@ -84,6 +84,7 @@ std::string config_to_json(const Config& config) {
      << ",\n  \"sample_rate\": " << config.get_sample_rate()
      << ",\n  \"rtp_mcast_base\": \""
      << escape_json(config.get_rtp_mcast_base()) << "\""
+     << ",\n  \"rtp_mcast_pool_size\": " << config.get_rtp_mcast_pool_size()
      << ",\n  \"rtp_port\": " << config.get_rtp_port()
      << ",\n  \"ptp_domain\": " << unsigned(config.get_ptp_domain())
      << ",\n  \"ptp_dscp\": " << unsigned(config.get_ptp_dscp())
@@ -99,6 +100,32 @@ std::string config_to_json(const Config& config) {
      << ",\n  \"interface_name\": \""
      << escape_json(config.get_interface_name()) << "\""
      << ",\n  \"mdns_enabled\": " << std::boolalpha << config.get_mdns_enabled()
+     << ",\n  \"sink_delay_tuning\": \""
+     << escape_json(config.get_sink_delay_tuning()) << "\""
+     << ",\n  \"sink_delay_tuning_window\": "
+     << config.get_sink_delay_tuning_window()
+     << ",\n  \"sink_delay_tuning_margin\": "
+     << config.get_sink_delay_tuning_margin()
+     << ",\n  \"sink_status_history_hours\": "
+     << unsigned(config.get_sink_status_history_hours())
+     << ",\n  \"driver_backend\": \""
+     << escape_json(config.get_driver_backend()) << "\""
+     << ",\n  \"driver_playback_path\": \""
+     << escape_json(config.get_driver_playback_path()) << "\""
+     << ",\n  \"driver_capture_path\": \""
+     << escape_json(config.get_driver_capture_path()) << "\""
+     << ",\n  \"driver_channels\": " << unsigned(config.get_driver_channels())
+     << ",\n  \"browser_max_sources\": " << config.get_browser_max_sources()
+     << ",\n  \"browser_max_sdp_bytes\": "
+     << config.get_browser_max_sdp_bytes()
+     << ",\n  \"browser_allowed_subnets\": \""
+     << escape_json(config.get_browser_allowed_subnets()) << "\""
+     << ",\n  \"browser_allowed_domains\": \""
+     << escape_json(config.get_browser_allowed_domains()) << "\""
+     << ",\n  \"discovery_interfaces\": \""
+     << escape_json(config.get_discovery_interfaces()) << "\""
+     << ",\n  \"sdp_url_watch_interval\": "
+     << config.get_sdp_url_watch_interval()
      << ",\n  \"mac_addr\": \"" << escape_json(config.get_mac_addr_str())
      << "\""
      << ",\n  \"ip_addr\": \"" << escape_json(config.get_ip_addr_str()) << "\""
@@ -142,6 +169,7 @@ std::string sink_to_json(const StreamSink& sink) {
      << ",\n    \"use_sdp\": " << std::boolalpha << sink.use_sdp
      << ",\n    \"source\": \"" << escape_json(sink.source) << "\""
      << ",\n    \"sdp\": \"" << escape_json(sink.sdp) << "\""
+     << ",\n    \"sdp_from_url\": " << std::boolalpha << sink.sdp_from_url
      << ",\n    \"delay\": " << sink.delay
      << ",\n    \"ignore_refclk_gmid\": " << std::boolalpha
      << sink.ignore_refclk_gmid << ",\n    \"map\": [ ";
@@ -172,6 +200,62 @@ std::string sink_status_to_json(const SinkStreamStatus& status) {
   return ss.str();
 }
 
+static std::string sink_delay_tuning_window_to_json(
+    const SinkDelayTuningWindow& window) {
+  std::stringstream ss;
+  ss << "\n    {"
+     << "\n      \"start_time\": " << window.start_time
+     << ",\n      \"end_time\": " << window.end_time
+     << ",\n      \"samples\": " << window.samples
+     << ",\n      \"min_time\": " << window.min_time
+     << ",\n      \"errors\": " << window.errors
+     << ",\n      \"muted\": " << window.muted
+     << ",\n      \"delay\": " << window.delay
+     << ",\n      \"recommended_delay\": " << window.recommended_delay
+     << ",\n      \"applied\": " << std::boolalpha << window.applied
+     << "\n    }";
+  return ss.str();
+}
+
+std::string sink_delay_tuning_to_json(const SinkDelayTuning& tuning) {
+  int count = 0;
+  std::stringstream ss;
+  ss << "{"
+     << "\n  \"mode\": \"" << escape_json(tuning.mode) << "\""
+     << ",\n  \"delay\": " << tuning.delay
+     << ",\n  \"recommended_delay\": " << tuning.recommended_delay
+     << ",\n  \"window\": "
+     << sink_delay_tuning_window_to_json(tuning.window)
+     << ",\n  \"history\": [";
+  for (auto const& window : tuning.history) {
+    if (count++) {
+      ss << ", ";
+    }
+    ss << sink_delay_tuning_window_to_json(window);
+  }
+  ss << "  ]\n}\n";
+  return ss.str();
+}
+
+std::string sink_status_history_to_json(
+    uint32_t now,
+    const std::list<SinkStatusSample>& samples) {
+  int count = 0;
+  std::stringstream ss;
+  ss << "{"
+     << "\n  \"now\": " << now << ",\n  \"samples\": [";
+  for (auto const& sample : samples) {
+    if (count++) {
+      ss << ",";
+    }
+    ss << "\n    { \"time\": " << sample.time
+       << ", \"flags\": " << unsigned(sample.flags)
+       << ", \"min_time\": " << sample.min_time << " }";
+  }
+  ss << "\n  ]\n}\n";
+  return ss.str();
+}
+
 std::string ptp_config_to_json(const PTPConfig& ptp_config) {
   std::stringstream ss;
   ss << "{"
@@ -185,7 +269,9 @@ std::string ptp_status_to_json(const PTPStatus& status) {
   ss << "{"
      << " \"status\": \"" << escape_json(status.status) << "\""
      << ", \"gmid\": \"" << escape_json(status.gmid) << "\""
-     << ", \"jitter\": " << status.jitter << " }\n";
+     << ", \"jitter\": " << status.jitter
+     << ", \"time_to_lock_ms\": " << status.time_to_lock_ms
+     << ", \"time_to_audio_ms\": " << status.time_to_audio_ms << " }\n";
   return ss.str();
 }
 
@@ -248,10 +334,27 @@ std::string remote_source_to_json(const RemoteSource& source) {
      << ",\n    \"name\": \"" << escape_json(source.name) << "\""
      << ",\n    \"domain\": \"" << escape_json(source.domain) << "\""
      << ",\n    \"address\": \"" << escape_json(source.address) << "\""
+     << ",\n    \"interface\": \"" << escape_json(source.interface) << "\""
      << ",\n    \"sdp\": \"" << escape_json(source.sdp) << "\""
      << ",\n    \"last_seen\": " << unsigned(source.last_seen)
      << ",\n    \"announce_period\": " << unsigned(source.announce_period)
-     << " \n  }";
+     << ",\n    \"origins\": [";
+  int count = 0;
+  for (auto const& origin : source.origins) {
+    if (count++) {
+      ss << ",";
+    }
+    ss << "\n      {"
+       << "\n        \"source\": \"" << escape_json(origin.source) << "\""
+       << ",\n        \"id\": \"" << escape_json(origin.id) << "\""
+       << ",\n        \"address\": \"" << escape_json(origin.address) << "\""
+       << ",\n        \"interface\": \"" << escape_json(origin.interface)
+       << "\""
+       << ",\n        \"last_seen\": " << unsigned(origin.last_seen)
+       << ",\n        \"announce_period\": "
+       << unsigned(origin.announce_period) << "\n      }";
+  }
+  ss << " ]\n  }";
   return ss.str();
 }
 
@@ -269,6 +372,75 @@ std::string remote_sources_to_json(const std::list<RemoteSource>& sources) {
   return ss.str();
 }
 
+std::string browser_stats_to_json(const BrowserStats& stats) {
+  std::stringstream ss;
+  ss << "{"
+     << "\n  \"sources\": " << stats.sources
+     << ",\n  \"sdp_bytes\": " << stats.sdp_bytes
+     << ",\n  \"rejected_invalid\": " << stats.rejected_invalid
+     << ",\n  \"rejected_filtered\": " << stats.rejected_filtered
+     << ",\n  \"rejected_size\": " << stats.rejected_size
+     << ",\n  \"evicted\": " << stats.evicted << "\n}\n";
+  return ss.str();
+}
+
+std::string job_to_json(const StreamJob& job) {
+  std::string error;
+  if (job.error) {
+    error = std::string("(") + job.error.category().name() + ") " +
+            job.error.message();
+  }
+  std::stringstream ss;
+  ss << "\n  {"
+     << "\n    \"id\": " << job.id
+     << ",\n    \"operation\": \"" << escape_json(job.operation) << "\""
+     << ",\n    \"stream_id\": " << unsigned(job.stream_id)
+     << ",\n    \"status\": \"" << escape_json(job.status) << "\""
+     << ",\n    \"error\": \"" << escape_json(error) << "\""
+     << ",\n    \"duration_ms\": " << job.duration_ms << "\n  }";
+  return ss.str();
+}
+
+std::string jobs_to_json(const std::list<StreamJob>& jobs) {
+  int count = 0;
+  std::stringstream ss;
+  ss << "{\n  \"jobs\": [";
+  for (auto const& job : jobs) {
+    if (count++) {
+      ss << ", ";
+    }
+    ss << job_to_json(job);
+  }
+  ss << "  ]\n}\n";
+  return ss.str();
+}
+
+std::string mcast_collisions_to_json(
+    const std::list<McastCollision>& collisions) {
+  int count = 0;
+  std::stringstream ss;
+  ss << "{\n  \"collisions\": [";
+  for (auto const& collision : collisions) {
+    if (count++) {
+      ss << ", ";
+    }
+    ss << "\n  {"
+       << "\n    \"id\": " << unsigned(collision.id)
+       << ",\n    \"address\": \"" << escape_json(collision.address) << "\""
+       << ",\n    \"remote_ids\": [";
+    int ids = 0;
+    for (auto const& id : collision.remote_ids) {
+      if (ids++) {
+        ss << ", ";
+      }
+      ss << "\"" << escape_json(id) << "\"";
+    }
+    ss << "]\n  }";
+  }
+  ss << "  ]\n}\n";
+  return ss.str();
+}
+
 Config json_to_config_(std::istream& js, Config& config) {
   try {
     boost::property_tree::ptree pt;
@@ -298,6 +470,8 @@ Config json_to_config_(std::istream& js, Config& config) {
       } else if (key == "rtp_mcast_base") {
         config.set_rtp_mcast_base(
             remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "rtp_mcast_pool_size") {
+        config.set_rtp_mcast_pool_size(val.get_value<uint16_t>());
       } else if (key == "rtp_port") {
         config.set_rtp_port(val.get_value<uint16_t>());
       } else if (key == "ptp_domain") {
@@ -320,6 +494,41 @@ Config json_to_config_(std::istream& js, Config& config) {
       } else if (key == "syslog_server") {
         config.set_syslog_server(
             remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "sink_delay_tuning") {
+        config.set_sink_delay_tuning(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "sink_delay_tuning_window") {
+        config.set_sink_delay_tuning_window(val.get_value<uint16_t>());
+      } else if (key == "sink_delay_tuning_margin") {
+        config.set_sink_delay_tuning_margin(val.get_value<uint16_t>());
+      } else if (key == "sink_status_history_hours") {
+        config.set_sink_status_history_hours(val.get_value<uint8_t>());
+      } else if (key == "driver_backend") {
+        config.set_driver_backend(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "driver_playback_path") {
+        config.set_driver_playback_path(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "driver_capture_path") {
+        config.set_driver_capture_path(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "driver_channels") {
+        config.set_driver_channels(val.get_value<uint8_t>());
+      } else if (key == "browser_max_sources") {
+        config.set_browser_max_sources(val.get_value<uint16_t>());
+      } else if (key == "browser_max_sdp_bytes") {
+        config.set_browser_max_sdp_bytes(val.get_value<uint32_t>());
+      } else if (key == "browser_allowed_subnets") {
+        config.set_browser_allowed_subnets(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "browser_allowed_domains") {
+        config.set_browser_allowed_domains(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "discovery_interfaces") {
+        config.set_discovery_interfaces(
+            remove_undesired_chars(val.get_value<std::string>()));
+      } else if (key == "sdp_url_watch_interval") {
+        config.set_sdp_url_watch_interval(val.get_value<uint16_t>());
       } else if (key == "mac_addr" || key == "ip_addr" || key == "node_id") {
         /* ignored */
       } else {
@@ -425,6 +634,7 @@ StreamSink json_to_sink(const std::string& id, const std::string& json) {
     sink.source = remove_undesired_chars(pt.get<std::string>("source"));
     sink.use_sdp = pt.get<bool>("use_sdp");
     sink.sdp = remove_undesired_chars(pt.get<std::string>("sdp"));
+    sink.sdp_from_url = pt.get<bool>("sdp_from_url", false);
     sink.delay = pt.get<uint32_t>("delay");
     sink.ignore_refclk_gmid = pt.get<bool>("ignore_refclk_gmid");
     /* source map determite the association with
@@ -516,6 +726,7 @@ static void parse_json_sinks(boost::property_tree::ptree& pt,
     sink.source = v.second.get<std::string>("source");
     sink.use_sdp = v.second.get<bool>("use_sdp");
     sink.sdp = v.second.get<std::string>("sdp");
+    sink.sdp_from_url = v.second.get<bool>("sdp_from_url", false);
     sink.delay = v.second.get<uint32_t>("delay");
     sink.ignore_refclk_gmid = v.second.get<bool>("ignore_refclk_gmid");
     /* source map determite the association with
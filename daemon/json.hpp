@@ -30,6 +30,10 @@ std::string config_to_json(const Config& config);
 std::string source_to_json(const StreamSource& source);
 std::string sink_to_json(const StreamSink& sink);
 std::string sink_status_to_json(const SinkStreamStatus& status);
+std::string sink_delay_tuning_to_json(const SinkDelayTuning& tuning);
+std::string sink_status_history_to_json(
+    uint32_t now,
+    const std::list<SinkStatusSample>& samples);
 std::string ptp_config_to_json(const PTPConfig& config);
 std::string ptp_status_to_json(const PTPStatus& status);
 std::string sources_to_json(const std::list<StreamSource>& sources);
@@ -38,6 +42,11 @@ std::string streams_to_json(const std::list<StreamSource>& sources,
                             const std::list<StreamSink>& sinks);
 std::string remote_source_to_json(const RemoteSource& source);
 std::string remote_sources_to_json(const std::list<RemoteSource>& sources);
+std::string browser_stats_to_json(const BrowserStats& stats);
+std::string job_to_json(const StreamJob& job);
+std::string jobs_to_json(const std::list<StreamJob>& jobs);
+std::string mcast_collisions_to_json(
+    const std::list<McastCollision>& collisions);
 
 /* JSON deserializers */
 Config json_to_config(std::istream& jstream, const Config& curCconfig);
@@ -21,21 +21,15 @@
 #include <iostream>
 #include <thread>
 
-#include "browser.hpp"
 #include "config.hpp"
-#include "driver_manager.hpp"
-#include "http_server.hpp"
-#include "interface.hpp"
+#include "daemon_core.hpp"
 #include "log.hpp"
-#include "mdns_server.hpp"
-#include "rtsp_server.hpp"
-#include "session_manager.hpp"
+#include "main.hpp"
 
 namespace po = boost::program_options;
 namespace postyle = boost::program_options::command_line_style;
 namespace logging = boost::log;
 
-static std::string version("bondagit-1.3.1");
 static std::atomic<bool> terminate = false;
 
 void termination_handler(int signum) {
@@ -48,10 +42,6 @@ bool is_terminated() {
   return terminate.load();
 }
 
-const std::string& get_version() {
-  return version;
-}
-
 int main(int argc, char* argv[]) {
   int rc = EXIT_SUCCESS;
   po::options_description desc("Options");
@@ -74,7 +64,7 @@ int main(int argc, char* argv[]) {
     po::notify(vm);
 
     if (vm.count("version")) {
-      std::cout << version << '\n';
+      std::cout << get_version() << '\n';
       return EXIT_SUCCESS;
     }
     if (vm.count("help")) {
@@ -117,98 +107,20 @@ int main(int argc, char* argv[]) {
 
     BOOST_LOG_TRIVIAL(debug) << "main:: initializing daemon";
     try {
-      auto driver = DriverManager::create();
-      /* setup and init driver */
-      if (driver == nullptr || !driver->init(*config)) {
-        throw std::runtime_error(std::string("DriverManager:: init failed"));
-      }
-
-      /* start session manager */
-      auto session_manager = SessionManager::create(driver, config);
-      if (session_manager == nullptr || !session_manager->init()) {
-        throw std::runtime_error(std::string("SessionManager:: init failed"));
-      }
-
-      /* start mDNS server */
-      MDNSServer mdns_server(session_manager, config);
-      if (config->get_mdns_enabled() && !mdns_server.init()) {
-        throw std::runtime_error(std::string("MDNSServer:: init failed"));
-      }
-
-      /* start rtsp server */
-      RtspServer rtsp_server(session_manager, config);
-      if (!rtsp_server.init()) {
-        throw std::runtime_error(std::string("RtspServer:: init failed"));
-      }
-
-      /* start browser */
-      auto browser = Browser::create(config);
-      if (browser == nullptr || !browser->init()) {
-        throw std::runtime_error(std::string("Browser:: init failed"));
-      }
-
-      /* start http server */
-      HttpServer http_server(session_manager, browser, config);
-      if (!http_server.init()) {
-        throw std::runtime_error(std::string("HttpServer:: init failed"));
-      }
-
-      /* load session status from file */
-      session_manager->load_status();
+      DaemonCore daemon(config);
+      daemon.init();
 
       BOOST_LOG_TRIVIAL(debug) << "main:: init done, entering loop...";
       while (!is_terminated()) {
-        auto [ip_addr, ip_str] = get_interface_ip(config->get_interface_name());
-        if (config->get_ip_addr_str() != ip_str) {
-          BOOST_LOG_TRIVIAL(warning)
-              << "main:: IP address changed, restarting ...";
-          break;
-        }
-
-        if (config->get_need_restart()) {
-          BOOST_LOG_TRIVIAL(warning) << "main:: config changed, restarting ...";
+        if (daemon.need_restart()) {
+          BOOST_LOG_TRIVIAL(warning) << "main:: restarting ...";
           break;
         }
 
         std::this_thread::sleep_for(std::chrono::seconds(1));
       }
 
-      /* save session status to file */
-      session_manager->save_status();
-
-      /* stop http server */
-      if (!http_server.terminate()) {
-        throw std::runtime_error(std::string("HttpServer:: terminate failed"));
-      }
-
-      /* stop browser */
-      if (!browser->terminate()) {
-        throw std::runtime_error(std::string("Browser:: terminate failed"));
-      }
-
-      /* stop rtsp server */
-      if (!rtsp_server.terminate()) {
-        throw std::runtime_error(std::string("RtspServer:: terminate failed"));
-      }
-
-      /* stop mDNS server */
-      if (config->get_mdns_enabled()) {
-        if (!mdns_server.terminate()) {
-          throw std::runtime_error(std::string("MDNServer:: terminate failed"));
-        }
-      }
-
-      /* stop session manager */
-      if (!session_manager->terminate()) {
-        throw std::runtime_error(
-            std::string("SessionManager:: terminate failed"));
-      }
-
-      /* stop driver manager */
-      if (!driver->terminate()) {
-        throw std::runtime_error(
-            std::string("DriverManager:: terminate failed"));
-      }
+      daemon.terminate();
 
     } catch (std::exception& e) {
       BOOST_LOG_TRIVIAL(fatal) << "main:: fatal exception error: " << e.what();
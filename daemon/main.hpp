@@ -21,6 +21,5 @@
 #define _MAIN_HPP_
 
 bool is_terminated();
-const std::string& get_version();
 
 #endif
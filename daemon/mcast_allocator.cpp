@@ -0,0 +1,102 @@
+//
+//  mcast_allocator.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <sstream>
+
+#include "mcast_allocator.hpp"
+
+std::vector<uint32_t> McastAllocator::get_sdp_addresses(
+    const std::string& sdp) {
+  std::vector<uint32_t> addrs;
+  std::stringstream ss(sdp);
+  std::string line;
+  while (getline(ss, line, '\n')) {
+    /* c=IN IP4 239.1.0.1/15 */
+    if (line.rfind("c=IN IP4 ", 0) != 0) {
+      continue;
+    }
+    auto addr = line.substr(9, line.find_first_of("/\r", 9) - 9);
+    boost::system::error_code ec;
+    auto ip = boost::asio::ip::address_v4::from_string(addr, ec);
+    if (!ec && ip.is_multicast() &&
+        std::find(addrs.begin(), addrs.end(), ip.to_ulong()) == addrs.end()) {
+      addrs.push_back(ip.to_ulong());
+    }
+  }
+  return addrs;
+}
+
+void McastAllocator::add_remote(const std::string& id,
+                                const std::string& sdp) {
+  remove_remote(id);
+  auto addrs = get_sdp_addresses(sdp);
+  for (auto addr : addrs) {
+    remote_addrs_.emplace(addr, id);
+  }
+  remote_sessions_[id] = std::move(addrs);
+}
+
+void McastAllocator::remove_remote(const std::string& id) {
+  auto it = remote_sessions_.find(id);
+  if (it == remote_sessions_.end()) {
+    return;
+  }
+  for (auto addr : it->second) {
+    auto [first, last] = remote_addrs_.equal_range(addr);
+    for (; first != last; ++first) {
+      if (first->second == id) {
+        remote_addrs_.erase(first);
+        break;
+      }
+    }
+  }
+  remote_sessions_.erase(it);
+}
+
+std::list<std::string> McastAllocator::get_remote(uint32_t addr) const {
+  std::list<std::string> ids;
+  auto [first, last] = remote_addrs_.equal_range(addr);
+  for (; first != last; ++first) {
+    ids.push_back(first->second);
+  }
+  return ids;
+}
+
+bool McastAllocator::is_free(uint32_t addr,
+                             const std::set<uint32_t>& in_use) const {
+  return addr >= base_ && addr - base_ < size_ && !in_use.count(addr) &&
+         !remote_addrs_.count(addr);
+}
+
+uint32_t McastAllocator::allocate(const std::list<uint32_t>& preferred,
+                                  const std::set<uint32_t>& in_use) const {
+  for (auto addr : preferred) {
+    if (is_free(addr, in_use)) {
+      return addr;
+    }
+  }
+  for (uint32_t addr = base_; addr - base_ < size_; addr++) {
+    if (is_free(addr, in_use)) {
+      return addr;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+//
+//  mcast_allocator.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _MCAST_ALLOCATOR_HPP_
+#define _MCAST_ALLOCATOR_HPP_
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Tracks the multicast groups used by the remote sessions (SDP c= lines)
+ * and picks free groups for the local sources within the pool
+ * [base, base + size).
+ */
+class McastAllocator {
+ public:
+  McastAllocator(uint32_t base = 0, uint16_t size = 0)
+      : base_(base), size_(size){};
+
+  /* add or replace the groups used by the remote session id */
+  void add_remote(const std::string& id, const std::string& sdp);
+  void remove_remote(const std::string& id);
+  /* remote sessions using the group addr */
+  std::list<std::string> get_remote(uint32_t addr) const;
+
+  /* first free group of the pool trying the preferred ones first,
+   * 0 if the pool is exhausted */
+  uint32_t allocate(const std::list<uint32_t>& preferred,
+                    const std::set<uint32_t>& in_use) const;
+
+  static std::vector<uint32_t> get_sdp_addresses(const std::string& sdp);
+
+ private:
+  bool is_free(uint32_t addr, const std::set<uint32_t>& in_use) const;
+
+  uint32_t base_;
+  uint16_t size_;
+  std::map<std::string /* id */, std::vector<uint32_t> > remote_sessions_;
+  std::multimap<uint32_t /* addr */, std::string /* id */> remote_addrs_;
+};
+
+#endif
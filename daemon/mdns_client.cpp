@@ -27,6 +27,15 @@
 
 
 #ifdef _USE_AVAHI_
+std::string MDNSClient::get_interface_name_(AvahiIfIndex interface) const {
+  for (const auto& intf : config_->get_discovery_if_list()) {
+    if (intf.idx == interface) {
+      return intf.name;
+    }
+  }
+  return config_->get_interface_name();
+}
+
 void MDNSClient::resolve_callback(AvahiServiceResolver* r,
                                   AvahiIfIndex interface,
                                   AvahiProtocol protocol,
@@ -96,11 +105,12 @@ void MDNSClient::resolve_callback(AvahiServiceResolver* r,
             [&mdns, name_ = std::forward<std::string>(name),
              domain_ = std::forward<std::string>(domain),
              addr_ = std::forward<std::string>(addr),
-             port_ = std::forward<std::string>(std::to_string(port))] {
+             port_ = std::forward<std::string>(std::to_string(port)),
+             interface_ = mdns.get_interface_name_(interface)] {
               RtspClient::process(
                   std::bind(&MDNSClient::on_change_rtsp_source, &mdns,
                             std::placeholders::_1, std::placeholders::_2,
-                            std::placeholders::_3),
+                            interface_, std::placeholders::_3),
                   name_, domain_, std::string("/by-name/") + name_, addr_,
                   port_);
             }));
@@ -138,9 +148,13 @@ void MDNSClient::browse_callback(AvahiServiceBrowser* b,
       BOOST_LOG_TRIVIAL(info) << "mdns_client:: (Browser) NEW: "
                               << "service " << name << " of type " << type
                               << " in domain " << domain;
-      /* check if a resolver is already running for this name and domain */
-      if (mdns.active_resolvers.find({name, domain}) !=
-          mdns.active_resolvers.end()) {
+      /* the same service can be announced on more discovery interfaces */
+      mdns.services_[{name, domain}].insert(interface);
+      if (mdns.services_[{name, domain}].size() > 1) {
+        BOOST_LOG_TRIVIAL(info) << "mdns_client:: (Browser): service already "
+                                   "discovered on another interface ...";
+      } else if (mdns.active_resolvers.find({name, domain}) !=
+                 mdns.active_resolvers.end()) {
         /* if already running we don't run a new resolver */
         BOOST_LOG_TRIVIAL(info)
             << "mdns_client:: (Browser): resolution already ongoing ...";
@@ -162,6 +176,15 @@ void MDNSClient::browse_callback(AvahiServiceBrowser* b,
       BOOST_LOG_TRIVIAL(info) << "mdns_client:: (Browser) REMOVE: "
                               << "service " << name << " of type " << type
                               << " in domain " << domain;
+      if (mdns.services_.count({name, domain})) {
+        auto& interfaces = mdns.services_[{name, domain}];
+        interfaces.erase(interface);
+        if (!interfaces.empty()) {
+          /* still announced on another discovery interface */
+          break;
+        }
+        mdns.services_.erase({name, domain});
+      }
       RtspClient::stop(name, domain);
       mdns.on_remove_rtsp_source(name, domain);
       break;
@@ -193,16 +216,24 @@ void MDNSClient::client_callback(AvahiClient* client,
     case AVAHI_CLIENT_S_REGISTERING:
     case AVAHI_CLIENT_S_RUNNING:
     case AVAHI_CLIENT_S_COLLISION:
-      /* Create the service browser */
-      mdns.sb_.reset(avahi_service_browser_new(
-          client, mdns.config_->get_interface_idx(), AVAHI_PROTO_INET,
-          "_ravenna_session._sub._rtsp._tcp", nullptr, {}, browse_callback,
-          &mdns));
-      if (mdns.sb_ == nullptr) {
-        BOOST_LOG_TRIVIAL(fatal)
-            << "mdns_client:: failed to create service browser: "
-            << avahi_strerror(avahi_client_errno(mdns.client_.get()));
-        avahi_threaded_poll_quit(mdns.poll_.get());
+      /* Create the service browsers */
+      mdns.sbs_.clear();
+      mdns.services_.clear();
+      for (const auto& intf : mdns.config_->get_discovery_if_list()) {
+        mdns.sbs_.emplace_back(
+            avahi_service_browser_new(
+                client, intf.idx, AVAHI_PROTO_INET,
+                "_ravenna_session._sub._rtsp._tcp", nullptr, {},
+                browse_callback, &mdns),
+            &avahi_service_browser_free);
+        if (mdns.sbs_.back() == nullptr) {
+          BOOST_LOG_TRIVIAL(fatal)
+              << "mdns_client:: failed to create service browser on "
+              << intf.name << ": "
+              << avahi_strerror(avahi_client_errno(mdns.client_.get()));
+          avahi_threaded_poll_quit(mdns.poll_.get());
+          break;
+        }
       }
       break;
 
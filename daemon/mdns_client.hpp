@@ -30,6 +30,7 @@
 
 #include <future>
 #include <list>
+#include <map>
 #include <set>
 #include <shared_mutex>
 #include <thread>
@@ -51,6 +52,7 @@ class MDNSClient {
  protected:
   virtual void on_change_rtsp_source(const std::string& name,
                                      const std::string& domain,
+                                     const std::string& interface,
                                      const RtspSource& source){};
   virtual void on_remove_rtsp_source(const std::string& name,
                                      const std::string& domain){};
@@ -68,8 +70,10 @@ class MDNSClient {
       nullptr, &avahi_threaded_poll_free};
   std::unique_ptr<AvahiClient, decltype(&avahi_client_free)> client_{
       nullptr, &avahi_client_free};
-  std::unique_ptr<AvahiServiceBrowser, decltype(&avahi_service_browser_free)>
-      sb_{nullptr, &avahi_service_browser_free};
+  /* one service browser per discovery interface */
+  std::list<std::unique_ptr<AvahiServiceBrowser,
+                            decltype(&avahi_service_browser_free)> >
+      sbs_;
 
   static void resolve_callback(AvahiServiceResolver* r,
                                AvahiIfIndex interface,
@@ -99,6 +103,12 @@ class MDNSClient {
 
   std::set<std::pair<std::string /*name*/, std::string /*domain */> >
       active_resolvers;
+  /* interfaces where a service is currently announced */
+  std::map<std::pair<std::string /*name*/, std::string /*domain */>,
+           std::set<AvahiIfIndex> >
+      services_;
+
+  std::string get_interface_name_(AvahiIfIndex interface) const;
 
 #endif
 };
@@ -29,6 +29,7 @@
 #include <ostream>
 #include <string>
 
+#include "hash.hpp"
 #include "log.hpp"
 #include "utils.hpp"
 #include "rtsp_client.hpp"
@@ -194,9 +195,7 @@ std::pair<bool, RtspSource> RtspClient::process(RtspClient::Observer callback,
         }
       } else {
         std::stringstream ss;
-        ss << "rtsp:" << std::hex
-           << crc16(reinterpret_cast<const uint8_t*>(res.body.c_str()),
-                    res.body.length());
+        ss << "rtsp:" << std::hex << crc16(res.body);
         /*<< std::hex <<
          * ip::address_v4::from_string(address.c_str()).to_ulong();*/
         rtsp_source.id = ss.str();
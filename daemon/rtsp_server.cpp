@@ -98,7 +98,11 @@ bool RtspSession::announce(uint8_t id,
   return false;
 }
 
-bool RtspSession::process_request() {
+bool RtspSession::parse_request(const char* data,
+                                std::string& request,
+                                std::vector<std::string>& fields,
+                                int32_t& cseq,
+                                size_t& consumed) {
   /*
      DESCRIBE rtsp://127.0.0.1:8080/by-name/test RTSP/1.0
      CSeq: 312
@@ -106,40 +110,42 @@ bool RtspSession::process_request() {
      Accept: application/sdp
 
   */
-  data_[length_] = 0;
-  std::stringstream sstream(data_);
+  std::stringstream sstream(data);
   /* read the request */
-  if (!getline(sstream, request_, '\n')) {
+  if (!getline(sstream, request, '\n')) {
     return false;
   }
-  consumed_ = request_.length() + 1;
-  boost::trim(request_);
-  std::vector<std::string> fields;
-  split(fields, request_, boost::is_any_of(" "));
+  consumed = request.length() + 1;
+  boost::trim(request);
+  fields.clear();
+  split(fields, request, boost::is_any_of(" "));
   if (fields.size() < 3) {
     return false;
   }
   /* read the header */
-  bool is_end{false};
   std::string header;
   while (getline(sstream, header, '\n')) {
-    consumed_ += header.length() + 1;
+    consumed += header.length() + 1;
     if (header == "" || header == "\r") {
-      is_end = true;
-      break;
+      return true;
     }
     boost::to_lower(header);
     boost::trim(header);
     if (header.rfind("cseq:", 0) != std::string::npos) {
       try {
-        cseq_ = stoi(header.substr(5));
+        cseq = stoi(header.substr(5));
       } catch (...) {
         break;
       }
     }
   }
+  return false;
+}
 
-  if (!is_end) {
+bool RtspSession::process_request() {
+  data_[length_] = 0;
+  std::vector<std::string> fields;
+  if (!parse_request(data_, request_, fields, cseq_, consumed_)) {
     return false;
   }
 
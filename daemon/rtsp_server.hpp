@@ -62,6 +62,14 @@ class RtspSession : public std::enable_shared_from_this<RtspSession> {
                 const std::string& address,
                 uint16_t port);
 
+  /* parse the request line and header from the NUL terminated data,
+   * returns false if the request is incomplete or invalid */
+  static bool parse_request(const char* data,
+                            std::string& request,
+                            std::vector<std::string>& fields,
+                            int32_t& cseq,
+                            size_t& consumed);
+
  private:
   bool process_request();
   void build_response(const std::string& url);
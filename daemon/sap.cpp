@@ -99,23 +99,7 @@ bool SAP::receive(bool& is_announce,
     io_service_.run_one();
   } while (ec == boost::asio::error::would_block);
 
-  if (!ec && length > 4 && (buffer[0] == 0x20 || buffer[0] == 0x24)) {
-    // only accept SAP announce or delete v2 with IPv4
-    // no reserved, no compress, no encryption
-    // and content/type = application/sdp
-    is_announce = (buffer[0] == 0x20);
-    memcpy(&msg_id_hash, buffer + 2, sizeof(msg_id_hash));
-    memcpy(&addr, buffer + 4, sizeof(addr));
-    for (int i = 8; buffer[i] != 0 && i < static_cast<int>(length); i++) {
-      buffer[i] = std::tolower(buffer[i]);
-    }
-    if (!memcmp(buffer + 8, "application/sdp", 16)) {
-      sdp.assign(buffer + SAP::sap_header_len, buffer + length);
-      return true;
-    }
-  }
-
-  return false;
+  return !ec && decode(buffer, length, is_announce, msg_id_hash, addr, sdp);
 }
 
 void SAP::handle_receive(const boost::system::error_code& ec,
@@ -137,26 +121,60 @@ void SAP::check_deadline() {
   deadline_.async_wait(boost::bind(&SAP::check_deadline, this));
 }
 
-bool SAP::send(bool is_announce,
-               uint16_t msg_id_hash,
-               uint32_t addr,
-               const std::string& sdp) {
+size_t SAP::encode(bool is_announce,
+                   uint16_t msg_id_hash,
+                   uint32_t addr,
+                   const std::string& sdp,
+                   uint8_t* buffer) {
   if (sdp.length() > max_length - sap_header_len) {
-    BOOST_LOG_TRIVIAL(error) << "sap:: SDP is too long";
-    return false;
+    return 0;
   }
-  uint8_t buffer[max_length];
-
   buffer[0] = is_announce ? 0x20 : 0x24;
   buffer[1] = 0;
   memcpy(buffer + 2, &msg_id_hash, 2);
   memcpy(buffer + 4, &addr, 4);
   memcpy(buffer + 8, "application/sdp", 16); /* include trailing 0 */
   memcpy(buffer + sap_header_len, sdp.c_str(), sdp.length());
+  return sap_header_len + sdp.length();
+}
+
+bool SAP::decode(uint8_t* buffer,
+                 size_t length,
+                 bool& is_announce,
+                 uint16_t& msg_id_hash,
+                 uint32_t& addr,
+                 std::string& sdp) {
+  if (length >= sap_header_len && (buffer[0] == 0x20 || buffer[0] == 0x24)) {
+    // only accept SAP announce or delete v2 with IPv4
+    // no reserved, no compress, no encryption
+    // and content/type = application/sdp
+    is_announce = (buffer[0] == 0x20);
+    memcpy(&msg_id_hash, buffer + 2, sizeof(msg_id_hash));
+    memcpy(&addr, buffer + 4, sizeof(addr));
+    for (int i = 8; i < static_cast<int>(length) && buffer[i] != 0; i++) {
+      buffer[i] = std::tolower(buffer[i]);
+    }
+    if (!memcmp(buffer + 8, "application/sdp", 16)) {
+      sdp.assign(buffer + SAP::sap_header_len, buffer + length);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SAP::send(bool is_announce,
+               uint16_t msg_id_hash,
+               uint32_t addr,
+               const std::string& sdp) {
+  uint8_t buffer[max_length];
+  size_t length = encode(is_announce, msg_id_hash, addr, sdp, buffer);
+  if (!length) {
+    BOOST_LOG_TRIVIAL(error) << "sap:: SDP is too long";
+    return false;
+  }
 
   try {
-    socket_.send_to(boost::asio::buffer(buffer, sap_header_len + sdp.length()),
-                    remote_endpoint_);
+    socket_.send_to(boost::asio::buffer(buffer, length), remote_endpoint_);
   } catch (...) {
     BOOST_LOG_TRIVIAL(error) << "sap::send_to failed";
     return false;
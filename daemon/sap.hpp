@@ -50,6 +50,20 @@ class SAP {
                std::string& sdp,
                int tout_secs = 1);
 
+  /* build a SAP packet into buffer of max_length, returns its length or 0 */
+  static size_t encode(bool is_announce,
+                       uint16_t msg_id_hash,
+                       uint32_t addr,
+                       const std::string& sdp,
+                       uint8_t* buffer);
+  /* parse a SAP packet, the content type is converted to lowercase */
+  static bool decode(uint8_t* buffer,
+                     size_t length,
+                     bool& is_announce,
+                     uint16_t& msg_id_hash,
+                     uint32_t& addr,
+                     std::string& sdp);
+
  private:
   static void handle_receive(const boost::system::error_code& ec,
                              std::size_t length,
@@ -0,0 +1,243 @@
+//
+//  sdp_url_watcher.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <boost/algorithm/string.hpp>
+#include <list>
+#include <set>
+#include <tuple>
+
+#include "hash.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+#include "sdp_url_watcher.hpp"
+
+using namespace std::chrono;
+
+bool SdpUrlWatcher::init() {
+  if (!running_ && interval_secs_) {
+    BOOST_LOG_TRIVIAL(info) << "sdp_url_watcher:: checking SDP URLs every "
+                            << interval_secs_ << " secs";
+    running_ = true;
+    res_ = std::async(std::launch::async, &SdpUrlWatcher::worker, this);
+  }
+  return true;
+}
+
+bool SdpUrlWatcher::terminate() {
+  if (running_) {
+    running_ = false;
+    {
+      std::lock_guard watches_lock(watches_mutex_);
+    }
+    watches_cond_.notify_all();
+    return res_.get();
+  }
+  return true;
+}
+
+void SdpUrlWatcher::watch(uint8_t id,
+                          const std::string& url,
+                          const std::string& sdp,
+                          const std::string& etag,
+                          const std::string& last_modified) {
+  if (!interval_secs_) {
+    return;
+  }
+  auto const [ok, protocol, host, port, path] = parse_url(url);
+  if (!ok || !boost::iequals(protocol, "http")) {
+    unwatch(id);
+    return;
+  }
+
+  Watch watch;
+  watch.url = url;
+  watch.host = host;
+  watch.port = !atoi(port.c_str()) ? 80 : atoi(port.c_str());
+  watch.path = path;
+  watch.etag = etag;
+  watch.last_modified = last_modified;
+  watch.sdp_hash = hash64(sdp);
+  watch.next_check = steady_clock::now() + seconds(interval_secs_);
+
+  std::lock_guard watches_lock(watches_mutex_);
+  auto it = watches_.find(id);
+  if (it != watches_.end() && it->second.url == url &&
+      it->second.sdp_hash == watch.sdp_hash && etag.empty() &&
+      last_modified.empty()) {
+    /* sink restarted with the same SDP, keep the validators */
+    return;
+  }
+  BOOST_LOG_TRIVIAL(debug) << "sdp_url_watcher:: watching sink "
+                           << std::to_string(id) << " URL " << url;
+  watches_[id] = std::move(watch);
+}
+
+void SdpUrlWatcher::unwatch(uint8_t id) {
+  std::lock_guard watches_lock(watches_mutex_);
+  watches_.erase(id);
+}
+
+httplib::Client& SdpUrlWatcher::get_client_(const std::string& host,
+                                            int port) {
+  auto& cli = clients_[{host, port}];
+  if (cli == nullptr) {
+    cli = std::make_unique<httplib::Client>(host.c_str(), port);
+    cli->set_connection_timeout(timeout_secs);
+    cli->set_read_timeout(timeout_secs);
+    cli->set_write_timeout(timeout_secs);
+    cli->set_keep_alive(true);
+  }
+  return *cli;
+}
+
+bool SdpUrlWatcher::check_(Watch& watch, std::string& sdp) {
+  httplib::Headers headers;
+  if (!watch.etag.empty()) {
+    headers.emplace("If-None-Match", watch.etag);
+  }
+  if (!watch.last_modified.empty()) {
+    headers.emplace("If-Modified-Since", watch.last_modified);
+  }
+  auto res = get_client_(watch.host, watch.port).Get(watch.path.c_str(),
+                                                      headers);
+  if (!res) {
+    /* reconnect at the next check, the backoff doubles at every failure */
+    clients_.erase({watch.host, watch.port});
+    auto& backoff = backoffs_[{watch.host, watch.port}];
+    auto secs = std::min(static_cast<int64_t>(interval_secs_)
+                             << std::min(backoff.failures, 16U),
+                         static_cast<int64_t>(backoff_max_secs));
+    backoff.failures++;
+    backoff.retry_at = steady_clock::now() + seconds(secs);
+    BOOST_LOG_TRIVIAL(warning)
+        << "sdp_url_watcher:: cannot retrieve SDP from URL " << watch.url
+        << ", server checked again in " << secs << " secs";
+    return false;
+  }
+  backoffs_.erase({watch.host, watch.port});
+  if (res->status == 304) {
+    BOOST_LOG_TRIVIAL(debug)
+        << "sdp_url_watcher:: SDP from URL " << watch.url << " not modified";
+    return false;
+  }
+  if (res->status != 200) {
+    BOOST_LOG_TRIVIAL(warning)
+        << "sdp_url_watcher:: cannot retrieve SDP from URL " << watch.url
+        << " server reply " << res->status;
+    return false;
+  }
+  watch.etag = res->get_header_value("ETag");
+  watch.last_modified = res->get_header_value("Last-Modified");
+  auto sdp_hash = hash64(res->body);
+  if (sdp_hash == watch.sdp_hash) {
+    BOOST_LOG_TRIVIAL(debug)
+        << "sdp_url_watcher:: SDP from URL " << watch.url << " unchanged";
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "sdp_url_watcher:: SDP from URL " << watch.url
+                          << " changed";
+  watch.sdp_hash = sdp_hash;
+  sdp = std::move(res->body);
+  return true;
+}
+
+bool SdpUrlWatcher::is_backing_off_(const Watch& watch,
+                                    steady_clock::time_point& retry_at) const {
+  auto it = backoffs_.find({watch.host, watch.port});
+  if (it == backoffs_.end() || it->second.retry_at <= steady_clock::now()) {
+    return false;
+  }
+  retry_at = it->second.retry_at;
+  return true;
+}
+
+bool SdpUrlWatcher::worker() {
+  std::unique_lock watches_lock(watches_mutex_);
+  while (running_) {
+    auto now = steady_clock::now();
+    auto next_check = now + seconds(interval_secs_);
+    std::list<std::tuple<uint8_t, uint64_t /* hash */, Watch> > due;
+    for (auto& [id, watch] : watches_) {
+      if (watch.next_check <= now) {
+        steady_clock::time_point retry_at;
+        if (is_backing_off_(watch, retry_at)) {
+          watch.next_check = retry_at;
+        } else {
+          watch.next_check = now + seconds(interval_secs_);
+          due.emplace_back(id, watch.sdp_hash, watch);
+        }
+      }
+      next_check = std::min(next_check, watch.next_check);
+    }
+    if (due.empty()) {
+      watches_cond_.wait_until(watches_lock, next_check);
+      continue;
+    }
+
+    /* release the clients of the servers no longer watched */
+    std::set<std::pair<std::string, int> > servers;
+    for (auto const& [id, watch] : watches_) {
+      servers.emplace(watch.host, watch.port);
+    }
+    for (auto it = clients_.begin(); it != clients_.end();) {
+      it = servers.count(it->first) ? std::next(it) : clients_.erase(it);
+    }
+    for (auto it = backoffs_.begin(); it != backoffs_.end();) {
+      it = servers.count(it->first) ? std::next(it) : backoffs_.erase(it);
+    }
+    watches_lock.unlock();
+
+    std::list<std::tuple<uint8_t, std::string, std::string> > changed;
+    for (auto& [id, sdp_hash, watch] : due) {
+      if (!running_) {
+        break;
+      }
+      steady_clock::time_point retry_at;
+      if (is_backing_off_(watch, retry_at)) {
+        /* the server failed during this round, don't wait for it again */
+        std::lock_guard lock(watches_mutex_);
+        auto it = watches_.find(id);
+        if (it != watches_.end() && it->second.url == watch.url) {
+          it->second.next_check = retry_at;
+        }
+        continue;
+      }
+      std::string sdp;
+      bool is_changed = check_(watch, sdp);
+      std::lock_guard lock(watches_mutex_);
+      auto it = watches_.find(id);
+      /* skip sinks updated or removed meanwhile */
+      if (it != watches_.end() && it->second.url == watch.url &&
+          it->second.sdp_hash == sdp_hash) {
+        it->second.etag = watch.etag;
+        it->second.last_modified = watch.last_modified;
+        it->second.sdp_hash = watch.sdp_hash;
+        if (is_changed) {
+          changed.emplace_back(id, watch.url, std::move(sdp));
+        }
+      }
+    }
+
+    for (auto const& [id, url, sdp] : changed) {
+      observer_(id, url, sdp);
+    }
+    watches_lock.lock();
+  }
+  return true;
+}
@@ -0,0 +1,117 @@
+//
+//  sdp_url_watcher.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _SDP_URL_WATCHER_HPP_
+#define _SDP_URL_WATCHER_HPP_
+
+#include <httplib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*
+ * Revalidates the SDP of the sinks created from HTTP URLs.
+ * Requests are conditional (If-None-Match and If-Modified-Since) so an
+ * unchanged SDP costs a 304 reply, the observer is called only when the SDP
+ * content changes. Clients are pooled per server and kept alive between
+ * checks. An unreachable server is checked again with an exponential
+ * backoff, the other URLs of the server are skipped meanwhile.
+ */
+class SdpUrlWatcher {
+ public:
+  constexpr static time_t timeout_secs = 5;
+  constexpr static int backoff_max_secs = 300;
+
+  using Observer = std::function<void(uint8_t id,
+                                      const std::string& url,
+                                      const std::string& sdp)>;
+
+  SdpUrlWatcher(uint16_t interval_secs, Observer cb)
+      : interval_secs_(interval_secs), observer_(cb){};
+  SdpUrlWatcher() = delete;
+  SdpUrlWatcher(const SdpUrlWatcher&) = delete;
+  SdpUrlWatcher& operator=(const SdpUrlWatcher&) = delete;
+  ~SdpUrlWatcher() { terminate(); };
+
+  /* does nothing with a zero interval */
+  bool init();
+  bool terminate();
+
+  /* watch the URL of sink id, URLs other than HTTP are not watched.
+   * The validators returned with the SDP are optional, without them the
+   * first check downloads the SDP and compares it. */
+  void watch(uint8_t id,
+             const std::string& url,
+             const std::string& sdp,
+             const std::string& etag = "",
+             const std::string& last_modified = "");
+  void unwatch(uint8_t id);
+
+ protected:
+  struct Watch {
+    std::string url;
+    std::string host;
+    int port{80};
+    std::string path;
+    std::string etag;
+    std::string last_modified;
+    uint64_t sdp_hash{0};
+    std::chrono::steady_clock::time_point next_check;
+  };
+
+  /* unreachable server */
+  struct Backoff {
+    unsigned int failures{0};
+    std::chrono::steady_clock::time_point retry_at;
+  };
+
+  bool worker();
+  /* server unreachable, its URLs are not checked until retry_at */
+  bool is_backing_off_(const Watch& watch,
+                       std::chrono::steady_clock::time_point& retry_at) const;
+  /* conditional GET, returns true and the new SDP if it changed */
+  bool check_(Watch& watch, std::string& sdp);
+  httplib::Client& get_client_(const std::string& host, int port);
+
+  uint16_t interval_secs_;
+  Observer observer_;
+
+  std::map<uint8_t /* id */, Watch> watches_;
+  std::mutex watches_mutex_;
+  std::condition_variable watches_cond_;
+
+  /* connection pool and unreachable servers, used by the worker only */
+  std::map<std::pair<std::string /* host */, int /* port */>,
+           std::unique_ptr<httplib::Client> >
+      clients_;
+  std::map<std::pair<std::string /* host */, int /* port */>, Backoff>
+      backoffs_;
+
+  std::future<bool> res_;
+  std::atomic_bool running_{false};
+};
+
+#endif
@@ -25,12 +25,14 @@
 #include <boost/foreach.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <algorithm>
 #include <chrono>
 #include <experimental/map>
 #include <iostream>
 #include <map>
 #include <set>
 
+#include "hash.hpp"
 #include "json.hpp"
 #include "log.hpp"
 #include "rtsp_client.hpp"
@@ -284,6 +286,14 @@ std::shared_ptr<SessionManager> SessionManager::create(
   auto ptr =
       std::shared_ptr<SessionManager>(new SessionManager(driver, config));
   instance = ptr;
+  // a driver sample rate change requires a new PTP lock, poll it now
+  std::weak_ptr<SessionManager> session_manager = ptr;
+  driver->add_event_observer([session_manager](enum MT_ALSA_msg_id id) {
+    auto ptr = session_manager.lock();
+    if (ptr != nullptr && id == MT_ALSA_Msg_SetSampleRate) {
+      ptr->trigger_ptp_poll();
+    }
+  });
   return ptr;
 }
 
@@ -332,6 +342,91 @@ std::list<StreamSource> SessionManager::get_sources() const {
   return sources_list;
 }
 
+std::list<McastCollision> SessionManager::get_mcast_collisions() const {
+  std::list<McastCollision> collisions;
+  std::shared_lock sources_lock(sources_mutex_);
+  std::lock_guard mcast_lock(mcast_allocator_mutex_);
+  for (auto const& [id, info] : sources_) {
+    auto remote_ids = mcast_allocator_.get_remote(info.stream.m_ui32DestIP);
+    if (!remote_ids.empty()) {
+      collisions.push_back(
+          {id, ip::address_v4(info.stream.m_ui32DestIP).to_string(),
+           std::move(remote_ids)});
+    }
+  }
+  return collisions;
+}
+
+void SessionManager::add_remote_session(const std::string& id,
+                                        const std::string& address,
+                                        const std::string& sdp) {
+  if (address == config_->get_ip_addr_str()) {
+    /* our own sources announced back to us */
+    return;
+  }
+  std::set<uint32_t> addrs;
+  {
+    std::lock_guard mcast_lock(mcast_allocator_mutex_);
+    mcast_allocator_.add_remote(id, sdp);
+    for (auto addr : McastAllocator::get_sdp_addresses(sdp)) {
+      addrs.insert(addr);
+    }
+  }
+  std::shared_lock sources_lock(sources_mutex_);
+  for (auto const& [source_id, info] : sources_) {
+    if (addrs.count(info.stream.m_ui32DestIP)) {
+      BOOST_LOG_TRIVIAL(warning)
+          << "session_manager:: source " << std::to_string(source_id)
+          << " multicast address "
+          << ip::address_v4(info.stream.m_ui32DestIP).to_string()
+          << " is also used by remote session " << id;
+    }
+  }
+}
+
+void SessionManager::remove_remote_session(const std::string& id) {
+  std::lock_guard mcast_lock(mcast_allocator_mutex_);
+  mcast_allocator_.remove_remote(id);
+}
+
+uint32_t SessionManager::allocate_mcast_addr_(uint8_t id) const {
+  uint32_t base =
+      ip::address_v4::from_string(config_->get_rtp_mcast_base().c_str())
+          .to_ulong();
+  std::list<uint32_t> preferred;
+  std::set<uint32_t> in_use;
+  uint32_t current_addr = 0;
+  std::string current_session_id;
+  for (auto const& [source_id, info] : sources_) {
+    if (source_id == id) {
+      /* keep the current address of an updated source */
+      current_addr = info.stream.m_ui32DestIP;
+      current_session_id = std::to_string(info.session_id);
+      preferred.push_back(current_addr);
+    } else {
+      in_use.insert(info.stream.m_ui32DestIP);
+    }
+  }
+  {
+    std::shared_lock sinks_lock(sinks_mutex_);
+    for (auto const& [sink_id, info] : sinks_) {
+      if (current_addr && info.stream.m_ui32DestIP == current_addr) {
+        /* a local sink receiving the updated source doesn't collide */
+        auto [ok, username, session_id, version, address] =
+            sdp_get_origin(info.sink_sdp);
+        if (ok && session_id == current_session_id &&
+            address == config_->get_ip_addr_str()) {
+          continue;
+        }
+      }
+      in_use.insert(info.stream.m_ui32DestIP);
+    }
+  }
+  preferred.push_back(base + id);
+  std::lock_guard mcast_lock(mcast_allocator_mutex_);
+  return mcast_allocator_.allocate(preferred, in_use);
+}
+
 StreamSource SessionManager::get_source_(uint8_t id,
                                          const StreamInfo& info) const {
   return {id,
@@ -359,7 +454,8 @@ StreamSink SessionManager::get_sink_(uint8_t id, const StreamInfo& info) const {
           info.stream.m_ui32PlayOutDelay,
           info.ignore_refclk_gmid,
           {info.stream.m_aui32Routing,
-           info.stream.m_aui32Routing + info.stream.m_byNbOfChannels}};
+           info.stream.m_aui32Routing + info.stream.m_byNbOfChannels},
+          info.sink_sdp_from_url};
 }
 
 bool SessionManager::load_status() {
@@ -491,16 +587,22 @@ std::error_code SessionManager::add_source(const StreamSource& source) {
   info.stream.m_uiId = source.id;
   info.stream.m_ui32RTCPSrcIP = config_->get_ip_addr();
   info.stream.m_ui32SrcIP = config_->get_ip_addr();  // only for Source
+  std::unique_lock sources_lock(sources_mutex_, std::defer_lock);
   boost::system::error_code ec;
   ip::address_v4::from_string(source.address, ec);
   if (!ec) {
     info.stream.m_ui32DestIP =
         ip::address_v4::from_string(source.address).to_ulong();
   } else {
-    info.stream.m_ui32DestIP =
-        ip::address_v4::from_string(config_->get_rtp_mcast_base().c_str())
-            .to_ulong() +
-        source.id;
+    /* hold the sources lock until the allocated address is in sources_ */
+    sources_lock.lock();
+    info.stream.m_ui32DestIP = allocate_mcast_addr_(source.id);
+    if (!info.stream.m_ui32DestIP) {
+      BOOST_LOG_TRIVIAL(error)
+          << "session_manager:: no free multicast address for source "
+          << std::to_string(source.id);
+      return DaemonErrc::mcast_pool_exhausted;
+    }
   }
   info.stream.m_usSrcPort = config_->get_rtp_port();
   info.stream.m_usDestPort = config_->get_rtp_port();
@@ -542,7 +644,9 @@ std::error_code SessionManager::add_source(const StreamSource& source) {
   info.session_version = info.session_id + g_session_version++;
   // info.m_ui32PlayOutDelay = 0; // only for Sink
 
-  std::unique_lock sources_lock(sources_mutex_);
+  if (!sources_lock.owns_lock()) {
+    sources_lock.lock();
+  }
   auto const it = sources_.find(source.id);
   if (it != sources_.end()) {
     BOOST_LOG_TRIVIAL(info)
@@ -692,6 +796,21 @@ uint8_t SessionManager::get_sink_id(const std::string& name) const {
   return it != sink_names_.end() ? it->second : (stream_id_max + 1);
 }
 
+void SessionManager::add_sink_observer(SinkObserverType type, Observer cb) {
+  switch (type) {
+    case SinkObserverType::add_sink:
+      add_sink_observers.push_back(cb);
+      break;
+    case SinkObserverType::remove_sink:
+      remove_sink_observers.push_back(cb);
+      break;
+  }
+}
+
+void SessionManager::add_ptp_status_observer(PtpStatusObserver cb) {
+  ptp_status_observers.push_back(cb);
+}
+
 void SessionManager::on_add_sink(const StreamSink& sink,
                                  const StreamInfo& info) {
   if (IN_MULTICAST(info.stream.m_ui32DestIP)) {
@@ -702,6 +821,9 @@ void SessionManager::on_add_sink(const StreamSink& sink,
 }
 
 void SessionManager::on_remove_sink(const StreamInfo& info) {
+  sinks_status_pending_mutex_.lock();
+  sinks_status_pending_.erase(info.stream.m_uiId);
+  sinks_status_pending_mutex_.unlock();
   if (IN_MULTICAST(info.stream.m_ui32DestIP)) {
     igmp_.leave(config_->get_ip_addr_str(),
                 ip::address_v4(info.stream.m_ui32DestIP).to_string());
@@ -709,6 +831,21 @@ void SessionManager::on_remove_sink(const StreamInfo& info) {
   sink_names_.erase(info.stream.m_cName);
 }
 
+void SessionManager::notify_add_sink_(uint8_t id,
+                                      const std::string& name,
+                                      const std::string& sdp) const {
+  for (auto cb : add_sink_observers) {
+    cb(id, name, sdp);
+  }
+}
+
+void SessionManager::notify_remove_sink_(uint8_t id,
+                                         const std::string& name) const {
+  for (auto cb : remove_sink_observers) {
+    cb(id, name, {});
+  }
+}
+
 std::error_code SessionManager::add_sink(const StreamSink& sink) {
   if (sink.id > stream_id_max) {
     BOOST_LOG_TRIVIAL(error) << "session_manager:: sink id "
@@ -730,6 +867,8 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
   info.ignore_refclk_gmid = sink.ignore_refclk_gmid;
   info.io = sink.io;
 
+  /* validators of the SDP retrieved via HTTP */
+  std::string etag, last_modified;
   if (!sink.use_sdp) {
     auto const [ok, protocol, host, port, path] = parse_url(sink.source);
     if (!ok) {
@@ -758,6 +897,8 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
         return DaemonErrc::cannot_retrieve_sdp;
       }
       sdp = std::move(res->body);
+      etag = res->get_header_value("ETag");
+      last_modified = res->get_header_value("Last-Modified");
     } else if (boost::iequals(protocol, "rtsp")) {
       auto res = RtspClient::describe(path, host, port);
       if (!res.first) {
@@ -792,6 +933,8 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
   }
   info.sink_source = sink.source;
   info.sink_use_sdp = true;  // save back and use with SDP file
+  /* only an SDP retrieved from the source URL is watched for changes */
+  info.sink_sdp_from_url = !sink.use_sdp || sink.sdp_from_url;
 
   info.stream.m_ui32FrameSize = info.stream.m_ui32MaxSamplesPerPacket;
   if (!info.stream.m_ui32FrameSize) {
@@ -810,13 +953,16 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
 
   std::unique_lock sinks_lock(sinks_mutex_);
   auto const it = sinks_.find(sink.id);
-  if (it != sinks_.end()) {
+  bool is_update = it != sinks_.end();
+  std::string removed_name;
+  if (is_update) {
     BOOST_LOG_TRIVIAL(info)
         << "session_manager:: sink id " << std::to_string(sink.id)
         << " is in use, updating";
     // remove previous stream
     (void)driver_->remove_rtp_stream((*it).second.handle);
     on_remove_sink((*it).second);
+    removed_name = (*it).second.stream.m_cName;
   } else if (sink_names_.find(sink.name) != sink_names_.end()) {
     BOOST_LOG_TRIVIAL(error)
         << "session_manager:: sink name " << sink.name << " is in use";
@@ -825,9 +971,12 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
 
   auto ret = driver_->add_rtp_stream(info.stream, info.handle);
   if (ret) {
-    if (it != sinks_.end()) {
+    if (is_update) {
       /* update operation failed */
       sinks_.erase(sink.id);
+      sdp_url_watcher_.unwatch(sink.id);
+      sinks_lock.unlock();
+      notify_remove_sink_(sink.id, removed_name);
     }
     return ret;
   }
@@ -835,8 +984,19 @@ std::error_code SessionManager::add_sink(const StreamSink& sink) {
   on_add_sink(sink, info);
   // update sinks map
   sinks_[sink.id] = info;
+  if (info.sink_sdp_from_url) {
+    sdp_url_watcher_.watch(sink.id, info.sink_source, info.sink_sdp, etag,
+                           last_modified);
+  } else {
+    sdp_url_watcher_.unwatch(sink.id);
+  }
   BOOST_LOG_TRIVIAL(info) << "session_manager:: added sink "
                           << std::to_string(sink.id) << " " << info.handle;
+  sinks_lock.unlock();
+  if (is_update) {
+    notify_remove_sink_(sink.id, removed_name);
+  }
+  notify_add_sink_(sink.id, sink.name, info.sink_sdp);
   return ret;
 }
 
@@ -861,15 +1021,48 @@ std::error_code SessionManager::remove_sink(uint32_t id) {
     igmp_.leave(config_->get_ip_addr_str(),
                 ip::address_v4(info.stream.m_ui32DestIP).to_string());
     on_remove_sink(info);
+    std::string name(info.stream.m_cName);
     sinks_.erase(id);
+    sdp_url_watcher_.unwatch(id);
+    sinks_lock.unlock();
+    notify_remove_sink_(id, name);
   }
 
   return ret;
 }
 
+static void merge_sink_status(SinkStreamStatus& status,
+                              const SinkStreamStatus& other) {
+  status.is_rtp_seq_id_error |= other.is_rtp_seq_id_error;
+  status.is_rtp_ssrc_error |= other.is_rtp_ssrc_error;
+  status.is_rtp_payload_type_error |= other.is_rtp_payload_type_error;
+  status.is_rtp_sac_error |= other.is_rtp_sac_error;
+  status.is_receiving_rtp_packet |= other.is_receiving_rtp_packet;
+  status.is_muted |= other.is_muted;
+  status.is_some_muted |= other.is_some_muted;
+  status.is_all_muted |= other.is_all_muted;
+  status.min_time = std::min(status.min_time, other.min_time);
+}
+
 std::error_code SessionManager::get_sink_status(
     uint32_t id,
     SinkStreamStatus& sink_status) const {
+  auto ret = read_sink_status_(id, sink_status);
+  if (!ret) {
+    // add what the status sampler read since the previous call
+    std::lock_guard pending_lock(sinks_status_pending_mutex_);
+    auto it = sinks_status_pending_.find(id);
+    if (it != sinks_status_pending_.end()) {
+      merge_sink_status(sink_status, it->second);
+      sinks_status_pending_.erase(it);
+    }
+  }
+  return ret;
+}
+
+std::error_code SessionManager::read_sink_status_(
+    uint32_t id,
+    SinkStreamStatus& sink_status) const {
   if (id > stream_id_max) {
     BOOST_LOG_TRIVIAL(error) << "session_manager:: sink id "
                              << std::to_string(id) << " is not valid";
@@ -902,6 +1095,427 @@ std::error_code SessionManager::get_sink_status(
   return ret;
 }
 
+std::error_code SessionManager::get_sink_delay_tuning(
+    uint32_t id,
+    SinkDelayTuning& tuning) const {
+  StreamSink sink;
+  if (id > stream_id_max) {
+    BOOST_LOG_TRIVIAL(error) << "session_manager:: sink id "
+                             << std::to_string(id) << " is not valid";
+    return DaemonErrc::invalid_stream_id;
+  }
+  auto ret = get_sink(id, sink);
+  if (ret) {
+    return ret;
+  }
+
+  std::unique_lock tuning_lock(sinks_delay_tuning_mutex_);
+  auto const it = sinks_delay_tuning_.find(id);
+  if (it != sinks_delay_tuning_.end()) {
+    tuning = it->second;
+  } else {
+    // sink not sampled yet
+    tuning = SinkDelayTuning{};
+    tuning.delay = sink.delay;
+  }
+  tuning.mode = config_->get_sink_delay_tuning();
+  return std::error_code{};
+}
+
+std::error_code SessionManager::get_sink_status_history(
+    uint32_t id,
+    uint32_t from,
+    uint32_t to,
+    std::list<SinkStatusSample>& samples,
+    uint32_t& now) const {
+  StreamSink sink;
+  if (id > stream_id_max) {
+    BOOST_LOG_TRIVIAL(error) << "session_manager:: sink id "
+                             << std::to_string(id) << " is not valid";
+    return DaemonErrc::invalid_stream_id;
+  }
+  auto ret = get_sink(id, sink);
+  if (ret) {
+    return ret;
+  }
+
+  now = static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::steady_clock::now() - startup_)
+          .count());
+  std::unique_lock history_lock(sinks_status_history_mutex_);
+  auto const it = sinks_status_history_.find(id);
+  if (it != sinks_status_history_.end()) {
+    samples = it->second.get(from, std::min(to, now));
+  } else {
+    // sink not sampled yet or history disabled
+    samples.clear();
+  }
+  return std::error_code{};
+}
+
+bool SessionManager::on_sink_delay_tuning_window(
+    uint8_t id,
+    uint32_t frame_size,
+    uint32_t now,
+    SinkDelayTuning& tuning) const {
+  auto& window = tuning.window;
+  window.end_time = now;
+  uint32_t margin = config_->get_sink_delay_tuning_margin();
+  if (window.errors || window.muted) {
+    // packets lost or late, increase the delay
+    window.recommended_delay =
+        std::min(window.delay + std::max(margin, frame_size), sink_delay_max);
+  } else if (window.samples) {
+    // use the lowest measured margin plus the safety margin
+    int64_t delay =
+        static_cast<int64_t>(window.delay) - window.min_time + margin;
+    window.recommended_delay = static_cast<uint32_t>(std::clamp<int64_t>(
+        delay, frame_size, sink_delay_max));
+  }
+
+  bool apply = false;
+  if (window.recommended_delay) {
+    tuning.recommended_delay = window.recommended_delay;
+    BOOST_LOG_TRIVIAL(info)
+        << "session_manager:: sink " << std::to_string(id) << " delay "
+        << window.delay << " min time " << window.min_time << " errors "
+        << window.errors << " muted " << window.muted
+        << " recommended delay " << window.recommended_delay;
+    // increase immediately, decrease only if worth a sink restart
+    apply = tuning.mode == "apply" &&
+            (window.recommended_delay > window.delay ||
+             window.delay - window.recommended_delay >= margin);
+  }
+
+  tuning.history.push_front(window);
+  if (tuning.history.size() > sink_delay_tuning_history_max) {
+    tuning.history.pop_back();
+  }
+  window = SinkDelayTuningWindow{};
+  window.start_time = now;
+  window.delay = tuning.delay;
+  return apply;
+}
+
+void SessionManager::process_sinks_status() {
+  // retrieve delay and frame size of current sinks
+  std::map<uint8_t, std::pair<uint32_t, uint32_t> > sinks;
+  sinks_mutex_.lock_shared();
+  for (auto const& [id, info] : sinks_) {
+    sinks[id] = {info.stream.m_ui32PlayOutDelay, info.stream.m_ui32FrameSize};
+  }
+  sinks_mutex_.unlock_shared();
+
+  auto now = static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::steady_clock::now() - startup_)
+          .count());
+  auto mode = config_->get_sink_delay_tuning();
+  uint32_t history_secs = config_->get_sink_status_history_hours() * 3600;
+  /* recommended delay and window measured, by sink id */
+  std::map<uint8_t, std::pair<uint32_t, SinkDelayTuningWindow> > apply_delays;
+  for (auto const& [id, params] : sinks) {
+    auto const [delay, frame_size] = params;
+    SinkStreamStatus status;
+    if (read_sink_status_(id, status)) {
+      continue;
+    }
+    {
+      // keep it for the next get_sink_status(), the driver clears on read
+      std::lock_guard pending_lock(sinks_status_pending_mutex_);
+      auto [it, inserted] = sinks_status_pending_.emplace(id, status);
+      if (!inserted) {
+        merge_sink_status(it->second, status);
+      }
+    }
+
+    if (history_secs) {
+      // pack the flags using the driver bit layout
+      uint8_t flags = (status.is_rtp_seq_id_error ? 0x01 : 0) |
+                      (status.is_rtp_ssrc_error ? 0x02 : 0) |
+                      (status.is_rtp_payload_type_error ? 0x04 : 0) |
+                      (status.is_rtp_sac_error ? 0x08 : 0) |
+                      (status.is_receiving_rtp_packet ? 0x10 : 0) |
+                      (status.is_muted ? 0x20 : 0) |
+                      (status.is_some_muted ? 0x40 : 0) |
+                      (status.is_all_muted ? 0x80 : 0);
+      std::unique_lock history_lock(sinks_status_history_mutex_);
+      auto it = sinks_status_history_.find(id);
+      if (it == sinks_status_history_.end()) {
+        it = sinks_status_history_.emplace(id, SinkStatusHistory(history_secs))
+                 .first;
+      }
+      it->second.add(now, flags, status.min_time);
+    }
+
+    if (mode == "off") {
+      continue;
+    }
+    std::unique_lock tuning_lock(sinks_delay_tuning_mutex_);
+    auto it = sinks_delay_tuning_.find(id);
+    if (it == sinks_delay_tuning_.end() || it->second.delay != delay) {
+      // new sink or delay changed, restart measurement
+      auto& tuning = sinks_delay_tuning_[id];
+      tuning.delay = delay;
+      tuning.window = SinkDelayTuningWindow{};
+      tuning.window.start_time = now;
+      tuning.window.delay = delay;
+      it = sinks_delay_tuning_.find(id);
+    }
+    auto& tuning = it->second;
+    tuning.mode = mode;
+
+    auto& window = tuning.window;
+    if (status.is_receiving_rtp_packet) {
+      if (!window.samples || status.min_time < window.min_time) {
+        window.min_time = status.min_time;
+      }
+      window.samples++;
+      if (status.is_rtp_seq_id_error || status.is_rtp_ssrc_error ||
+          status.is_rtp_payload_type_error || status.is_rtp_sac_error) {
+        window.errors++;
+      }
+      if (status.is_muted) {
+        window.muted++;
+      }
+    }
+
+    if (now - window.start_time >= config_->get_sink_delay_tuning_window()) {
+      if (on_sink_delay_tuning_window(id, frame_size, now, tuning)) {
+        apply_delays[id] = {tuning.recommended_delay, tuning.history.front()};
+      }
+    }
+  }
+
+  // forget removed sinks
+  sinks_delay_tuning_mutex_.lock();
+  std::experimental::erase_if(sinks_delay_tuning_,
+                              [&sinks](auto const& tuning) {
+                                return sinks.find(tuning.first) == sinks.end();
+                              });
+  sinks_delay_tuning_mutex_.unlock();
+  sinks_status_history_mutex_.lock();
+  std::experimental::erase_if(sinks_status_history_,
+                              [&sinks](auto const& history) {
+                                return sinks.find(history.first) == sinks.end();
+                              });
+  sinks_status_history_mutex_.unlock();
+  sinks_status_pending_mutex_.lock();
+  std::experimental::erase_if(sinks_status_pending_,
+                              [&sinks](auto const& pending) {
+                                return sinks.find(pending.first) == sinks.end();
+                              });
+  sinks_status_pending_mutex_.unlock();
+
+  // apply the recommended delays with a job, this restarts the sinks
+  for (auto const& [id, apply] : apply_delays) {
+    auto const [delay, window] = apply;
+    submit_job_("add_sink", id, [this, id = id, delay = delay,
+                                 window = window]() {
+      StreamSink sink;
+      auto ret = get_sink(id, sink);
+      if (ret || sink.delay != window.delay) {
+        /* sink removed or updated since the measurement */
+        BOOST_LOG_TRIVIAL(info)
+            << "session_manager:: sink " << std::to_string(id)
+            << " changed, dropping recommended delay " << delay;
+        return std::error_code{};
+      }
+      BOOST_LOG_TRIVIAL(info) << "session_manager:: sink "
+                              << std::to_string(id) << " applying delay "
+                              << delay;
+      sink.delay = delay;
+      ret = add_sink(sink);
+      if (ret) {
+        BOOST_LOG_TRIVIAL(error)
+            << "session_manager:: failed to apply delay to sink "
+            << std::to_string(id) << " : " << ret.message();
+        return ret;
+      }
+      std::unique_lock tuning_lock(sinks_delay_tuning_mutex_);
+      auto it = sinks_delay_tuning_.find(id);
+      if (it != sinks_delay_tuning_.end()) {
+        for (auto& entry : it->second.history) {
+          if (entry.start_time == window.start_time) {
+            entry.applied = true;
+            break;
+          }
+        }
+      }
+      return ret;
+    });
+  }
+}
+
+uint32_t SessionManager::submit_job_(const std::string& operation,
+                                     uint8_t stream_id,
+                                     std::function<std::error_code()> fn) {
+  std::unique_lock jobs_lock(jobs_mutex_);
+  StreamJob job;
+  job.id = ++last_job_id_;
+  job.operation = operation;
+  job.stream_id = stream_id;
+  if (!running_) {
+    job.status = "failed";
+    job.error = DaemonErrc::job_cancelled;
+    jobs_[job.id] = job;
+    return job.id;
+  }
+  job.status = "pending";
+  jobs_[job.id] = job;
+  jobs_queue_.push_back(
+      {job.id, {operation == "add_source", stream_id}, std::move(fn)});
+  jobs_lock.unlock();
+  jobs_queue_cond_.notify_one();
+  BOOST_LOG_TRIVIAL(info) << "session_manager:: queued job " << job.id << " "
+                          << operation << " " << std::to_string(stream_id);
+  return job.id;
+}
+
+void SessionManager::on_sink_sdp_changed(uint8_t id,
+                                         const std::string& url,
+                                         const std::string& sdp) {
+  submit_job_("add_sink", id, [this, id, url, sdp]() {
+    StreamSink sink;
+    auto ret = get_sink(id, sink);
+    if (ret || sink.source != url) {
+      /* sink removed or updated meanwhile */
+      return ret;
+    }
+    BOOST_LOG_TRIVIAL(info) << "session_manager:: sink " << std::to_string(id)
+                            << " updating SDP from URL " << url;
+    sink.use_sdp = true;
+    sink.sdp = sdp;
+    sink.sdp_from_url = true;
+    return add_sink(sink);
+  });
+}
+
+uint32_t SessionManager::add_source_job(const StreamSource& source) {
+  return submit_job_("add_source", source.id,
+                     [this, source]() { return add_source(source); });
+}
+
+uint32_t SessionManager::add_sink_job(const StreamSink& sink) {
+  return submit_job_("add_sink", sink.id,
+                     [this, sink]() { return add_sink(sink); });
+}
+
+std::error_code SessionManager::get_job(uint32_t id,
+                                        StreamJob& job,
+                                        int wait_secs) const {
+  std::unique_lock jobs_lock(jobs_mutex_);
+  auto is_completed = [this, id]() {
+    auto const it = jobs_.find(id);
+    return it == jobs_.end() || it->second.status == "done" ||
+           it->second.status == "failed";
+  };
+  if (wait_secs > 0) {
+    jobs_done_cond_.wait_for(
+        jobs_lock,
+        std::chrono::seconds(std::min(wait_secs, job_wait_max_secs)),
+        is_completed);
+  }
+  auto const it = jobs_.find(id);
+  if (it == jobs_.end()) {
+    BOOST_LOG_TRIVIAL(error) << "session_manager:: job " << id << " not found";
+    return DaemonErrc::job_id_not_found;
+  }
+  job = it->second;
+  return std::error_code{};
+}
+
+std::list<StreamJob> SessionManager::get_jobs() const {
+  std::list<StreamJob> jobs_list;
+  std::unique_lock jobs_lock(jobs_mutex_);
+  for (auto const& [id, job] : jobs_) {
+    jobs_list.push_back(job);
+  }
+  return jobs_list;
+}
+
+bool SessionManager::job_worker() {
+  std::unique_lock jobs_lock(jobs_mutex_);
+  while (running_) {
+    // pick the first job whose stream has no other job running
+    auto it = jobs_queue_.begin();
+    auto find_runnable = [this, &it]() {
+      it = std::find_if(jobs_queue_.begin(), jobs_queue_.end(),
+                        [this](const PendingJob& job) {
+                          return jobs_busy_streams_.find(job.stream) ==
+                                 jobs_busy_streams_.end();
+                        });
+      return !running_ || it != jobs_queue_.end();
+    };
+    jobs_queue_cond_.wait(jobs_lock, find_runnable);
+    if (!running_) {
+      break;
+    }
+
+    PendingJob pending = std::move(*it);
+    jobs_queue_.erase(it);
+    jobs_busy_streams_.insert(pending.stream);
+    jobs_[pending.id].status = "running";
+    jobs_lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    auto ret = pending.fn();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+    jobs_lock.lock();
+    jobs_busy_streams_.erase(pending.stream);
+    auto& job = jobs_[pending.id];
+    job.status = ret ? "failed" : "done";
+    job.error = ret;
+    job.duration_ms = static_cast<uint32_t>(duration);
+    BOOST_LOG_TRIVIAL(info)
+        << "session_manager:: job " << job.id << " " << job.operation << " "
+        << std::to_string(job.stream_id) << " " << job.status << " in "
+        << job.duration_ms << " ms";
+
+    // drop oldest completed jobs from history
+    size_t completed = 0;
+    for (auto const& [id, info] : jobs_) {
+      if (info.status == "done" || info.status == "failed") {
+        completed++;
+      }
+    }
+    for (auto jit = jobs_.begin();
+         jit != jobs_.end() && completed > job_history_max;) {
+      if (jit->second.status == "done" || jit->second.status == "failed") {
+        jit = jobs_.erase(jit);
+        completed--;
+      } else {
+        ++jit;
+      }
+    }
+
+    jobs_done_cond_.notify_all();
+    // a stream may have been released, wake up other workers
+    jobs_queue_cond_.notify_all();
+  }
+  return true;
+}
+
+void SessionManager::cancel_jobs_() {
+  std::unique_lock jobs_lock(jobs_mutex_);
+  for (auto const& pending : jobs_queue_) {
+    auto& job = jobs_[pending.id];
+    job.status = "failed";
+    job.error = DaemonErrc::job_cancelled;
+    BOOST_LOG_TRIVIAL(info)
+        << "session_manager:: job " << job.id << " " << job.operation << " "
+        << std::to_string(job.stream_id) << " cancelled";
+  }
+  jobs_queue_.clear();
+  jobs_lock.unlock();
+  // wake up the clients waiting for a job
+  jobs_done_cond_.notify_all();
+}
+
 std::error_code SessionManager::set_ptp_config(const PTPConfig& config) {
   TPTPConfig ptp_config;
   ptp_config.ui8Domain = config.domain;
@@ -910,6 +1524,8 @@ std::error_code SessionManager::set_ptp_config(const PTPConfig& config) {
   if (!ret) {
     std::unique_lock ptp_lock(ptp_mutex_);
     ptp_config_ = config;
+    ptp_lock.unlock();
+    trigger_ptp_poll();
   }
   return ret;
 }
@@ -924,6 +1540,30 @@ void SessionManager::get_ptp_status(PTPStatus& status) const {
   status = ptp_status_;
 }
 
+void SessionManager::sap_send_(bool is_announce,
+                               uint16_t msg_id_hash,
+                               uint32_t addr,
+                               const std::string& sdp) {
+  auto send = [&]() {
+    if (is_announce) {
+      sap_.announcement(msg_id_hash, addr, sdp);
+    } else {
+      sap_.deletion(msg_id_hash, addr, sdp);
+    }
+  };
+  const auto& interfaces = config_->get_discovery_if_list();
+  if (interfaces.size() <= 1) {
+    /* outbound interface set by the worker */
+    send();
+    return;
+  }
+  for (const auto& intf : interfaces) {
+    if (!intf.ip_str.empty() && sap_.set_multicast_interface(intf.ip_str)) {
+      send();
+    }
+  }
+}
+
 size_t SessionManager::process_sap() {
   size_t sdp_len_sum = 0;
   // set to contain sources currently announced
@@ -936,8 +1576,7 @@ size_t SessionManager::process_sap() {
       // retrieve current active source SDP
       auto sdp = get_source_sdp_(id, info);
       // compute source 16bit crc
-      uint16_t msg_crc =
-          crc16(reinterpret_cast<const uint8_t*>(sdp.c_str()), sdp.length());
+      uint16_t msg_crc = crc16(sdp);
       // compute source hash
       uint32_t msg_id_hash = (static_cast<uint32_t>(id) << 16) + msg_crc;
       // add/update this source in the announced sources
@@ -948,7 +1587,7 @@ size_t SessionManager::process_sap() {
       // remove this source from deleted sources (if present)
       deleted_sources_count_.erase(msg_id_hash);
       // send announcement for this source
-      sap_.announcement(msg_crc, info.stream.m_ui32RTCPSrcIP, sdp);
+      sap_send_(true, msg_crc, info.stream.m_ui32RTCPSrcIP, sdp);
       // update amount of byte sent
       sdp_len_sum += sdp.length();
     }
@@ -965,7 +1604,7 @@ size_t SessionManager::process_sap() {
       std::string sdp = get_removed_source_sdp_(msg_id_hash >> 16, src_addr,
                                                 session_id, session_version);
       // send deletion for this source
-      sap_.deletion(static_cast<uint16_t>(msg_id_hash), src_addr, sdp);
+      sap_send_(false, static_cast<uint16_t>(msg_id_hash), src_addr, sdp);
       // update amount of byte sent
       sdp_len_sum += sdp.length();
       // increase count
@@ -1007,6 +1646,14 @@ void SessionManager::on_ptp_status_locked() const {
   (void)driver_->set_sample_rate(driver_->get_current_sample_rate());
 }
 
+void SessionManager::trigger_ptp_poll() {
+  ptp_poll_now_ = true;
+  {
+    std::lock_guard worker_lock(worker_mutex_);
+  }
+  worker_cond_.notify_all();
+}
+
 using namespace std::chrono;
 using second_t = duration<double, std::ratio<1> >;
 
@@ -1015,8 +1662,11 @@ bool SessionManager::worker() {
   TPTPStatus ptp_status;
   auto sap_timepoint = steady_clock::now();
   auto ptp_timepoint = steady_clock::now();
+  auto sinks_status_timepoint = steady_clock::now();
+  // reference for the time to PTP lock and to audio measurements
+  auto ptp_unlock_timepoint = steady_clock::now();
   int sap_interval = 1;
-  int ptp_interval = 0;
+  int ptp_interval_ms = 0;
   uint32_t sample_rate = driver_->get_current_sample_rate();
 
   sap_.set_multicast_interface(config_->get_ip_addr_str());
@@ -1026,14 +1676,17 @@ bool SessionManager::worker() {
 
   while (running_) {
     // check if it's time to update the PTP status
-    if ((duration_cast<second_t>(steady_clock::now() - ptp_timepoint).count()) >
-        ptp_interval) {
+    if (ptp_poll_now_ ||
+        steady_clock::now() - ptp_timepoint >=
+            milliseconds(ptp_interval_ms)) {
+      ptp_poll_now_ = false;
       ptp_timepoint = steady_clock::now();
       if (driver_->get_ptp_config(ptp_config) ||
           driver_->get_ptp_status(ptp_status)) {
         BOOST_LOG_TRIVIAL(error)
             << "session_manager:: failed to retrieve PTP clock info";
         // return false;
+        ptp_interval_ms = ptp_slow_interval_ms;
       } else {
         char ptp_clock_id[24];
         uint8_t* pui64GMID = reinterpret_cast<uint8_t*>(&ptp_status.ui64GMID);
@@ -1043,6 +1696,7 @@ bool SessionManager::worker() {
                  pui64GMID[5], pui64GMID[6], pui64GMID[7]);
 
         bool ptp_changed_gmid = false;
+        bool ptp_changed_status = false;
         bool ptp_changed_to_locked = false;
         // update PTP clock status
         ptp_mutex_.lock();
@@ -1068,16 +1722,42 @@ bool SessionManager::worker() {
         if (ptp_status_.status != new_ptp_status) {
           BOOST_LOG_TRIVIAL(info)
               << "session_manager:: new PTP clock status " << new_ptp_status;
+          if (ptp_status_.status == "locked") {
+            // lock lost, restart time to lock measurement
+            ptp_unlock_timepoint = steady_clock::now();
+          }
           ptp_status_.status = new_ptp_status;
+          ptp_changed_status = true;
           if (new_ptp_status == "locked") {
             ptp_changed_to_locked = true;
+            ptp_status_.time_to_lock_ms = static_cast<uint32_t>(
+                duration_cast<milliseconds>(steady_clock::now() -
+                                            ptp_unlock_timepoint)
+                    .count());
+            BOOST_LOG_TRIVIAL(info) << "session_manager:: PTP locked in "
+                                    << ptp_status_.time_to_lock_ms << " ms";
           }
         }
+        PTPStatus cur_ptp_status = ptp_status_;
         // end update PTP clock status
         ptp_mutex_.unlock();
 
+        if (ptp_changed_status || ptp_changed_gmid) {
+          for (auto cb : ptp_status_observers) {
+            cb(cur_ptp_status);
+          }
+        }
+
         if (ptp_changed_to_locked) {
           on_ptp_status_locked();
+          // sample rate applied, audio can flow
+          std::unique_lock ptp_lock(ptp_mutex_);
+          ptp_status_.time_to_audio_ms = static_cast<uint32_t>(
+              duration_cast<milliseconds>(steady_clock::now() -
+                                          ptp_unlock_timepoint)
+                  .count());
+          BOOST_LOG_TRIVIAL(info) << "session_manager:: audio started in "
+                                  << ptp_status_.time_to_audio_ms << " ms";
         }
 
         if (ptp_changed_gmid ||
@@ -1091,8 +1771,25 @@ bool SessionManager::worker() {
 	  }
           on_update_sources();
         }
+
+        // poll fast until locked, then slow down progressively
+        if (new_ptp_status != "locked" || ptp_changed_gmid) {
+          ptp_interval_ms = ptp_fast_interval_ms;
+        } else {
+          ptp_interval_ms =
+              std::min(std::max(ptp_interval_ms, ptp_fast_interval_ms) * 2,
+                       ptp_slow_interval_ms);
+        }
+      }
+    }
+
+    // check if it's time to sample the sinks status
+    if (steady_clock::now() - sinks_status_timepoint >= seconds(1)) {
+      sinks_status_timepoint = steady_clock::now();
+      if (config_->get_sink_delay_tuning() != "off" ||
+          config_->get_sink_status_history_hours()) {
+        process_sinks_status();
       }
-      ptp_interval = 10;
     }
 
     // check if it's time to send sap announcements
@@ -1117,7 +1814,15 @@ bool SessionManager::worker() {
                               << sap_interval << " secs";
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    // wait for next PTP poll, for a PTP poll request or for 1 sec max
+    auto wait = std::clamp(
+        duration_cast<milliseconds>(ptp_timepoint +
+                                    milliseconds(ptp_interval_ms) -
+                                    steady_clock::now()),
+        milliseconds(0), milliseconds(1000));
+    std::unique_lock worker_lock(worker_mutex_);
+    worker_cond_.wait_for(worker_lock, wait,
+                          [this]() { return !running_ || ptp_poll_now_; });
   }
 
   // at end, send deletion for all announced sources
@@ -1129,7 +1834,7 @@ bool SessionManager::worker() {
     std::string sdp = get_removed_source_sdp_(msg_id_hash >> 16, src_addr,
                                               session_id, session_version);
     // send deletion for this source
-    sap_.deletion(static_cast<uint16_t>(msg_id_hash), src_addr, sdp);
+    sap_send_(false, static_cast<uint16_t>(msg_id_hash), src_addr, sdp);
   }
 
   // leave PTP multicast addresses
@@ -20,9 +20,13 @@
 #ifndef _SESSION_MANAGER_HPP_
 #define _SESSION_MANAGER_HPP_
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <future>
 #include <list>
 #include <map>
+#include <set>
 #include <shared_mutex>
 #include <thread>
 
@@ -30,6 +34,9 @@
 #include "driver_manager.hpp"
 #include "igmp.hpp"
 #include "sap.hpp"
+#include "mcast_allocator.hpp"
+#include "sdp_url_watcher.hpp"
+#include "sink_status_history.hpp"
 
 struct StreamSource {
   uint8_t id{0};
@@ -56,6 +63,7 @@ struct StreamSink {
   uint32_t delay{0};
   bool ignore_refclk_gmid{false};
   std::vector<uint8_t> map;
+  bool sdp_from_url{false}; /* sdp was retrieved from the source URL */
 };
 
 struct SinkStreamStatus {
@@ -70,6 +78,26 @@ struct SinkStreamStatus {
   int min_time{0};
 };
 
+struct SinkDelayTuningWindow {
+  uint32_t start_time{0};        /* seconds from daemon startup */
+  uint32_t end_time{0};          /* seconds from daemon startup */
+  uint32_t samples{0};           /* status samples while receiving */
+  int min_time{0};               /* lowest sink min_time measured */
+  uint32_t errors{0};            /* samples with RTP errors */
+  uint32_t muted{0};             /* samples muted while receiving */
+  uint32_t delay{0};             /* sink delay during the window */
+  uint32_t recommended_delay{0}; /* 0 if no recommendation */
+  bool applied{false};
+};
+
+struct SinkDelayTuning {
+  std::string mode;              /* off, recommend or apply */
+  uint32_t delay{0};             /* current sink delay */
+  uint32_t recommended_delay{0}; /* last recommendation, 0 if none */
+  SinkDelayTuningWindow window;  /* window being measured */
+  std::list<SinkDelayTuningWindow> history; /* most recent first */
+};
+
 struct PTPConfig {
   uint8_t domain{0};
   uint8_t dscp{0};
@@ -79,6 +107,23 @@ struct PTPStatus {
   std::string status;
   std::string gmid;
   int32_t jitter{0};
+  uint32_t time_to_lock_ms{0};  /* from startup or loss of lock to locked */
+  uint32_t time_to_audio_ms{0}; /* from startup or loss of lock to audio */
+};
+
+struct StreamJob {
+  uint32_t id{0};
+  std::string operation; /* add_source or add_sink */
+  uint8_t stream_id{0};
+  std::string status; /* pending, running, done or failed */
+  std::error_code error;
+  uint32_t duration_ms{0}; /* execution time */
+};
+
+struct McastCollision {
+  uint8_t id{0}; /* local source id */
+  std::string address;
+  std::list<std::string> remote_ids;
 };
 
 struct StreamInfo {
@@ -91,6 +136,7 @@ struct StreamInfo {
   bool sink_use_sdp{true};
   std::string sink_source;
   std::string sink_sdp;
+  bool sink_sdp_from_url{false};
   uint32_t session_id{0};
   uint32_t session_version{0};
 };
@@ -98,6 +144,14 @@ struct StreamInfo {
 class SessionManager {
  public:
   constexpr static uint8_t stream_id_max = 63;
+  constexpr static size_t job_workers = 4;
+  constexpr static size_t job_history_max = 128;
+  constexpr static int job_wait_max_secs = 30;
+  /* PTP status polling interval while unlocked and max when locked */
+  constexpr static int ptp_fast_interval_ms = 100;
+  constexpr static int ptp_slow_interval_ms = 10000;
+  constexpr static uint32_t sink_delay_max = 4000;
+  constexpr static size_t sink_delay_tuning_history_max = 16;
 
   static std::shared_ptr<SessionManager> create(
       std::shared_ptr<DriverManager> driver,
@@ -111,7 +165,12 @@ class SessionManager {
   bool init() {
     if (!running_) {
       running_ = true;
+      sdp_url_watcher_.init();
       res_ = std::async(std::launch::async, &SessionManager::worker, this);
+      for (size_t i = 0; i < job_workers; i++) {
+        jobs_res_.push_back(std::async(std::launch::async,
+                                       &SessionManager::job_worker, this));
+      }
     }
     return true;
   }
@@ -119,7 +178,21 @@ class SessionManager {
   bool terminate() {
     if (running_) {
       running_ = false;
+      sdp_url_watcher_.terminate();
+      {
+        std::lock_guard worker_lock(worker_mutex_);
+      }
+      worker_cond_.notify_all();
       auto ret = res_.get();
+      {
+        std::lock_guard jobs_lock(jobs_mutex_);
+      }
+      jobs_queue_cond_.notify_all();
+      for (auto& res : jobs_res_) {
+        res.get();
+      }
+      jobs_res_.clear();
+      cancel_jobs_();
       for (auto source : get_sources()) {
         remove_source(source.id);
       }
@@ -137,6 +210,8 @@ class SessionManager {
   std::error_code get_source_sdp(uint32_t id, std::string& sdp) const;
   std::error_code remove_source(uint32_t id);
   uint8_t get_source_id(const std::string& name) const;
+  /* local sources using the same multicast group of a remote session */
+  std::list<McastCollision> get_mcast_collisions() const;
 
   enum class ObserverType { add_source, remove_source, update_source };
   using Observer = std::function<
@@ -150,6 +225,29 @@ class SessionManager {
   std::error_code remove_sink(uint32_t id);
   uint8_t get_sink_id(const std::string& name) const;
 
+  std::error_code get_sink_delay_tuning(uint32_t id,
+                                        SinkDelayTuning& tuning) const;
+  /* sink status changes in [from, to], times in seconds from startup */
+  std::error_code get_sink_status_history(
+      uint32_t id,
+      uint32_t from,
+      uint32_t to,
+      std::list<SinkStatusSample>& samples,
+      uint32_t& now) const;
+
+  enum class SinkObserverType { add_sink, remove_sink };
+  void add_sink_observer(SinkObserverType type, Observer cb);
+
+  /* asynchronous add operations, return the job id */
+  uint32_t add_source_job(const StreamSource& source);
+  uint32_t add_sink_job(const StreamSink& sink);
+  /* wait up to wait_secs for the job to complete */
+  std::error_code get_job(uint32_t id, StreamJob& job, int wait_secs = 0) const;
+  std::list<StreamJob> get_jobs() const;
+
+  using PtpStatusObserver = std::function<void(const PTPStatus& status)>;
+  void add_ptp_status_observer(PtpStatusObserver cb);
+
   std::error_code set_ptp_config(const PTPConfig& config);
   void get_ptp_config(PTPConfig& config) const;
   void get_ptp_status(PTPStatus& status) const;
@@ -159,6 +257,12 @@ class SessionManager {
 
   size_t process_sap();
 
+  /* remote sessions discovered by the browser, used to avoid collisions */
+  void add_remote_session(const std::string& id,
+                          const std::string& address,
+                          const std::string& sdp);
+  void remove_remote_session(const std::string& id);
+
  protected:
   constexpr static const char ptp_primary_mcast_addr[] = "224.0.1.129";
   constexpr static const char ptp_pdelay_mcast_addr[] = "224.0.1.107";
@@ -168,11 +272,21 @@ class SessionManager {
 
   void on_add_sink(const StreamSink& sink, const StreamInfo& info);
   void on_remove_sink(const StreamInfo& info);
+  /* sink observers are called after releasing sinks_mutex_ */
+  void notify_add_sink_(uint8_t id,
+                        const std::string& name,
+                        const std::string& sdp) const;
+  void notify_remove_sink_(uint8_t id, const std::string& name) const;
 
   void on_ptp_status_locked() const;
 
   void on_update_sources();
 
+  /* the SDP URL of a sink changed, the sink is updated with a job */
+  void on_sink_sdp_changed(uint8_t id,
+                           const std::string& url,
+                           const std::string& sdp);
+
   std::string get_removed_source_sdp_(uint32_t id,
                                       uint32_t src_addr,
                                       uint32_t session_id,
@@ -180,13 +294,43 @@ class SessionManager {
   std::string get_source_sdp_(uint32_t id, const StreamInfo& info) const;
   StreamSource get_source_(uint8_t id, const StreamInfo& info) const;
   StreamSink get_sink_(uint8_t id, const StreamInfo& info) const;
+  /* multicast group for a source without an explicit address,
+   * called with sources_mutex_ held */
+  uint32_t allocate_mcast_addr_(uint8_t id) const;
+  /* send a SAP announcement or deletion on all the discovery interfaces */
+  void sap_send_(bool is_announce,
+                 uint16_t msg_id_hash,
+                 uint32_t addr,
+                 const std::string& sdp);
 
   bool parse_sdp(const std::string sdp, StreamInfo& info) const;
   bool worker();
+  /* wake up the worker and poll the PTP status immediately */
+  void trigger_ptp_poll();
+  void process_sinks_status();
+  /* clear-on-read status of the sink from the driver */
+  std::error_code read_sink_status_(uint32_t id,
+                                    SinkStreamStatus& status) const;
+  bool on_sink_delay_tuning_window(uint8_t id,
+                                   uint32_t frame_size,
+                                   uint32_t now,
+                                   SinkDelayTuning& tuning) const;
+
+  uint32_t submit_job_(const std::string& operation,
+                       uint8_t stream_id,
+                       std::function<std::error_code()> fn);
+  bool job_worker();
+  /* fail the jobs still queued when the workers are stopped */
+  void cancel_jobs_();
   // singleton, use create() to build
   SessionManager(std::shared_ptr<DriverManager> driver,
                  std::shared_ptr<Config> config)
-      : driver_(driver), config_(config) {
+      : driver_(driver),
+        config_(config),
+        mcast_allocator_(boost::asio::ip::address_v4::from_string(
+                             config->get_rtp_mcast_base())
+                             .to_ulong(),
+                         config->get_rtp_mcast_pool_size()) {
     ptp_config_.domain = config->get_ptp_domain();
     ptp_config_.dscp = config->get_ptp_dscp();
   };
@@ -195,6 +339,11 @@ class SessionManager {
   std::shared_ptr<Config> config_;
   std::future<bool> res_;
   std::atomic_bool running_{false};
+  std::atomic_bool ptp_poll_now_{false};
+  std::mutex worker_mutex_;
+  std::condition_variable worker_cond_;
+  std::chrono::time_point<std::chrono::steady_clock> startup_{
+      std::chrono::steady_clock::now()};
 
   /* current sources */
   std::map<uint8_t /* id */, StreamInfo> sources_;
@@ -206,6 +355,23 @@ class SessionManager {
   std::map<std::string, uint8_t /* id */> sink_names_;
   mutable std::shared_mutex sinks_mutex_;
 
+  /* multicast groups of the remote sessions */
+  McastAllocator mcast_allocator_;
+  mutable std::mutex mcast_allocator_mutex_;
+
+  /* sinks playout delay tuning */
+  std::map<uint8_t /* id */, SinkDelayTuning> sinks_delay_tuning_;
+  mutable std::mutex sinks_delay_tuning_mutex_;
+
+  /* sinks status history */
+  std::map<uint8_t /* id */, SinkStatusHistory> sinks_status_history_;
+  mutable std::mutex sinks_status_history_mutex_;
+
+  /* status read by the sampler since the last get_sink_status(),
+   * flags are accumulated and min_time is the minimum */
+  mutable std::map<uint8_t /* id */, SinkStreamStatus> sinks_status_pending_;
+  mutable std::mutex sinks_status_pending_mutex_;
+
   /* current announced sources */
   std::map<uint32_t /* msg_id_hash */,
            std::tuple<uint32_t /* src_addr */,
@@ -217,6 +383,22 @@ class SessionManager {
   std::unordered_map<uint32_t /* msg_id_hash */, int /* count */>
       deleted_sources_count_;
 
+  /* asynchronous jobs */
+  struct PendingJob {
+    uint32_t id;
+    std::pair<bool /* is source */, uint8_t /* id */> stream;
+    std::function<std::error_code()> fn;
+  };
+  std::list<std::future<bool> > jobs_res_;
+  std::deque<PendingJob> jobs_queue_;
+  /* streams with a running job, jobs on the same stream are serialized */
+  std::set<std::pair<bool, uint8_t> > jobs_busy_streams_;
+  std::map<uint32_t /* id */, StreamJob> jobs_;
+  uint32_t last_job_id_{0};
+  mutable std::mutex jobs_mutex_;
+  std::condition_variable jobs_queue_cond_;
+  mutable std::condition_variable jobs_done_cond_;
+
   PTPConfig ptp_config_;
   PTPStatus ptp_status_;
   mutable std::shared_mutex ptp_mutex_;
@@ -224,10 +406,19 @@ class SessionManager {
   std::list<Observer> add_source_observers;
   std::list<Observer> remove_source_observers;
   std::list<Observer> update_source_observers;
+  std::list<Observer> add_sink_observers;
+  std::list<Observer> remove_sink_observers;
+  std::list<PtpStatusObserver> ptp_status_observers;
 
   SAP sap_{config_->get_sap_mcast_addr()};
   IGMP igmp_;
 
+  SdpUrlWatcher sdp_url_watcher_{
+      config_->get_sdp_url_watch_interval(),
+      [this](uint8_t id, const std::string& url, const std::string& sdp) {
+        on_sink_sdp_changed(id, url, sdp);
+      }};
+
   /* used to handle session versioning */
   inline static std::atomic<uint16_t> g_session_version{0};
 };
@@ -0,0 +1,130 @@
+//
+//  sink_status_history.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "sink_status_history.hpp"
+
+static inline void put_varint(std::vector<uint8_t>& data, uint32_t value) {
+  while (value >= 0x80) {
+    data.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  data.push_back(static_cast<uint8_t>(value));
+}
+
+static inline uint32_t get_varint(const std::vector<uint8_t>& data,
+                                  size_t& pos) {
+  uint32_t value = 0;
+  int shift = 0;
+  while (pos < data.size()) {
+    uint8_t byte = data[pos++];
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+    shift += 7;
+  }
+  return value;
+}
+
+static inline uint32_t zigzag_encode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+void SinkStatusHistory::add(uint32_t time, uint8_t flags, int32_t min_time) {
+  if (!blocks_.empty()) {
+    const auto& last = blocks_.back().last;
+    if (blocks_.back().count && last.flags == flags &&
+        last.min_time == min_time) {
+      // no change
+      return;
+    }
+  }
+
+  if (blocks_.empty() || time - blocks_.back().start_time >= block_secs) {
+    Block block;
+    block.start_time = time;
+    block.last.time = time;
+    blocks_.push_back(std::move(block));
+  }
+
+  auto& block = blocks_.back();
+  put_varint(block.data, time - block.last.time);
+  block.data.push_back(flags);
+  put_varint(block.data, zigzag_encode(min_time - block.last.min_time));
+  block.last = {time, flags, min_time};
+  block.count++;
+
+  // drop blocks entirely out of the retention period
+  while (blocks_.size() > 1 && time > retention_secs_ &&
+         blocks_[1].start_time <= time - retention_secs_) {
+    blocks_.pop_front();
+  }
+}
+
+std::list<SinkStatusSample> SinkStatusHistory::get(uint32_t from,
+                                                   uint32_t to) const {
+  std::list<SinkStatusSample> samples;
+  bool has_previous = false;
+  SinkStatusSample previous;
+  for (const auto& block : blocks_) {
+    if (block.start_time > to) {
+      break;
+    }
+    if (block.last.time < from) {
+      // only the last status of this block can be relevant
+      previous = block.last;
+      has_previous = block.count > 0;
+      continue;
+    }
+    SinkStatusSample sample{block.start_time, 0, 0};
+    size_t pos = 0;
+    for (size_t i = 0; i < block.count; i++) {
+      sample.time += get_varint(block.data, pos);
+      sample.flags = block.data[pos++];
+      sample.min_time += zigzag_decode(get_varint(block.data, pos));
+      if (sample.time < from) {
+        previous = sample;
+        has_previous = true;
+      } else if (sample.time <= to) {
+        samples.push_back(sample);
+      } else {
+        break;
+      }
+    }
+  }
+  if (has_previous && (samples.empty() || samples.front().time != from)) {
+    previous.time = from;
+    samples.push_front(previous);
+  }
+  return samples;
+}
+
+size_t SinkStatusHistory::get_size() const {
+  size_t size = 0;
+  for (const auto& block : blocks_) {
+    size += block.data.size();
+  }
+  return size;
+}
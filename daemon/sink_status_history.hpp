@@ -0,0 +1,66 @@
+//
+//  sink_status_history.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef _SINK_STATUS_HISTORY_HPP_
+#define _SINK_STATUS_HISTORY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <vector>
+
+struct SinkStatusSample {
+  uint32_t time{0};  /* seconds from daemon startup */
+  uint8_t flags{0};  /* sink flags, same bit layout as the driver */
+  int32_t min_time{0};
+};
+
+/*
+ * Sink status time series, only changes of flags or min_time are recorded.
+ * Samples are delta encoded in one hour blocks: a varint time delta, the
+ * flags byte and a zigzag varint min_time delta. Blocks older than the
+ * retention period are dropped.
+ */
+class SinkStatusHistory {
+ public:
+  constexpr static uint32_t block_secs = 3600;
+
+  SinkStatusHistory(uint32_t retention_secs = 86400)
+      : retention_secs_(retention_secs){};
+
+  void add(uint32_t time, uint8_t flags, int32_t min_time);
+  /* samples recorded in [from, to] preceded by the status at from */
+  std::list<SinkStatusSample> get(uint32_t from, uint32_t to) const;
+  size_t get_size() const;
+
+ private:
+  struct Block {
+    uint32_t start_time{0};
+    SinkStatusSample last;
+    size_t count{0};
+    std::vector<uint8_t> data;
+  };
+
+  uint32_t retention_secs_;
+  std::deque<Block> blocks_;
+};
+
+#endif
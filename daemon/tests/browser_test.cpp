@@ -0,0 +1,242 @@
+//
+//  browser_test.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "browser.hpp"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE BrowserTest
+#include <boost/test/unit_test.hpp>
+
+/* expose the browser catalog internals, the worker is never started */
+class TestBrowser : public Browser {
+ public:
+  explicit TestBrowser(std::shared_ptr<Config> config) : Browser(config) {
+    init_filters_();
+  }
+
+  using Browser::add_origin_;
+  using Browser::notifications_t;
+
+  /* add the SAP origin of remote source n */
+  notifications_t add_sap(uint16_t n,
+                          uint32_t last_seen,
+                          const std::string& interface = "eth0",
+                          const std::string& address = "") {
+    RemoteOrigin origin{"SAP",
+                        "sap:" + std::to_string(n + 1),
+                        address.empty() ? get_address(n) : address,
+                        {},
+                        {},
+                        last_seen,
+                        30,
+                        interface};
+    notifications_t notifications;
+    add_origin_(origin, get_sdp(n), notifications);
+    return notifications;
+  }
+
+  /* add the mDNS origin of remote source n */
+  notifications_t add_mdns(uint16_t n,
+                           uint32_t last_seen,
+                           const std::string& domain) {
+    RemoteOrigin origin{"mDNS",
+                        "rtsp:" + std::to_string(n + 1),
+                        get_address(n),
+                        "Remote mDNS " + std::to_string(n),
+                        domain,
+                        last_seen,
+                        0,
+                        "eth0"};
+    notifications_t notifications;
+    add_origin_(origin, get_sdp(n), notifications);
+    return notifications;
+  }
+
+  /* add a SAP origin announcing sdp */
+  notifications_t add_sap_sdp(uint16_t n, const std::string& sdp) {
+    RemoteOrigin origin{"SAP",
+                        "sap:" + std::to_string(n + 1),
+                        get_address(n),
+                        {},
+                        {},
+                        10,
+                        30,
+                        "eth0"};
+    notifications_t notifications;
+    add_origin_(origin, sdp, notifications);
+    return notifications;
+  }
+
+  /* names of the current sources */
+  std::set<std::string> get_names() const {
+    std::set<std::string> names;
+    for (const auto& source : get_remote_sources()) {
+      names.insert(source.name);
+    }
+    return names;
+  }
+
+  static std::string get_address(uint16_t n) {
+    return "10.255.0." + std::to_string(n + 1);
+  }
+
+  static std::string get_sdp(uint16_t n, const std::string& codec = "L24") {
+    std::stringstream ss;
+    ss << "v=0\no=- " << n << " 0 IN IP4 " << get_address(n) << "\n"
+       << "s=Remote SAP " << n << "\nc=IN IP4 239.3.0." << n + 1 << "/15\n"
+       << "t=0 0\na=clock-domain:PTPv2 0\nm=audio 5004 RTP/AVP 98\n"
+       << "a=rtpmap:98 " << codec << "/48000/2\na=sync-time:0\n"
+       << "a=framecount:48\na=ptime:1\na=mediaclk:direct=0\n"
+       << "a=recvonly\n";
+    return ss.str();
+  }
+};
+
+static std::shared_ptr<Config> get_config() {
+  auto config = std::make_shared<Config>();
+  config->set_mdns_enabled(false);
+  config->set_sap_interval(30);
+  return config;
+}
+
+BOOST_AUTO_TEST_CASE(sap_copies_on_other_interfaces) {
+  TestBrowser browser(get_config());
+  auto notifications = browser.add_sap(0, 10, "eth0");
+  BOOST_REQUIRE_MESSAGE(notifications.size() == 1, "source added");
+  /* the same announcement received via a second interface */
+  notifications = browser.add_sap(0, 11, "eth1");
+  BOOST_REQUIRE_MESSAGE(notifications.empty(), "copy doesn't notify");
+  auto sources = browser.get_remote_sources();
+  BOOST_REQUIRE_MESSAGE(sources.size() == 1, "single source");
+  const auto& source = sources.front();
+  BOOST_CHECK_MESSAGE(source.interface == "eth0", "interface is stable");
+  BOOST_CHECK_MESSAGE(source.last_seen == 10, "copy doesn't refresh");
+  BOOST_CHECK_MESSAGE(source.announce_period == 30, "period is kept");
+  /* the next announcement on the first interface */
+  browser.add_sap(0, 40, "eth1");
+  browser.add_sap(0, 40, "eth0");
+  sources = browser.get_remote_sources();
+  BOOST_REQUIRE_MESSAGE(sources.size() == 1, "single source");
+  BOOST_CHECK_MESSAGE(sources.front().last_seen == 40, "source refreshed");
+  BOOST_CHECK_MESSAGE(sources.front().announce_period == 30,
+                      "period measured on the first interface");
+}
+
+BOOST_AUTO_TEST_CASE(catalog_max_sources) {
+  auto config = get_config();
+  config->set_browser_max_sources(3);
+  TestBrowser browser(config);
+  browser.add_sap(0, 10);
+  browser.add_sap(1, 11);
+  browser.add_sap(2, 12);
+  /* source 1 becomes the least recently seen */
+  browser.add_sap(0, 20);
+  auto notifications = browser.add_sap(3, 21);
+  BOOST_REQUIRE_MESSAGE(notifications.size() == 2, "evicted and added");
+  BOOST_CHECK_MESSAGE(
+      notifications.front().first == Browser::ObserverType::remove_source &&
+          notifications.front().second.name == "Remote SAP 1",
+      "least recently seen source evicted");
+  auto stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.evicted == 1, "one source evicted");
+  BOOST_CHECK_MESSAGE(stats.sources == 3, "catalog is full");
+  BOOST_CHECK_MESSAGE(
+      browser.get_names() == std::set<std::string>({"Remote SAP 0",
+                                                    "Remote SAP 2",
+                                                    "Remote SAP 3"}),
+      "remaining sources");
+}
+
+BOOST_AUTO_TEST_CASE(catalog_max_sdp_bytes) {
+  auto sdp_length = TestBrowser::get_sdp(0).length();
+  auto config = get_config();
+  config->set_browser_max_sdp_bytes(sdp_length * 2 + sdp_length / 2);
+  TestBrowser browser(config);
+  browser.add_sap(0, 10);
+  browser.add_sap(1, 11);
+  browser.add_sap(2, 12);
+  auto stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.evicted == 1, "one source evicted");
+  BOOST_CHECK_MESSAGE(stats.sdp_bytes == sdp_length * 2, "catalog bytes");
+  BOOST_CHECK_MESSAGE(
+      browser.get_names() ==
+          std::set<std::string>({"Remote SAP 1", "Remote SAP 2"}),
+      "remaining sources");
+  /* an SDP larger than the catalog is never admitted */
+  config->set_browser_max_sdp_bytes(sdp_length - 1);
+  auto notifications = browser.add_sap(3, 13);
+  BOOST_CHECK_MESSAGE(notifications.empty(), "source rejected");
+  stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.rejected_size == 1, "one source too large");
+  BOOST_CHECK_MESSAGE(stats.evicted == 1, "no more sources evicted");
+  BOOST_CHECK_MESSAGE(stats.sources == 2, "sources unchanged");
+}
+
+BOOST_AUTO_TEST_CASE(catalog_allowed_subnets) {
+  auto config = get_config();
+  config->set_browser_allowed_subnets("10.255.0.0/24 192.168.1.0/24");
+  TestBrowser browser(config);
+  browser.add_sap(0, 10);
+  browser.add_sap(1, 10, "eth0", "10.254.0.2");
+  browser.add_sap(2, 10, "eth0", "192.168.1.7");
+  auto stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.rejected_filtered == 1, "one source filtered");
+  BOOST_CHECK_MESSAGE(
+      browser.get_names() ==
+          std::set<std::string>({"Remote SAP 0", "Remote SAP 2"}),
+      "remaining sources");
+}
+
+BOOST_AUTO_TEST_CASE(catalog_allowed_domains) {
+  auto config = get_config();
+  config->set_browser_allowed_domains("studio.example");
+  TestBrowser browser(config);
+  browser.add_mdns(0, 10, "studio.example.");
+  browser.add_mdns(1, 10, "local.");
+  /* the domain filter applies to mDNS sources only */
+  browser.add_sap(2, 10);
+  auto stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.rejected_filtered == 1, "one source filtered");
+  BOOST_CHECK_MESSAGE(
+      browser.get_names() ==
+          std::set<std::string>({"Remote mDNS 0", "Remote SAP 2"}),
+      "remaining sources");
+}
+
+BOOST_AUTO_TEST_CASE(catalog_aes67_admission) {
+  TestBrowser browser(get_config());
+  browser.add_sap(0, 10);
+  /* not an AES67 codec */
+  browser.add_sap_sdp(1, TestBrowser::get_sdp(1, "opus"));
+  /* no origin */
+  auto sdp = TestBrowser::get_sdp(2);
+  sdp.erase(sdp.find("o="), sdp.find("\ns=") - sdp.find("o=") + 1);
+  browser.add_sap_sdp(2, sdp);
+  auto stats = browser.get_stats();
+  BOOST_CHECK_MESSAGE(stats.rejected_invalid == 2, "two sources invalid");
+  BOOST_CHECK_MESSAGE(stats.rejected_filtered == 0, "no sources filtered");
+  BOOST_CHECK_MESSAGE(
+      browser.get_names() == std::set<std::string>({"Remote SAP 0"}),
+      "remaining sources");
+}
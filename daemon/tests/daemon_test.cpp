@@ -190,6 +190,34 @@ struct Client {
     return {res->status == 200, res->body};
   }
 
+  /* conditional GET of the source SDP, returns the status and the ETag */
+  std::pair<int, std::string> get_source_sdp_etag(int id,
+                                                  const std::string& etag) {
+    std::string url = std::string("/api/source/sdp/") + std::to_string(id);
+    httplib::Headers headers;
+    if (!etag.empty()) {
+      headers.emplace("If-None-Match", etag);
+    }
+    auto res = cli_.Get(url.c_str(), headers);
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status, res->get_header_value("ETag")};
+  }
+
+  /* SDP of sink id or an empty string */
+  std::string get_sink_sdp(int id) {
+    auto json = get_sinks();
+    BOOST_REQUIRE_MESSAGE(json.first, "got sinks");
+    boost::property_tree::ptree pt;
+    std::stringstream ss(json.second);
+    boost::property_tree::read_json(ss, pt);
+    BOOST_FOREACH (auto const& v, pt.get_child("sinks")) {
+      if (v.second.get<int>("id") == id) {
+        return v.second.get<std::string>("sdp");
+      }
+    }
+    return {};
+  }
+
   std::pair<bool, std::string> get_sink_status(int id) {
     std::string url = std::string("/api/sink/status/") + std::to_string(id);
     auto res = cli_.Get(url.c_str());
@@ -197,6 +225,21 @@ struct Client {
     return {res->status == 200, res->body};
   }
 
+  std::pair<bool, std::string> get_sink_delay_tuning(int id) {
+    std::string url = std::string("/api/sink/delay/") + std::to_string(id);
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status == 200, res->body};
+  }
+
+  std::pair<bool, std::string> get_sink_status_history(int id) {
+    std::string url = std::string("/api/sink/status/") + std::to_string(id) +
+                      std::string("/history");
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status == 200, res->body};
+  }
+
   std::pair<bool, std::string> get_streams() {
     std::string url = std::string("/api/streams");
     auto res = cli_.Get(url.c_str());
@@ -211,6 +254,13 @@ struct Client {
     return {res->status == 200, res->body};
   }
 
+  std::pair<bool, std::string> get_mcast_collisions() {
+    std::string url = std::string("/api/sources/collisions");
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status == 200, res->body};
+  }
+
   std::pair<bool, std::string> get_sinks() {
     std::string url = std::string("/api/sinks");
     auto res = cli_.Get(url.c_str());
@@ -225,7 +275,7 @@ struct Client {
     return (res->status == 200);
   }
 
-  bool add_sink_sdp(int id) {
+  bool add_sink_sdp(int id, const std::string& source = "") {
     std::string json = R"(
 {
   "name": "ALSA",
@@ -240,6 +290,8 @@ struct Client {
   )";
 
     boost::replace_first(json, "ALSA", "ALSA " + std::to_string(id));
+    boost::replace_first(json, "\"source\": \"\"",
+                         "\"source\": \"" + source + "\"");
     std::string url = std::string("/api/sink/") + std::to_string(id);
     auto res = cli_.Put(url.c_str(), json, "application/json");
     BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
@@ -269,6 +321,50 @@ struct Client {
     return (res->status == 200);
   }
 
+  std::pair<bool, uint32_t> add_sink_url_async(int id) {
+    std::string json1 = R"(
+{
+  "io": "Audio Device",
+  "use_sdp": false,
+  "sdp": "",
+  "delay": 1024,
+  "ignore_refclk_gmid": true,
+  "map": [ 0, 1 ],
+  )";
+
+    std::string json =
+        json1 +
+        std::string("\"name\": \"ALSA " + std::to_string(id) + "\",\n") +
+        std::string("\"source\": \"http://") + g_daemon_address + ":" +
+        std::to_string(g_daemon_port) + std::string("/api/source/sdp/") +
+        std::to_string(id) + "\"\n}";
+    std::string url =
+        std::string("/api/sink/") + std::to_string(id) + "?async=true";
+    auto res = cli_.Put(url.c_str(), json, "application/json");
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    if (res->status != 202) {
+      return {false, 0};
+    }
+    boost::property_tree::ptree pt;
+    std::stringstream ss(res->body);
+    boost::property_tree::read_json(ss, pt);
+    return {true, pt.get<uint32_t>("job_id")};
+  }
+
+  std::pair<bool, std::string> wait_job(uint32_t id) {
+    std::string url =
+        std::string("/api/job/") + std::to_string(id) + "?wait=10";
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    if (res->status != 200) {
+      return {false, res->body};
+    }
+    boost::property_tree::ptree pt;
+    std::stringstream ss(res->body);
+    boost::property_tree::read_json(ss, pt);
+    return {true, pt.get<std::string>("status")};
+  }
+
   bool remove_sink(int id) {
     std::string url = std::string("/api/sink/") + std::to_string(id);
     auto res = cli_.Delete(url.c_str());
@@ -337,6 +433,20 @@ struct Client {
     return {res->status == 200, res->body};
   }
 
+  std::pair<bool, std::string> get_remote_sources() {
+    std::string url = std::string("/api/browse/sources/all");
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status == 200, res->body};
+  }
+
+  std::pair<bool, std::string> get_browser_stats() {
+    std::string url = std::string("/api/browse/stats");
+    auto res = cli_.Get(url.c_str());
+    BOOST_REQUIRE_MESSAGE(res != nullptr, "server returned response");
+    return {res->status == 200, res->body};
+  }
+
   std::pair<bool, std::string> get_remote_mdns_sources() {
     std::string url = std::string("/api/browse/sources/mdns");
     auto res = cli_.Get(url.c_str());
@@ -385,6 +495,7 @@ BOOST_AUTO_TEST_CASE(get_config) {
   auto max_tic_frame_size = pt.get<int>("max_tic_frame_size");
   auto sample_rate = pt.get<int>("sample_rate");
   auto rtp_mcast_base = pt.get<std::string>("rtp_mcast_base");
+  auto rtp_mcast_pool_size = pt.get<int>("rtp_mcast_pool_size");
   auto rtp_port = pt.get<int>("rtp_port");
   auto ptp_domain = pt.get<int>("ptp_domain");
   auto ptp_dscp = pt.get<int>("ptp_dscp");
@@ -393,6 +504,7 @@ BOOST_AUTO_TEST_CASE(get_config) {
   auto syslog_server = pt.get<std::string>("syslog_server");
   auto status_file = pt.get<std::string>("status_file");
   auto interface_name = pt.get<std::string>("interface_name");
+  auto sdp_url_watch_interval = pt.get<int>("sdp_url_watch_interval");
   auto mac_addr = pt.get<std::string>("mac_addr");
   auto ip_addr = pt.get<std::string>("ip_addr");
   BOOST_CHECK_MESSAGE(http_port == 9999, "config as excepcted");
@@ -402,6 +514,7 @@ BOOST_AUTO_TEST_CASE(get_config) {
   BOOST_CHECK_MESSAGE(max_tic_frame_size == 1024, "config as excepcted");
   BOOST_CHECK_MESSAGE(sample_rate == 44100, "config as excepcted");
   BOOST_CHECK_MESSAGE(rtp_mcast_base == "239.1.0.1", "config as excepcted");
+  BOOST_CHECK_MESSAGE(rtp_mcast_pool_size == 256, "config as excepcted");
   BOOST_CHECK_MESSAGE(rtp_port == 6004, "config as excepcted");
   BOOST_CHECK_MESSAGE(ptp_domain == 0, "config as excepcted");
   BOOST_CHECK_MESSAGE(ptp_dscp == 46, "config as excepcted");
@@ -411,6 +524,7 @@ BOOST_AUTO_TEST_CASE(get_config) {
                       "config as excepcted");
   BOOST_CHECK_MESSAGE(status_file == "", "config as excepcted");
   BOOST_CHECK_MESSAGE(interface_name == "lo", "config as excepcted");
+  BOOST_CHECK_MESSAGE(sdp_url_watch_interval == 5, "config as excepcted");
   BOOST_CHECK_MESSAGE(mac_addr == "00:00:00:00:00:00", "config as excepcted");
   BOOST_CHECK_MESSAGE(ip_addr == "127.0.0.1", "config as excepcted");
 }
@@ -426,6 +540,10 @@ BOOST_AUTO_TEST_CASE(get_ptp_status) {
   auto jitter = pt.get<int>("jitter");
   BOOST_REQUIRE_MESSAGE(status == "unlocked" && jitter == 0,
                         "ptp status as excepcted");
+  auto time_to_lock = pt.get<int>("time_to_lock_ms");
+  auto time_to_audio = pt.get<int>("time_to_audio_ms");
+  BOOST_REQUIRE_MESSAGE(time_to_lock == 0 && time_to_audio == 0,
+                        "ptp lock times as excepcted");
 }
 
 BOOST_AUTO_TEST_CASE(get_ptp_config) {
@@ -504,6 +622,97 @@ BOOST_AUTO_TEST_CASE(add_update_remove_sink) {
   BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
 }
 
+BOOST_AUTO_TEST_CASE(add_remove_sink_async) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  auto job = cli.add_sink_url_async(0);
+  BOOST_REQUIRE_MESSAGE(job.first, "add sink 0 job accepted");
+  auto status = cli.wait_job(job.second);
+  BOOST_REQUIRE_MESSAGE(status.first, "got job status");
+  BOOST_REQUIRE_MESSAGE(status.second == "done", "added sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+}
+
+BOOST_AUTO_TEST_CASE(source_check_sdp_etag) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  auto res = cli.get_source_sdp_etag(0, "");
+  BOOST_REQUIRE_MESSAGE(res.first == 200, "got source sdp 0");
+  BOOST_REQUIRE_MESSAGE(!res.second.empty(), "source sdp 0 has an ETag");
+  BOOST_REQUIRE_MESSAGE(cli.get_source_sdp_etag(0, res.second).first == 304,
+                        "source sdp 0 not modified");
+  BOOST_REQUIRE_MESSAGE(cli.update_source(0), "updated source 0");
+  BOOST_REQUIRE_MESSAGE(cli.get_source_sdp_etag(0, res.second).first == 200,
+                        "source sdp 0 modified");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+}
+
+BOOST_AUTO_TEST_CASE(sink_check_sdp_url_watch) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_url(0), "added sink 0");
+  auto sdp = cli.get_source_sdp(0);
+  BOOST_REQUIRE_MESSAGE(sdp.first, "got source sdp 0");
+  BOOST_REQUIRE_MESSAGE(cli.get_sink_sdp(0) == sdp.second,
+                        "sink 0 uses source sdp 0");
+  BOOST_REQUIRE_MESSAGE(cli.update_source(0), "updated source 0");
+  sdp = cli.get_source_sdp(0);
+  BOOST_REQUIRE_MESSAGE(sdp.first, "got source sdp 0");
+  // the watch interval is 5 secs in the test config
+  int retry = 15;
+  while (retry-- && cli.get_sink_sdp(0) != sdp.second) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+  BOOST_REQUIRE_MESSAGE(retry >= 0, "sink 0 updated with the new sdp");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+}
+
+BOOST_AUTO_TEST_CASE(sink_check_sdp_explicit_not_watched) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  std::string url = std::string("http://") + g_daemon_address + ":" +
+                    std::to_string(g_daemon_port) + "/api/source/sdp/0";
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_sdp(0, url), "added sink 0");
+  auto sink_sdp = cli.get_sink_sdp(0);
+  BOOST_REQUIRE_MESSAGE(!sink_sdp.empty(), "got sink sdp 0");
+  BOOST_REQUIRE_MESSAGE(cli.update_source(0), "updated source 0");
+  // the watch interval is 5 secs in the test config
+  std::this_thread::sleep_for(std::chrono::seconds(12));
+  BOOST_REQUIRE_MESSAGE(cli.get_sink_sdp(0) == sink_sdp,
+                        "explicit sdp of sink 0 not overwritten");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+}
+
+BOOST_AUTO_TEST_CASE(source_sink_check_loopback) {
+  Client cli;
+  auto json = cli.get_config();
+  BOOST_REQUIRE_MESSAGE(json.first, "got config");
+  boost::property_tree::ptree pt;
+  std::stringstream ss(json.second);
+  boost::property_tree::read_json(ss, pt);
+  auto backend = pt.get<std::string>("driver_backend");
+  if (backend != "userspace") {
+    BOOST_TEST_MESSAGE("source_sink_check_loopback skipped, driver backend is "
+                       << backend << " and not userspace");
+    return;
+  }
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_url(0), "added sink 0");
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  json = cli.get_sink_status(0);
+  BOOST_REQUIRE_MESSAGE(json.first, "got sink status 0");
+  std::stringstream ss1(json.second);
+  boost::property_tree::read_json(ss1, pt);
+  // the userspace driver sends and receives on the loopback interface
+  BOOST_REQUIRE_MESSAGE(pt.get<bool>("sink_flags.receiving_rtp_packet"),
+                        "sink 0 receives from source 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+}
+
 BOOST_AUTO_TEST_CASE(source_check_sap) {
   Client cli;
   BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
@@ -529,7 +738,24 @@ BOOST_AUTO_TEST_CASE(source_check_sap_browser) {
     BOOST_REQUIRE_MESSAGE(
         v.second.get<std::string>("sdp") == sdp.second,
         "returned sap source " + v.second.get<std::string>("id"));
+    bool sap_origin = false;
+    BOOST_FOREACH (auto const& o, v.second.get_child("origins")) {
+      if (o.second.get<std::string>("source") == "SAP") {
+        sap_origin = true;
+        BOOST_CHECK_MESSAGE(o.second.get<std::string>("interface") == "lo",
+                            "SAP origin tagged with its interface");
+      }
+    }
+    BOOST_REQUIRE_MESSAGE(sap_origin, "sap source has a SAP origin");
   }
+  json = cli.get_browser_stats();
+  BOOST_REQUIRE_MESSAGE(json.first, "got browser stats");
+  std::stringstream ss2(json.second);
+  boost::property_tree::ptree stats;
+  boost::property_tree::read_json(ss2, stats);
+  BOOST_REQUIRE_MESSAGE(stats.get<int>("sources") > 0, "browser has sources");
+  BOOST_REQUIRE_MESSAGE(stats.get<int>("rejected_invalid") == 0,
+                        "no invalid sources");
   BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
   cli.sap_wait_deletion(0, sdp.second, 3);
   json = cli.get_remote_sap_sources();
@@ -540,6 +766,51 @@ BOOST_AUTO_TEST_CASE(source_check_sap_browser) {
                         "no remote sap sources");
 }
 
+BOOST_AUTO_TEST_CASE(source_check_mcast_collisions) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_source(0), "added source 0");
+  auto sdp = cli.get_source_sdp(0);
+  BOOST_REQUIRE_MESSAGE(sdp.first, "got source sdp 0");
+  cli.sap_wait_announcement(0, sdp.second);
+  auto json = cli.get_sources();
+  BOOST_REQUIRE_MESSAGE(json.first, "got sources");
+  boost::property_tree::ptree pt;
+  std::stringstream ss(json.second);
+  boost::property_tree::read_json(ss, pt);
+  BOOST_FOREACH (auto const& v, pt.get_child("sources")) {
+    BOOST_REQUIRE_MESSAGE(v.second.get<std::string>("address") == "239.1.0.1",
+                          "source 0 uses the default multicast address");
+  }
+  /* our own SAP announcements are not a collision */
+  json = cli.get_mcast_collisions();
+  BOOST_REQUIRE_MESSAGE(json.first, "got multicast collisions");
+  std::stringstream ss1(json.second);
+  boost::property_tree::read_json(ss1, pt);
+  BOOST_REQUIRE_MESSAGE(pt.get_child("collisions").size() == 0,
+                        "no multicast collisions");
+  /* a local sink receiving the source doesn't move it on update */
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_url(0), "added sink 0");
+  BOOST_REQUIRE_MESSAGE(cli.update_source(0), "updated source 0");
+  json = cli.get_sources();
+  BOOST_REQUIRE_MESSAGE(json.first, "got sources");
+  std::stringstream ss2(json.second);
+  boost::property_tree::read_json(ss2, pt);
+  auto base = boost::asio::ip::address_v4::from_string("239.1.0.1").to_ulong();
+  BOOST_FOREACH (auto const& v, pt.get_child("sources")) {
+    auto address = v.second.get<std::string>("address");
+    auto addr = boost::asio::ip::address_v4::from_string(address).to_ulong();
+    BOOST_REQUIRE_MESSAGE(addr >= base && addr - base < 256,
+                          "source 0 address is in the multicast pool");
+    BOOST_REQUIRE_MESSAGE(address == "239.1.0.1",
+                          "source 0 address is stable across updates");
+  }
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  sdp = cli.get_source_sdp(0);
+  BOOST_REQUIRE_MESSAGE(sdp.first, "got source sdp 0");
+  BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
+  cli.sap_wait_deletion(0, sdp.second, 3);
+}
+
 #ifdef _USE_AVAHI_
 BOOST_AUTO_TEST_CASE(source_check_mdns_browser) {
   Client cli;
@@ -558,6 +829,13 @@ BOOST_AUTO_TEST_CASE(source_check_mdns_browser) {
         v.second.get<std::string>("sdp") == sdp.second,
         "returned mdns source " + v.second.get<std::string>("id"));
   }
+  cli.sap_wait_announcement(0, sdp.second);
+  json = cli.get_remote_sources();
+  BOOST_REQUIRE_MESSAGE(json.first, "got remote sources");
+  std::stringstream ss1(json.second);
+  boost::property_tree::read_json(ss1, pt);
+  BOOST_REQUIRE_MESSAGE(pt.get_child("remote_sources").size() == 1,
+                        "SAP and mDNS sources merged");
   BOOST_REQUIRE_MESSAGE(cli.remove_source(0), "removed source 0");
   BOOST_REQUIRE_MESSAGE(cli.wait_for_remote_mdns_sources(0),
                         "no remote mdns sources");
@@ -611,6 +889,42 @@ BOOST_AUTO_TEST_CASE(sink_check_status) {
   BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
 }
 
+BOOST_AUTO_TEST_CASE(sink_check_delay_tuning) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_sdp(0), "added sink 0");
+  auto json = cli.get_sink_delay_tuning(0);
+  BOOST_REQUIRE_MESSAGE(json.first, "got sink delay tuning 0");
+  boost::property_tree::ptree pt;
+  std::stringstream ss(json.second);
+  boost::property_tree::read_json(ss, pt);
+  auto mode = pt.get<std::string>("mode");
+  auto delay = pt.get<int>("delay");
+  BOOST_REQUIRE_MESSAGE(mode == "off", "delay tuning is off");
+  BOOST_REQUIRE_MESSAGE(delay == 1024, "sink delay as expected");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(!cli.get_sink_delay_tuning(0).first,
+                        "no delay tuning for removed sink 0");
+}
+
+BOOST_AUTO_TEST_CASE(sink_check_status_history) {
+  Client cli;
+  BOOST_REQUIRE_MESSAGE(cli.add_sink_sdp(0), "added sink 0");
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  auto json = cli.get_sink_status_history(0);
+  BOOST_REQUIRE_MESSAGE(json.first, "got sink status history 0");
+  boost::property_tree::ptree pt;
+  std::stringstream ss(json.second);
+  boost::property_tree::read_json(ss, pt);
+  auto samples = pt.get_child("samples");
+  BOOST_REQUIRE_MESSAGE(samples.size() > 0, "sink status sampled");
+  BOOST_REQUIRE_MESSAGE(
+      samples.front().second.get<uint32_t>("time") <= pt.get<uint32_t>("now"),
+      "sample time as expected");
+  BOOST_REQUIRE_MESSAGE(cli.remove_sink(0), "removed sink 0");
+  BOOST_REQUIRE_MESSAGE(!cli.get_sink_status_history(0).first,
+                        "no status history for removed sink 0");
+}
+
 BOOST_AUTO_TEST_CASE(add_remove_all_sources) {
   Client cli;
   for (int id = 0; id < g_stream_num_max; id++) {
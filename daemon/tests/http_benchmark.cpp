@@ -0,0 +1,587 @@
+//
+//  http_benchmark.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * HTTP REST API throughput benchmark.
+ *
+ * Starts a daemon instance with the userspace driver backend (or uses a
+ * running one with --no_start), creates the requested number of sources
+ * and sinks, fills the remote sources catalog via SAP and then runs a
+ * closed loop load: every connection sends the next request as soon as it
+ * gets the previous response. The requests are picked from the routes in
+ * the mix according to their weight.
+ *
+ * The throughput and the latency distribution of every route are printed
+ * at the end and optionally saved as JSON to compare different builds.
+ */
+
+#include <httplib.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "local_daemon.hpp"
+#include "sap_announcer.hpp"
+
+namespace po = boost::program_options;
+using boost::asio::ip::tcp;
+using namespace std::chrono;
+
+constexpr static int g_stream_num_max = 64;
+
+struct Options {
+  int duration{10};
+  int warmup{2};
+  int concurrency{4};
+  bool keep_alive{true};
+  std::string mix{"streams=1,sink_status=1,browse_all=1"};
+  int streams{16};
+  int catalog{64};
+  std::string json;
+  bool no_start{false};
+  std::string backend{"userspace"};
+  std::string daemon{"../aes67-daemon"};
+  std::string config{"daemon.conf"};
+  std::string address{"127.0.0.1"};
+  int port{9999};
+};
+
+struct Route {
+  const char* name;
+  const char* path;
+  bool per_stream; /* the stream id is appended to the path */
+};
+
+static const std::vector<Route> g_routes = {
+    {"streams", "/api/streams", false},
+    {"sources", "/api/sources", false},
+    {"sinks", "/api/sinks", false},
+    {"sink_status", "/api/sink/status/", true},
+    {"source_sdp", "/api/source/sdp/", true},
+    {"browse_all", "/api/browse/sources/all", false},
+    {"browse_sap", "/api/browse/sources/sap", false},
+    {"browse_mdns", "/api/browse/sources/mdns", false},
+    {"ptp_status", "/api/ptp/status", false},
+    {"config", "/api/config", false},
+};
+
+struct RouteStats {
+  LatencyHistogram latency;
+  uint64_t errors{0};
+  uint64_t bytes{0};
+};
+
+struct WorkerStats {
+  std::vector<RouteStats> routes{g_routes.size()};
+  uint64_t connects{0};
+};
+
+static std::atomic_bool g_running{true};
+static std::atomic_bool g_measuring{false};
+
+/*
+ * Minimal HTTP/1.1 client, so that keep-alive is under control and the
+ * client overhead is as low as possible.
+ */
+class HttpConnection {
+ public:
+  HttpConnection(const tcp::endpoint& endpoint,
+                 const std::string& host,
+                 bool keep_alive)
+      : endpoint_(endpoint), host_(host), keep_alive_(keep_alive) {}
+
+  /* returns the response status or -1 on transport error */
+  int get(const std::string& path, size_t& body_length, uint64_t& connects) {
+    /* retry once if the server closed an idle keep-alive connection */
+    for (int attempt = 0; attempt < 2; attempt++) {
+      bool reused = socket_.is_open();
+      if (!reused) {
+        boost::system::error_code ec;
+        socket_.connect(endpoint_, ec);
+        if (ec) {
+          socket_.close();
+          return -1;
+        }
+        socket_.set_option(tcp::no_delay(true));
+        connects++;
+      }
+      int status = request(path, body_length);
+      if (status > 0 || !reused) {
+        return status;
+      }
+    }
+    return -1;
+  }
+
+ private:
+  int request(const std::string& path, size_t& body_length) {
+    boost::system::error_code ec;
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + host_ +
+                      "\r\nConnection: " +
+                      (keep_alive_ ? "keep-alive" : "close") + "\r\n\r\n";
+    boost::asio::write(socket_, boost::asio::buffer(req), ec);
+    if (!ec) {
+      boost::asio::read_until(socket_, buf_, "\r\n\r\n", ec);
+    }
+    if (ec) {
+      close();
+      return -1;
+    }
+
+    std::istream is(&buf_);
+    std::string line;
+    std::getline(is, line);
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of(" "));
+    int status = fields.size() > 1 ? std::atoi(fields[1].c_str()) : -1;
+    long content_length = -1;
+    bool close_connection = !keep_alive_;
+    while (std::getline(is, line) && line != "\r") {
+      boost::to_lower(line);
+      if (line.rfind("content-length:", 0) == 0) {
+        content_length = std::atol(line.c_str() + 15);
+      } else if (line.rfind("connection:", 0) == 0 &&
+                 line.find("close") != std::string::npos) {
+        close_connection = true;
+      }
+    }
+
+    if (content_length < 0) {
+      /* body delimited by the connection close */
+      boost::asio::read(socket_, buf_, boost::asio::transfer_all(), ec);
+      body_length = buf_.size();
+      close_connection = true;
+    } else {
+      if (buf_.size() < static_cast<size_t>(content_length)) {
+        boost::asio::read(
+            socket_, buf_,
+            boost::asio::transfer_exactly(content_length - buf_.size()), ec);
+        if (ec) {
+          close();
+          return -1;
+        }
+      }
+      body_length = content_length;
+    }
+    buf_.consume(body_length);
+    if (close_connection) {
+      close();
+    }
+    return status;
+  }
+
+  void close() {
+    boost::system::error_code ec;
+    socket_.close(ec);
+    buf_.consume(buf_.size());
+  }
+
+  tcp::endpoint endpoint_;
+  std::string host_;
+  bool keep_alive_;
+  boost::asio::io_service io_service_;
+  tcp::socket socket_{io_service_};
+  boost::asio::streambuf buf_;
+};
+
+/* parse the route mix, name=weight comma separated */
+static bool parse_mix(const std::string& mix, std::vector<int>& weights) {
+  weights.assign(g_routes.size(), 0);
+  std::vector<std::string> items;
+  boost::split(items, mix, boost::is_any_of(","));
+  for (auto const& item : items) {
+    std::vector<std::string> kv;
+    boost::split(kv, item, boost::is_any_of("="));
+    auto it = std::find_if(g_routes.begin(), g_routes.end(),
+                           [&kv](const Route& r) { return kv[0] == r.name; });
+    if (it == g_routes.end()) {
+      std::cerr << "unknown route " << kv[0] << std::endl;
+      return false;
+    }
+    int weight = kv.size() > 1 ? std::atoi(kv[1].c_str()) : 1;
+    if (weight < 0) {
+      return false;
+    }
+    weights[it - g_routes.begin()] = weight;
+  }
+  return std::accumulate(weights.begin(), weights.end(), 0) > 0;
+}
+
+static void worker(const Options& options,
+                   const tcp::endpoint& endpoint,
+                   const std::vector<int>& weights,
+                   int index,
+                   WorkerStats& stats) {
+  HttpConnection conn(endpoint,
+                      options.address + ":" + std::to_string(options.port),
+                      options.keep_alive);
+  std::mt19937 gen(index);
+  std::discrete_distribution<size_t> route_dist(weights.begin(),
+                                                weights.end());
+  std::uniform_int_distribution<int> id_dist(
+      0, std::max(options.streams, 1) - 1);
+  uint64_t connects = 0;
+  while (g_running) {
+    size_t r = route_dist(gen);
+    std::string path = g_routes[r].path;
+    if (g_routes[r].per_stream) {
+      path += std::to_string(id_dist(gen));
+    }
+    size_t length = 0;
+    auto start = steady_clock::now();
+    int status = conn.get(path, length, connects);
+    auto us = duration_cast<microseconds>(steady_clock::now() - start).count();
+    if (g_measuring) {
+      auto& route = stats.routes[r];
+      route.latency.add(us);
+      route.bytes += length;
+      if (status != 200) {
+        route.errors++;
+      }
+      stats.connects += connects;
+    }
+    connects = 0;
+  }
+}
+
+static bool setup_streams(const Options& options) {
+  httplib::Client cli(options.address.c_str(), options.port);
+  cli.set_connection_timeout(30);
+  cli.set_read_timeout(30);
+  cli.set_write_timeout(30);
+  for (int id = 0; id < options.streams; id++) {
+    std::string json = R"(
+{
+  "enabled": true,
+  "name": "Benchmark",
+  "io": "Audio Device",
+  "map": [ 0, 1 ],
+  "max_samples_per_packet": 48,
+  "codec": "L24",
+  "address": "",
+  "ttl": 15,
+  "payload_type": 98,
+  "dscp": 34,
+  "refclk_ptp_traceable": false
+}
+    )";
+    boost::replace_first(json, "Benchmark", "Benchmark " + std::to_string(id));
+    std::string url = "/api/source/" + std::to_string(id);
+    auto res = cli.Put(url.c_str(), json, "application/json");
+    if (!res || res->status != 200) {
+      std::cerr << "cannot add source " << id << std::endl;
+      return false;
+    }
+    url = "/api/source/sdp/" + std::to_string(id);
+    auto sdp = cli.Get(url.c_str());
+    if (!sdp || sdp->status != 200) {
+      std::cerr << "cannot get source " << id << " SDP" << std::endl;
+      return false;
+    }
+    boost::property_tree::ptree pt, map, channel;
+    pt.put("name", "Benchmark " + std::to_string(id));
+    pt.put("io", "Audio Device");
+    pt.put("source", "");
+    pt.put("use_sdp", true);
+    pt.put("sdp", sdp->body);
+    pt.put("delay", 1024);
+    pt.put("ignore_refclk_gmid", true);
+    for (int ch = 0; ch < 2; ch++) {
+      channel.put("", ch);
+      map.push_back(std::make_pair("", channel));
+    }
+    pt.add_child("map", map);
+    std::stringstream ss;
+    boost::property_tree::write_json(ss, pt);
+    url = "/api/sink/" + std::to_string(id);
+    res = cli.Put(url.c_str(), ss.str(), "application/json");
+    if (!res || res->status != 200) {
+      std::cerr << "cannot add sink " << id << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static void remove_streams(const Options& options) {
+  httplib::Client cli(options.address.c_str(), options.port);
+  for (int id = 0; id < options.streams; id++) {
+    std::string url = "/api/sink/" + std::to_string(id);
+    cli.Delete(url.c_str());
+    url = "/api/source/" + std::to_string(id);
+    cli.Delete(url.c_str());
+  }
+}
+
+/* wait for the daemon browser to list the remote sources announced */
+static size_t wait_catalog(const Options& options) {
+  httplib::Client cli(options.address.c_str(), options.port);
+  size_t size = 0;
+  for (int retry = 0; retry < 20; retry++) {
+    auto res = cli.Get("/api/browse/sources/sap");
+    if (res && res->status == 200) {
+      boost::property_tree::ptree pt;
+      std::stringstream ss(res->body);
+      try {
+        boost::property_tree::read_json(ss, pt);
+        size = pt.get_child("remote_sources").size();
+      } catch (...) {
+      }
+      if (size >= static_cast<size_t>(options.catalog)) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(milliseconds(500));
+  }
+  return size;
+}
+
+static void print_route(const char* name,
+                        const RouteStats& stats,
+                        double secs) {
+  auto const& h = stats.latency;
+  std::cout << "  " << std::left << std::setw(12) << name << std::right
+            << std::setw(10) << h.count() << std::fixed
+            << std::setprecision(1) << std::setw(10) << h.count() / secs
+            << std::setw(8) << stats.errors << std::setprecision(3)
+            << std::setw(9) << h.mean() / 1000 << std::setw(9)
+            << h.percentile(50) / 1000.0 << std::setw(9)
+            << h.percentile(90) / 1000.0 << std::setw(9)
+            << h.percentile(99) / 1000.0 << std::setw(9)
+            << h.percentile(99.9) / 1000.0 << std::setw(9)
+            << h.max() / 1000.0 << std::setw(10)
+            << (h.count() ? stats.bytes / h.count() : 0) << std::endl;
+}
+
+static void route_to_json(std::ostream& os,
+                          const char* name,
+                          const RouteStats& stats,
+                          double secs) {
+  auto const& h = stats.latency;
+  os << "    { \"name\": \"" << name << "\", \"requests\": " << h.count()
+     << ", \"errors\": " << stats.errors << std::fixed << std::setprecision(1)
+     << ", \"requests_per_sec\": " << h.count() / secs
+     << std::setprecision(3) << ", \"mean_ms\": " << h.mean() / 1000
+     << ", \"p50_ms\": " << h.percentile(50) / 1000.0
+     << ", \"p90_ms\": " << h.percentile(90) / 1000.0
+     << ", \"p99_ms\": " << h.percentile(99) / 1000.0
+     << ", \"p999_ms\": " << h.percentile(99.9) / 1000.0
+     << ", \"max_ms\": " << h.max() / 1000.0
+     << ", \"bytes\": " << stats.bytes << " }";
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  po::options_description desc("Options");
+  desc.add_options()
+      ("duration,d", po::value<int>(&options.duration)->default_value(10),
+       "measurement duration in seconds")
+      ("warmup,w", po::value<int>(&options.warmup)->default_value(2),
+       "warm up in seconds, not measured")
+      ("concurrency,n", po::value<int>(&options.concurrency)->default_value(4),
+       "concurrent connections")
+      ("keep_alive,k", po::value<bool>(&options.keep_alive)->default_value(true),
+       "reuse the connections")
+      ("mix,m",
+       po::value<std::string>(&options.mix)->default_value(
+           "streams=1,sink_status=1,browse_all=1"),
+       "routes and their weights: streams, sources, sinks, sink_status, "
+       "source_sdp, browse_all, browse_sap, browse_mdns, ptp_status, config")
+      ("streams,s", po::value<int>(&options.streams)->default_value(16),
+       "sources and sinks created before the run (0-64)")
+      ("catalog", po::value<int>(&options.catalog)->default_value(64),
+       "remote sources announced via SAP during the run")
+      ("json,j", po::value<std::string>(&options.json),
+       "save the results to this JSON file")
+      ("no_start", po::bool_switch(&options.no_start),
+       "use the daemon already running on the port")
+      ("backend,b",
+       po::value<std::string>(&options.backend)->default_value("userspace"),
+       "driver backend of the daemon started, kernel or userspace")
+      ("daemon",
+       po::value<std::string>(&options.daemon)->default_value(
+           "../aes67-daemon"),
+       "daemon executable")
+      ("config,c",
+       po::value<std::string>(&options.config)->default_value("daemon.conf"),
+       "daemon configuration file, copied to benchmark.conf with the backend "
+       "and port set")
+      ("port,p", po::value<int>(&options.port)->default_value(9999),
+       "daemon HTTP port")
+      ("help,h", "print this help message");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (std::exception const& e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (vm.count("help")) {
+    std::cout << "Usage: " << argv[0] << " [options]" << std::endl
+              << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+  std::vector<int> weights;
+  if (options.duration < 1 || options.warmup < 0 || options.concurrency < 1 ||
+      options.streams < 0 || options.streams > g_stream_num_max ||
+      options.catalog < 0 || options.catalog > 65535 ||
+      !parse_mix(options.mix, weights)) {
+    std::cerr << "invalid options" << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  LocalDaemon daemon;
+  if (!options.no_start &&
+      !daemon.start(options.daemon, options.config, "benchmark.conf",
+                    options.backend, options.port)) {
+    return EXIT_FAILURE;
+  }
+  if (!LocalDaemon::wait_ready(options.address, options.port)) {
+    std::cerr << "daemon is not responding" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!setup_streams(options)) {
+    remove_streams(options);
+    return EXIT_FAILURE;
+  }
+
+  /* keep the catalog alive re-announcing every source each second */
+  std::thread announcer_thread;
+  size_t catalog = 0;
+  if (options.catalog) {
+    announcer_thread = std::thread([&options]() {
+      SapAnnouncer announcer(LocalDaemon::get_sap_address(options.config),
+                             options.address);
+      while (g_running) {
+        auto next = steady_clock::now() + seconds(1);
+        for (int n = 0; n < options.catalog && g_running; n++) {
+          announcer.send(true, n);
+        }
+        std::this_thread::sleep_until(next);
+      }
+      for (int n = 0; n < options.catalog; n++) {
+        announcer.send(false, n);
+      }
+    });
+    catalog = wait_catalog(options);
+  }
+
+  tcp::endpoint endpoint(boost::asio::ip::address::from_string(options.address),
+                         options.port);
+  std::vector<WorkerStats> stats(options.concurrency);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < options.concurrency; i++) {
+    workers.emplace_back(worker, std::cref(options), std::cref(endpoint),
+                         std::cref(weights), i, std::ref(stats[i]));
+  }
+  std::this_thread::sleep_for(seconds(options.warmup));
+  g_measuring = true;
+  auto start = steady_clock::now();
+  std::this_thread::sleep_for(seconds(options.duration));
+  g_measuring = false;
+  double secs = duration<double>(steady_clock::now() - start).count();
+  g_running = false;
+  for (auto& thread : workers) {
+    thread.join();
+  }
+  if (announcer_thread.joinable()) {
+    announcer_thread.join();
+  }
+  remove_streams(options);
+  bool daemon_ok = options.no_start || daemon.stop();
+
+  /* merge the workers statistics */
+  std::vector<RouteStats> routes(g_routes.size());
+  RouteStats total;
+  uint64_t connects = 0;
+  for (auto const& s : stats) {
+    for (size_t r = 0; r < g_routes.size(); r++) {
+      routes[r].latency.merge(s.routes[r].latency);
+      routes[r].errors += s.routes[r].errors;
+      routes[r].bytes += s.routes[r].bytes;
+      total.latency.merge(s.routes[r].latency);
+      total.errors += s.routes[r].errors;
+      total.bytes += s.routes[r].bytes;
+    }
+    connects += s.connects;
+  }
+
+  std::cout << "concurrency " << options.concurrency << ", keep-alive "
+            << (options.keep_alive ? "on" : "off") << ", streams "
+            << options.streams << ", catalog " << catalog << "/"
+            << options.catalog << ", connections " << connects << ", "
+            << std::fixed << std::setprecision(1) << secs << " s" << std::endl;
+  std::cout << "  " << std::left << std::setw(12) << "route" << std::right
+            << std::setw(10) << "requests" << std::setw(10) << "req/s"
+            << std::setw(8) << "errors" << std::setw(9) << "mean ms"
+            << std::setw(9) << "p50 ms" << std::setw(9) << "p90 ms"
+            << std::setw(9) << "p99 ms" << std::setw(9) << "p99.9 ms"
+            << std::setw(9) << "max ms" << std::setw(10) << "bytes"
+            << std::endl;
+  for (size_t r = 0; r < g_routes.size(); r++) {
+    if (weights[r]) {
+      print_route(g_routes[r].name, routes[r], secs);
+    }
+  }
+  print_route("total", total, secs);
+
+  if (!options.json.empty()) {
+    std::ofstream os(options.json);
+    os << "{\n  \"concurrency\": " << options.concurrency
+       << ",\n  \"keep_alive\": " << (options.keep_alive ? "true" : "false")
+       << ",\n  \"streams\": " << options.streams
+       << ",\n  \"catalog\": " << catalog
+       << ",\n  \"connections\": " << connects << std::fixed
+       << std::setprecision(3) << ",\n  \"duration\": " << secs
+       << ",\n  \"routes\": [\n";
+    int count = 0;
+    for (size_t r = 0; r < g_routes.size(); r++) {
+      if (weights[r]) {
+        if (count++) {
+          os << ",\n";
+        }
+        route_to_json(os, g_routes[r].name, routes[r], secs);
+      }
+    }
+    os << "\n  ],\n  \"total\":\n";
+    route_to_json(os, "total", total, secs);
+    os << "\n}\n";
+    if (!os) {
+      std::cerr << "cannot write " << options.json << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return daemon_ok && !total.errors ? EXIT_SUCCESS : EXIT_FAILURE;
+}
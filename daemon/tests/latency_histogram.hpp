@@ -0,0 +1,109 @@
+//
+//  latency_histogram.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _LATENCY_HISTOGRAM_HPP_
+#define _LATENCY_HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/*
+ * Log-linear histogram of latencies in microseconds.
+ * Values below 16us are exact, the others are recorded with 16 buckets per
+ * power of two (about 6% precision) so memory is constant for long runs.
+ */
+class LatencyHistogram {
+ public:
+  void add(uint64_t us) {
+    buckets_[index(us)]++;
+    count_++;
+    sum_ += us;
+    if (us > max_) {
+      max_ = us;
+    }
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  void reset() { *this = LatencyHistogram(); }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+  double mean() const {
+    return count_ ? static_cast<double>(sum_) / count_ : 0;
+  }
+
+  /* upper bound of the bucket containing the percentile p (0-100) */
+  uint64_t percentile(double p) const {
+    if (!count_) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100 * count_ + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(upper(i), max_);
+      }
+    }
+    return max_;
+  }
+
+ private:
+  constexpr static int sub_bits = 4;
+  constexpr static uint64_t sub_count = 1 << sub_bits;
+
+  static size_t index(uint64_t v) {
+    if (v < sub_count) {
+      return v;
+    }
+    int e = 63 - __builtin_clzll(v);
+    return ((e - sub_bits + 1) << sub_bits) +
+           ((v >> (e - sub_bits)) & (sub_count - 1));
+  }
+
+  static uint64_t upper(size_t i) {
+    if (i < sub_count) {
+      return i;
+    }
+    int e = (i >> sub_bits) + sub_bits - 1;
+    uint64_t lower = (sub_count + (i & (sub_count - 1))) << (e - sub_bits);
+    return lower + (1ULL << (e - sub_bits)) - 1;
+  }
+
+  std::array<uint64_t, (64 - sub_bits + 1) << sub_bits> buckets_{};
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t max_{0};
+};
+
+#endif
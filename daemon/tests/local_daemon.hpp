@@ -0,0 +1,114 @@
+//
+//  local_daemon.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _LOCAL_DAEMON_HPP_
+#define _LOCAL_DAEMON_HPP_
+
+#include <httplib.h>
+#include <boost/process.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+/*
+ * Daemon instance used by the stress and benchmark tools.
+ * The configuration is copied with the driver backend and the HTTP port
+ * replaced, no status file is used.
+ */
+class LocalDaemon {
+ public:
+  LocalDaemon() = default;
+  LocalDaemon(const LocalDaemon&) = delete;
+  LocalDaemon& operator=(const LocalDaemon&) = delete;
+  ~LocalDaemon() { stop(); }
+
+  bool start(const std::string& exe,
+             const std::string& config,
+             const std::string& config_copy,
+             const std::string& backend,
+             int port) {
+    boost::property_tree::ptree pt;
+    try {
+      boost::property_tree::read_json(config, pt);
+      pt.put("driver_backend", backend);
+      pt.put("http_port", port);
+      pt.put("status_file", "");
+      boost::property_tree::write_json(config_copy, pt);
+      child_ = std::make_unique<boost::process::child>(
+          exe, "-c", config_copy, "-p", std::to_string(port));
+    } catch (std::exception const& e) {
+      std::cerr << "cannot start " << exe << ": " << e.what() << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /* terminate the daemon, returns false if it didn't exit normally */
+  bool stop() {
+    if (!child_) {
+      return true;
+    }
+    if (child_->running()) {
+      kill(child_->id(), SIGTERM);
+    }
+    child_->wait();
+    int exit_code = child_->exit_code();
+    child_.reset();
+    if (exit_code) {
+      std::cerr << "daemon exit code " << exit_code << std::endl;
+    }
+    return !exit_code;
+  }
+
+  bool running() { return child_ && child_->running(); }
+  int pid() const { return child_ ? child_->id() : 0; }
+
+  static bool wait_ready(const std::string& address, int port) {
+    int retry = 10;
+    while (retry--) {
+      httplib::Client cli(address.c_str(), port);
+      auto res = cli.Get("/");
+      if (res) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    return false;
+  }
+
+  static std::string get_sap_address(const std::string& config) {
+    boost::property_tree::ptree pt;
+    try {
+      boost::property_tree::read_json(config, pt);
+    } catch (...) {
+    }
+    return pt.get<std::string>("sap_mcast_addr", "224.2.127.254");
+  }
+
+ private:
+  std::unique_ptr<boost::process::child> child_;
+};
+
+#endif
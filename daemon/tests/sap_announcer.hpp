@@ -0,0 +1,81 @@
+//
+//  sap_announcer.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _SAP_ANNOUNCER_HPP_
+#define _SAP_ANNOUNCER_HPP_
+
+#include <boost/asio.hpp>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Announces and deletes fake remote sources via SAP, remote source n
+ * has address 10.255.x.y and name "Remote SAP n".
+ */
+class SapAnnouncer {
+ public:
+  constexpr static uint16_t port = 9875;
+  constexpr static uint16_t sap_header_len = 24;
+
+  SapAnnouncer(const std::string& sap_addr, const std::string& interface_ip)
+      : endpoint_(boost::asio::ip::address::from_string(sap_addr), port) {
+    using namespace boost::asio::ip;
+    socket_.open(udp::v4());
+    socket_.set_option(multicast::outbound_interface(
+        address::from_string(interface_ip).to_v4()));
+    socket_.set_option(multicast::enable_loopback(true));
+  }
+
+  bool send(bool is_announce, uint16_t n) {
+    uint32_t addr = htonl(0x0aff0000 + n + 1);
+    std::string ip = boost::asio::ip::address_v4(ntohl(addr)).to_string();
+    std::string mcast = "239.3." + std::to_string(n / 254) + "." +
+                        std::to_string(n % 254 + 1);
+    std::stringstream ss;
+    ss << "v=0\no=- " << n << " 0 IN IP4 " << ip << "\n"
+       << "s=Remote SAP " << n << "\nc=IN IP4 " << mcast << "/15\n"
+       << "t=0 0\na=clock-domain:PTPv2 0\nm=audio 5004 RTP/AVP 98\n"
+       << "c=IN IP4 " << mcast << "/15\n"
+       << "a=rtpmap:98 L24/48000/2\na=sync-time:0\na=framecount:48\n"
+       << "a=ptime:1\na=mediaclk:direct=0\n"
+       << "a=ts-refclk:ptp=IEEE1588-2008:00-1D-C1-FF-FE-00-00-00:0\n"
+       << "a=recvonly\n";
+    std::string sdp = ss.str();
+    uint16_t msg_id_hash = n + 1;
+    std::vector<uint8_t> packet(sap_header_len + sdp.length(), 0);
+    packet[0] = is_announce ? 0x20 : 0x24;
+    memcpy(packet.data() + 2, &msg_id_hash, 2);
+    memcpy(packet.data() + 4, &addr, 4);
+    memcpy(packet.data() + 8, "application/sdp", 16); /* include trailing 0 */
+    memcpy(packet.data() + sap_header_len, sdp.c_str(), sdp.length());
+    boost::system::error_code ec;
+    socket_.send_to(boost::asio::buffer(packet), endpoint_, 0, ec);
+    return !ec;
+  }
+
+ private:
+  boost::asio::io_service io_service_;
+  boost::asio::ip::udp::socket socket_{io_service_};
+  boost::asio::ip::udp::endpoint endpoint_;
+};
+
+#endif
@@ -0,0 +1,591 @@
+//
+//  stress_test.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+/*
+ * Control plane stress and soak test.
+ *
+ * Starts a daemon instance (or attaches to a running one with --pid) and
+ * drives it concurrently with:
+ * - mutators adding, updating and removing sources and sinks, every
+ *   mutator owns a subset of the stream ids so all its requests must succeed
+ * - readers polling streams, sink status and PTP status
+ * - browsers querying the remote sources
+ * - a SAP thread announcing and deleting remote sources
+ * Sources are also advertised and browsed via mDNS when the daemon is built
+ * with Avahi, so stream mutations generate mDNS churn as well.
+ *
+ * Every report interval the latency percentiles and error count of each
+ * request are printed together with the daemon memory, threads, file
+ * descriptors and sockets. At the end all the streams are removed and the
+ * daemon threads and sockets are compared with the ones after warm up.
+ * The exit code is 0 if no error occurred and nothing leaked.
+ */
+
+#include <httplib.h>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "local_daemon.hpp"
+#include "sap_announcer.hpp"
+
+namespace po = boost::program_options;
+using namespace std::chrono;
+
+constexpr static int g_stream_num_max = 64;
+
+struct Options {
+  int duration{60};
+  int report{10};
+  int mutators{4};
+  int readers{4};
+  int browsers{2};
+  int sap_sources{32};
+  int sap_rate{20};
+  std::string backend{"userspace"};
+  std::string daemon{"../aes67-daemon"};
+  std::string config{"daemon.conf"};
+  std::string address{"127.0.0.1"};
+  int port{9999};
+  int pid{0};
+};
+
+enum class Op {
+  add_source,
+  update_source,
+  remove_source,
+  get_source_sdp,
+  add_sink,
+  remove_sink,
+  get_sink_status,
+  get_streams,
+  get_ptp_status,
+  browse_sources,
+  count
+};
+
+static const char* op_names[] = {
+    "add_source",      "update_source",  "remove_source", "get_source_sdp",
+    "add_sink",        "remove_sink",    "get_sink_status", "get_streams",
+    "get_ptp_status",  "browse_sources"};
+
+struct OpStats {
+  std::mutex mutex;
+  LatencyHistogram interval;
+  LatencyHistogram total;
+  uint64_t interval_errors{0};
+  uint64_t total_errors{0};
+};
+
+struct ProcessStats {
+  uint64_t rss_kb{0};
+  int threads{0};
+  int fds{0};
+  int sockets{0};
+};
+
+static std::array<OpStats, static_cast<size_t>(Op::count)> g_stats;
+static std::atomic_bool g_running{true};
+static std::atomic<uint64_t> g_sap_packets{0};
+static std::mutex g_log_mutex;
+
+static ProcessStats get_process_stats(int pid) {
+  ProcessStats stats;
+  std::string path = "/proc/" + std::to_string(pid);
+  std::ifstream status(path + "/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      stats.rss_kb = std::stoull(line.substr(6));
+    } else if (line.rfind("Threads:", 0) == 0) {
+      stats.threads = std::stoi(line.substr(8));
+    }
+  }
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(path + "/fd", ec), end;
+       !ec && it != end; it.increment(ec)) {
+    stats.fds++;
+    auto target = boost::filesystem::read_symlink(it->path(), ec);
+    if (!ec && target.string().rfind("socket:", 0) == 0) {
+      stats.sockets++;
+    }
+  }
+  return stats;
+}
+
+class Client {
+ public:
+  Client(const Options& options)
+      : cli_(options.address.c_str(), options.port) {
+    cli_.set_connection_timeout(30);
+    cli_.set_read_timeout(30);
+    cli_.set_write_timeout(30);
+  }
+
+  /* execute a request and record its latency,
+   * a response with a status not in accepted is an error */
+  std::pair<bool, std::string> request(Op op,
+                                       const std::string& method,
+                                       const std::string& url,
+                                       const std::string& body = "",
+                                       std::vector<int> accepted = {200}) {
+    int status = -1;
+    std::string res_body;
+    auto handle = [&](auto res) {
+      if (res) {
+        status = res->status;
+        res_body = std::move(res->body);
+      }
+    };
+    auto start = steady_clock::now();
+    if (method == "GET") {
+      handle(cli_.Get(url.c_str()));
+    } else if (method == "PUT") {
+      handle(cli_.Put(url.c_str(), body, "application/json"));
+    } else {
+      handle(cli_.Delete(url.c_str()));
+    }
+    auto us = duration_cast<microseconds>(steady_clock::now() - start).count();
+    bool ok = std::find(accepted.begin(), accepted.end(), status) !=
+              accepted.end();
+    auto& stats = g_stats[static_cast<size_t>(op)];
+    {
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      stats.interval.add(us);
+      if (!ok) {
+        stats.interval_errors++;
+      }
+    }
+    if (!ok) {
+      std::lock_guard<std::mutex> lock(g_log_mutex);
+      std::cerr << "error: " << method << " " << url << " returned "
+                << (status < 0 ? std::string("no response")
+                               : std::to_string(status) + " " + res_body)
+                << std::endl;
+    }
+    return {status == 200, res_body};
+  }
+
+  bool add_source(int id, bool update) {
+    std::string json = R"(
+{
+  "enabled": true,
+  "name": "Stress",
+  "io": "Audio Device",
+  "map": [ 0, 1 ],
+  "max_samples_per_packet": MAX_SAMPLES,
+  "codec": "CODEC",
+  "address": "",
+  "ttl": 15,
+  "payload_type": 98,
+  "dscp": 34,
+  "refclk_ptp_traceable": false
+}
+    )";
+    boost::replace_first(json, "Stress", "Stress " + std::to_string(id));
+    boost::replace_first(json, "MAX_SAMPLES", update ? "192" : "48");
+    boost::replace_first(json, "CODEC", update ? "L24" : "L16");
+    return request(update ? Op::update_source : Op::add_source, "PUT",
+                   "/api/source/" + std::to_string(id), json)
+        .first;
+  }
+
+  bool add_sink(int id, const std::string& sdp) {
+    boost::property_tree::ptree pt;
+    pt.put("name", "Stress " + std::to_string(id));
+    pt.put("io", "Audio Device");
+    pt.put("source", "");
+    pt.put("use_sdp", true);
+    pt.put("sdp", sdp);
+    pt.put("delay", 1024);
+    pt.put("ignore_refclk_gmid", true);
+    boost::property_tree::ptree map, channel;
+    channel.put("", 0);
+    map.push_back(std::make_pair("", channel));
+    channel.put("", 1);
+    map.push_back(std::make_pair("", channel));
+    pt.add_child("map", map);
+    std::stringstream ss;
+    boost::property_tree::write_json(ss, pt);
+    return request(Op::add_sink, "PUT", "/api/sink/" + std::to_string(id),
+                   ss.str())
+        .first;
+  }
+
+ private:
+  httplib::Client cli_;
+};
+
+/* add, update and remove the sources and sinks with id % count == index */
+static void mutator(const Options& options, int index) {
+  struct Stream {
+    bool source{false};
+    bool sink{false};
+  };
+  Client cli(options);
+  std::mt19937 gen(index);
+  std::vector<int> ids;
+  for (int id = index; id < g_stream_num_max; id += options.mutators) {
+    ids.push_back(id);
+  }
+  std::vector<Stream> streams(ids.size());
+  enum class Action { add_source, update_source, remove_source, add_sink,
+                      remove_sink };
+
+  while (g_running) {
+    size_t i = std::uniform_int_distribution<size_t>(0, ids.size() - 1)(gen);
+    int id = ids[i];
+    auto& stream = streams[i];
+    std::vector<Action> actions;
+    if (!stream.source) {
+      actions.push_back(Action::add_source);
+    } else {
+      actions.push_back(Action::update_source);
+      actions.push_back(Action::remove_source);
+      if (!stream.sink) {
+        actions.push_back(Action::add_sink);
+      }
+    }
+    if (stream.sink) {
+      actions.push_back(Action::remove_sink);
+    }
+    switch (actions[std::uniform_int_distribution<size_t>(
+        0, actions.size() - 1)(gen)]) {
+      case Action::add_source:
+        stream.source = cli.add_source(id, false);
+        break;
+      case Action::update_source:
+        cli.add_source(id, true);
+        break;
+      case Action::remove_source:
+        if (cli.request(Op::remove_source, "DELETE",
+                        "/api/source/" + std::to_string(id))
+                .first) {
+          stream.source = false;
+        }
+        break;
+      case Action::add_sink: {
+        auto [ok, sdp] = cli.request(Op::get_source_sdp, "GET",
+                                     "/api/source/sdp/" + std::to_string(id));
+        if (ok) {
+          stream.sink = cli.add_sink(id, sdp);
+        }
+      } break;
+      case Action::remove_sink:
+        if (cli.request(Op::remove_sink, "DELETE",
+                        "/api/sink/" + std::to_string(id))
+                .first) {
+          stream.sink = false;
+        }
+        break;
+    }
+  }
+
+  /* leave the daemon without streams */
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (streams[i].sink) {
+      cli.request(Op::remove_sink, "DELETE",
+                  "/api/sink/" + std::to_string(ids[i]));
+    }
+    if (streams[i].source) {
+      cli.request(Op::remove_source, "DELETE",
+                  "/api/source/" + std::to_string(ids[i]));
+    }
+  }
+}
+
+/* poll the status, a sink may not exist when it's read */
+static void reader(const Options& options, int index) {
+  Client cli(options);
+  std::mt19937 gen(100 + index);
+  while (g_running) {
+    switch (std::uniform_int_distribution<int>(0, 2)(gen)) {
+      case 0:
+        cli.request(Op::get_streams, "GET", "/api/streams");
+        break;
+      case 1: {
+        int id = std::uniform_int_distribution<int>(0, g_stream_num_max - 1)(gen);
+        cli.request(Op::get_sink_status, "GET",
+                    "/api/sink/status/" + std::to_string(id), "", {200, 400});
+      } break;
+      case 2:
+        cli.request(Op::get_ptp_status, "GET", "/api/ptp/status");
+        break;
+    }
+  }
+}
+
+static void browser(const Options& options, int index) {
+  static const char* types[] = {"all", "sap", "mdns"};
+  Client cli(options);
+  std::mt19937 gen(200 + index);
+  while (g_running) {
+    cli.request(Op::browse_sources, "GET",
+                std::string("/api/browse/sources/") +
+                    types[std::uniform_int_distribution<int>(0, 2)(gen)]);
+  }
+}
+
+/* announce and delete SAP remote sources at sap_rate packets per second */
+static void sap_churn(const Options& options, const std::string& sap_addr) {
+  SapAnnouncer announcer(sap_addr, options.address);
+  std::mt19937 gen(300);
+  auto interval = microseconds(1000000 / options.sap_rate);
+  auto next = steady_clock::now();
+  while (g_running) {
+    int n = std::uniform_int_distribution<int>(0, options.sap_sources - 1)(gen);
+    bool is_announce = std::uniform_int_distribution<int>(0, 9)(gen) != 0;
+    if (announcer.send(is_announce, n)) {
+      g_sap_packets++;
+    }
+    next += interval;
+    std::this_thread::sleep_until(next);
+  }
+}
+
+static void print_header(std::ostream& os) {
+  os << "  " << std::left << std::setw(16) << "request" << std::right
+     << std::setw(10) << "count" << std::setw(9) << "req/s" << std::setw(8)
+     << "errors" << std::setw(10) << "mean ms" << std::setw(9) << "p50 ms"
+     << std::setw(9) << "p90 ms" << std::setw(9) << "p99 ms" << std::setw(9)
+     << "max ms" << std::endl;
+}
+
+static void print_stats(std::ostream& os,
+                        const char* name,
+                        const LatencyHistogram& h,
+                        uint64_t errors,
+                        double secs) {
+  os << "  " << std::left << std::setw(16) << name << std::right
+     << std::setw(10) << h.count() << std::fixed << std::setprecision(1)
+     << std::setw(9) << h.count() / secs << std::setw(8) << errors
+     << std::setprecision(2) << std::setw(10) << h.mean() / 1000
+     << std::setw(9) << h.percentile(50) / 1000.0 << std::setw(9)
+     << h.percentile(90) / 1000.0 << std::setw(9) << h.percentile(99) / 1000.0
+     << std::setw(9) << h.max() / 1000.0 << std::endl;
+}
+
+static void print_process(std::ostream& os, const ProcessStats& stats) {
+  os << "  daemon rss " << stats.rss_kb << " kB, threads " << stats.threads
+     << ", fds " << stats.fds << ", sockets " << stats.sockets << std::endl;
+}
+
+/* print the interval statistics and merge them into the totals */
+static uint64_t report(int pid, double secs, double elapsed) {
+  uint64_t errors = 0;
+  std::cout << "[" << std::fixed << std::setprecision(0) << elapsed << " s]"
+            << " SAP packets " << g_sap_packets << std::endl;
+  print_header(std::cout);
+  for (size_t i = 0; i < g_stats.size(); i++) {
+    auto& stats = g_stats[i];
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    print_stats(std::cout, op_names[i], stats.interval, stats.interval_errors,
+                secs);
+    errors += stats.interval_errors;
+    stats.total.merge(stats.interval);
+    stats.total_errors += stats.interval_errors;
+    stats.interval.reset();
+    stats.interval_errors = 0;
+  }
+  print_process(std::cout, get_process_stats(pid));
+  return errors;
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+  po::options_description desc("Options");
+  desc.add_options()
+      ("duration,d", po::value<int>(&options.duration)->default_value(60),
+       "test duration in seconds")
+      ("report,r", po::value<int>(&options.report)->default_value(10),
+       "report interval in seconds")
+      ("mutators", po::value<int>(&options.mutators)->default_value(4),
+       "clients adding, updating and removing streams")
+      ("readers", po::value<int>(&options.readers)->default_value(4),
+       "clients polling streams, sink and PTP status")
+      ("browsers", po::value<int>(&options.browsers)->default_value(2),
+       "clients querying the remote sources")
+      ("sap_sources", po::value<int>(&options.sap_sources)->default_value(32),
+       "SAP remote sources announced and deleted, 0 to disable")
+      ("sap_rate", po::value<int>(&options.sap_rate)->default_value(20),
+       "SAP packets per second")
+      ("backend,b",
+       po::value<std::string>(&options.backend)->default_value("userspace"),
+       "driver backend of the daemon started, kernel or userspace")
+      ("daemon",
+       po::value<std::string>(&options.daemon)->default_value(
+           "../aes67-daemon"),
+       "daemon executable")
+      ("config,c",
+       po::value<std::string>(&options.config)->default_value("daemon.conf"),
+       "daemon configuration file, copied to stress.conf with the backend "
+       "and port set")
+      ("port,p", po::value<int>(&options.port)->default_value(9999),
+       "daemon HTTP port")
+      ("pid", po::value<int>(&options.pid),
+       "attach to the running daemon with this pid instead of starting it")
+      ("help,h", "print this help message");
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (std::exception const& e) {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (vm.count("help")) {
+    std::cout << "Usage: " << argv[0] << " [options]" << std::endl
+              << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (options.duration < 1 || options.report < 1 || options.mutators < 1 ||
+      options.mutators > g_stream_num_max || options.readers < 0 ||
+      options.browsers < 0 || options.sap_sources < 0 ||
+      options.sap_sources > 65535 || options.sap_rate < 1 ||
+      options.sap_rate > 1000000) {
+    std::cerr << "invalid options" << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  LocalDaemon daemon;
+  int pid = options.pid;
+  if (!pid) {
+    if (!daemon.start(options.daemon, options.config, "stress.conf",
+                      options.backend, options.port)) {
+      return EXIT_FAILURE;
+    }
+    pid = daemon.pid();
+  }
+  if (!LocalDaemon::wait_ready(options.address, options.port)) {
+    std::cerr << "daemon is not responding" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::string sap_addr = LocalDaemon::get_sap_address(options.config);
+
+  /* warm up, so that the threads started on demand are in the baseline */
+  {
+    Client cli(options);
+    cli.add_source(0, false);
+    auto [ok, sdp] = cli.request(Op::get_source_sdp, "GET",
+                                 "/api/source/sdp/0");
+    if (ok) {
+      cli.add_sink(0, sdp);
+      cli.request(Op::get_sink_status, "GET", "/api/sink/status/0");
+      cli.request(Op::remove_sink, "DELETE", "/api/sink/0");
+    }
+    cli.request(Op::remove_source, "DELETE", "/api/source/0");
+    cli.request(Op::browse_sources, "GET", "/api/browse/sources/all");
+  }
+  std::this_thread::sleep_for(seconds(3));
+  auto baseline = get_process_stats(pid);
+  for (auto& stats : g_stats) {
+    stats.interval.reset();
+    stats.interval_errors = 0;
+  }
+  std::cout << "baseline" << std::endl;
+  print_process(std::cout, baseline);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options.mutators; i++) {
+    threads.emplace_back(mutator, std::cref(options), i);
+  }
+  for (int i = 0; i < options.readers; i++) {
+    threads.emplace_back(reader, std::cref(options), i);
+  }
+  for (int i = 0; i < options.browsers; i++) {
+    threads.emplace_back(browser, std::cref(options), i);
+  }
+  if (options.sap_sources) {
+    threads.emplace_back(sap_churn, std::cref(options), sap_addr);
+  }
+
+  auto start = steady_clock::now();
+  auto last = start;
+  uint64_t peak_rss = baseline.rss_kb;
+  while (duration_cast<seconds>(steady_clock::now() - start).count() <
+         options.duration) {
+    auto end = std::min(last + seconds(options.report),
+                        start + seconds(options.duration));
+    std::this_thread::sleep_until(end);
+    auto now = steady_clock::now();
+    report(pid, duration<double>(now - last).count(),
+           duration<double>(now - start).count());
+    peak_rss = std::max(peak_rss, get_process_stats(pid).rss_kb);
+    last = now;
+    if (!options.pid && !daemon.running()) {
+      std::cerr << "daemon terminated" << std::endl;
+      break;
+    }
+  }
+  auto elapsed = duration<double>(steady_clock::now() - start).count();
+
+  /* stop the clients, the mutators remove their streams */
+  g_running = false;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  /* let the daemon close the connections and send the SAP deletions */
+  std::this_thread::sleep_for(seconds(5));
+  auto end_stats = get_process_stats(pid);
+  report(pid, duration<double>(steady_clock::now() - last).count(),
+         duration<double>(steady_clock::now() - start).count());
+
+  uint64_t errors = 0;
+  std::cout << "summary after " << std::fixed << std::setprecision(0)
+            << elapsed << " s" << std::endl;
+  print_header(std::cout);
+  for (size_t i = 0; i < g_stats.size(); i++) {
+    print_stats(std::cout, op_names[i], g_stats[i].total,
+                g_stats[i].total_errors, elapsed);
+    errors += g_stats[i].total_errors;
+  }
+  int leaked_threads = end_stats.threads - baseline.threads;
+  int leaked_sockets = end_stats.sockets - baseline.sockets;
+  int leaked_fds = end_stats.fds - baseline.fds;
+  std::cout << "  daemon rss baseline " << baseline.rss_kb << " kB, peak "
+            << peak_rss << " kB, final " << end_stats.rss_kb << " kB, growth "
+            << static_cast<int64_t>(end_stats.rss_kb - baseline.rss_kb) << " kB"
+            << std::endl;
+  std::cout << "  leaked threads " << leaked_threads << ", sockets "
+            << leaked_sockets << ", fds " << leaked_fds << std::endl;
+
+  bool ok = !errors && leaked_threads <= 0 && leaked_sockets <= 0 &&
+            leaked_fds <= 0;
+  if (!options.pid && !daemon.stop()) {
+    ok = false;
+  }
+  std::cout << (ok ? "PASSED" : "FAILED") << std::endl;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,846 @@
+//
+//  userspace_driver.cpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/timex.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "log.hpp"
+#include "userspace_driver.hpp"
+
+constexpr static uint64_t ns_per_sec = 1000000000ULL;
+constexpr static uint32_t rtp_header_len = 12;
+
+static uint32_t get_codec_bytes_per_sample(const char* codec) {
+  if (!strcmp(codec, "L16"))
+    return 2;
+  if (!strcmp(codec, "L24"))
+    return 3;
+  if (!strcmp(codec, "AM824"))
+    return 4; /* AM824 words are transported unchanged */
+  return 0;
+}
+
+static bool is_valid_sample_rate(uint32_t rate) {
+  return rate == 44100 || rate == 48000 || rate == 88200 || rate == 96000 ||
+         rate == 176400 || rate == 192000;
+}
+
+UserspaceDriver::Source::~Source() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+UserspaceDriver::Sink::~Sink() {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+uint64_t UserspaceDriver::get_tai_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_TAI, &ts);
+  return ts.tv_sec * ns_per_sec + ts.tv_nsec;
+}
+
+uint64_t UserspaceDriver::get_frame(uint64_t ns, uint32_t rate) {
+  return (ns / ns_per_sec) * rate + (ns % ns_per_sec) * rate / ns_per_sec;
+}
+
+uint64_t UserspaceDriver::get_ns(uint64_t frame, uint32_t rate) {
+  return (frame / rate) * ns_per_sec +
+         ((frame % rate) * ns_per_sec + rate - 1) / rate;
+}
+
+bool UserspaceDriver::init(const Config& config) {
+  if (running_) {
+    return true;
+  }
+
+  interface_name_ = config.get_interface_name();
+  ip_addr_ = config.get_ip_addr();
+  channels_ = config.get_driver_channels();
+  sample_rate_ = config.get_sample_rate();
+  playback_path_ = config.get_driver_playback_path();
+  capture_path_ = config.get_driver_capture_path();
+
+  playback_ring_.assign(playback_ring_frames * channels_, 0);
+  playback_partial_.clear();
+  capture_pending_.clear();
+  send_buffer_.resize(max_packets_per_batch * max_packet_size);
+
+  if (!playback_path_.empty()) {
+    /* a FIFO can be opened for reading before the writer connects */
+    playback_fd_ =
+        ::open(playback_path_.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (playback_fd_ < 0) {
+      BOOST_LOG_TRIVIAL(fatal) << "userspace_driver:: cannot open playback "
+                               << playback_path_ << " : " << strerror(errno);
+      return false;
+    }
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "userspace_driver:: starting with "
+                          << channels_ << " channels, playback "
+                          << (playback_path_.empty() ? "none" : playback_path_)
+                          << ", capture "
+                          << (capture_path_.empty() ? "none" : capture_path_);
+  running_ = true;
+  tic_res_ = std::async(std::launch::async, &UserspaceDriver::tic_loop, this);
+  receive_res_ =
+      std::async(std::launch::async, &UserspaceDriver::receive_loop, this);
+  return true;
+}
+
+bool UserspaceDriver::terminate() {
+  if (running_) {
+    running_ = false;
+    bool res = tic_res_.get();
+    res = receive_res_.get() && res;
+    sources_.clear();
+    sinks_.clear();
+    if (playback_fd_ >= 0) {
+      ::close(playback_fd_);
+      playback_fd_ = -1;
+    }
+    if (capture_fd_ >= 0) {
+      ::close(capture_fd_);
+      capture_fd_ = -1;
+    }
+    BOOST_LOG_TRIVIAL(info) << "userspace_driver:: stopped";
+    return res;
+  }
+  return true;
+}
+
+template <typename T>
+static bool get_value(size_t req_size, const uint8_t* req, T& value) {
+  if (req_size != sizeof(T) || req == nullptr) {
+    return false;
+  }
+  memcpy(&value, req, sizeof(T));
+  return true;
+}
+
+template <typename T>
+static void set_value(size_t& resp_size, uint8_t* resp, const T& value) {
+  memcpy(resp, &value, sizeof(T));
+  resp_size = sizeof(T);
+}
+
+std::error_code UserspaceDriver::command(enum MT_ALSA_msg_id id,
+                                         size_t req_size,
+                                         const uint8_t* req,
+                                         size_t& resp_size,
+                                         uint8_t* resp) {
+  resp_size = 0;
+  switch (id) {
+    case MT_ALSA_Msg_Hello:
+    case MT_ALSA_Msg_Bye:
+    case MT_ALSA_Msg_Ping:
+    case MT_ALSA_Msg_Start:
+    case MT_ALSA_Msg_Stop:
+    case MT_ALSA_Msg_Reset:
+      return {};
+    case MT_ALSA_Msg_SetInterfaceName: {
+      if (!req_size || req == nullptr) {
+        return DriverErrc::invalid_data_size;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      interface_name_.assign(reinterpret_cast<const char*>(req),
+                             strnlen(reinterpret_cast<const char*>(req),
+                                     req_size));
+      return {};
+    }
+    case MT_ALSA_Msg_SetPTPConfig: {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!get_value(req_size, req, ptp_config_)) {
+        return DriverErrc::invalid_data_size;
+      }
+      return {};
+    }
+    case MT_ALSA_Msg_GetPTPConfig: {
+      std::lock_guard<std::mutex> lock(mutex_);
+      set_value(resp_size, resp, ptp_config_);
+      return {};
+    }
+    case MT_ALSA_Msg_GetPTPStatus: {
+      TPTPStatus status;
+      auto ret = get_ptp_status(status);
+      if (!ret) {
+        set_value(resp_size, resp, status);
+      }
+      return ret;
+    }
+    case MT_ALSA_Msg_SetSampleRate: {
+      uint32_t rate;
+      if (!get_value(req_size, req, rate)) {
+        return DriverErrc::invalid_data_size;
+      }
+      if (!is_valid_sample_rate(rate)) {
+        return DriverErrc::invalid_value;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      sample_rate_ = rate;
+      return {};
+    }
+    case MT_ALSA_Msg_GetSampleRate: {
+      std::lock_guard<std::mutex> lock(mutex_);
+      set_value(resp_size, resp, sample_rate_);
+      return {};
+    }
+    case MT_ALSA_Msg_SetTICFrameSizeAt1FS: {
+      uint64_t frame_size;
+      if (!get_value(req_size, req, frame_size)) {
+        return DriverErrc::invalid_data_size;
+      }
+      if (!frame_size) {
+        return DriverErrc::invalid_value;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      tic_frame_size_at_1fs_ = frame_size;
+      return {};
+    }
+    case MT_ALSA_Msg_SetMaxTICFrameSize: {
+      uint64_t frame_size;
+      if (!get_value(req_size, req, frame_size)) {
+        return DriverErrc::invalid_data_size;
+      }
+      if (!frame_size) {
+        return DriverErrc::invalid_value;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      max_tic_frame_size_ = frame_size;
+      return {};
+    }
+    case MT_ALSA_Msg_SetPlayoutDelay: {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!get_value(req_size, req, playout_delay_)) {
+        return DriverErrc::invalid_data_size;
+      }
+      return {};
+    }
+    case MT_ALSA_Msg_GetNumberOfInputs:
+    case MT_ALSA_Msg_GetNumberOfOutputs: {
+      int32_t channels = channels_;
+      set_value(resp_size, resp, channels);
+      return {};
+    }
+    case MT_ALSA_Msg_Add_RTPStream: {
+      TRTP_stream_info info;
+      if (!get_value(req_size, req, info)) {
+        return DriverErrc::invalid_data_size;
+      }
+      uint64_t handle;
+      auto ret = add_stream(info, handle);
+      if (!ret) {
+        set_value(resp_size, resp, handle);
+      }
+      return ret;
+    }
+    case MT_ALSA_Msg_Remove_RTPStream: {
+      uint64_t handle;
+      if (!get_value(req_size, req, handle)) {
+        return DriverErrc::invalid_data_size;
+      }
+      return remove_stream(handle);
+    }
+    case MT_ALSA_Msg_GetRTPStreamStatus: {
+      uint64_t handle;
+      if (!get_value(req_size, req, handle)) {
+        return DriverErrc::invalid_data_size;
+      }
+      TRTP_stream_status status;
+      auto ret = get_stream_status(handle, status);
+      if (!ret) {
+        set_value(resp_size, resp, status);
+      }
+      return ret;
+    }
+    default:
+      return DriverErrc::unknown_command;
+  }
+}
+
+std::error_code UserspaceDriver::get_ptp_status(TPTPStatus& status) const {
+  /* the system clock is locked when phc2sys or NTP marked it synchronized */
+  struct timex tx;
+  memset(&tx, 0, sizeof(tx));
+  int state = adjtimex(&tx);
+  memset(&status, 0, sizeof(status));
+  status.nPTPLockStatus =
+      (state < 0 || state == TIME_ERROR || (tx.status & STA_UNSYNC))
+          ? PTPLS_UNLOCKED
+          : PTPLS_LOCKED;
+  return {};
+}
+
+int UserspaceDriver::open_source_socket(const TRTP_stream_info& info) const {
+  int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(info.m_ui32SrcIP);
+  addr.sin_port = htons(info.m_usSrcPort);
+  if (::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+    BOOST_LOG_TRIVIAL(warning)
+        << "userspace_driver:: cannot bind source to port "
+        << info.m_usSrcPort << " : " << strerror(errno);
+  }
+
+  struct in_addr if_addr;
+  if_addr.s_addr = htonl(ip_addr_);
+  int ttl = info.m_byTTL;
+  int tos = info.m_ucDSCP << 2;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &if_addr, sizeof(if_addr));
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &on, sizeof(on));
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+  setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+
+  addr.sin_addr.s_addr = htonl(info.m_ui32DestIP);
+  addr.sin_port = htons(info.m_usDestPort);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int UserspaceDriver::open_sink_socket(const TRTP_stream_info& info) const {
+  int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  int rcvbuf = 1 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  bool mcast = IN_MULTICAST(info.m_ui32DestIP);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(mcast ? info.m_ui32DestIP : INADDR_ANY);
+  addr.sin_port = htons(info.m_usDestPort);
+  if (::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr))) {
+    ::close(fd);
+    return -1;
+  }
+
+  if (mcast) {
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = htonl(info.m_ui32DestIP);
+    mreq.imr_interface.s_addr = htonl(ip_addr_);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) {
+      ::close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+std::error_code UserspaceDriver::add_stream(const TRTP_stream_info& info,
+                                            uint64_t& handle) {
+  uint32_t bytes_per_sample = get_codec_bytes_per_sample(info.m_cCodec);
+  if (!bytes_per_sample) {
+    BOOST_LOG_TRIVIAL(error) << "userspace_driver:: unsupported codec "
+                             << info.m_cCodec;
+    return DriverErrc::invalid_value;
+  }
+  if (!info.m_byNbOfChannels ||
+      info.m_byNbOfChannels > MAX_CHANNELS_BY_RTP_STREAM) {
+    return DriverErrc::invalid_value;
+  }
+  for (int ch = 0; ch < info.m_byNbOfChannels; ch++) {
+    if (info.m_aui32Routing[ch] >= channels_) {
+      BOOST_LOG_TRIVIAL(error) << "userspace_driver:: channel "
+                               << info.m_aui32Routing[ch] << " out of range";
+      return DriverErrc::invalid_value;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (info.m_ui32SamplingRate != sample_rate_) {
+    BOOST_LOG_TRIVIAL(error)
+        << "userspace_driver:: stream sample rate " << info.m_ui32SamplingRate
+        << " differs from driver sample rate " << sample_rate_;
+    return DriverErrc::invalid_value;
+  }
+  uint32_t frames = info.m_ui32MaxSamplesPerPacket;
+  uint32_t frame_bytes = info.m_byNbOfChannels * bytes_per_sample;
+
+  if (info.m_bSource) {
+    if (!frames || rtp_header_len + frames * frame_bytes > max_packet_size) {
+      BOOST_LOG_TRIVIAL(error) << "userspace_driver:: invalid packet size of "
+                               << frames << " samples";
+      return DriverErrc::invalid_value;
+    }
+    auto source = std::make_shared<Source>();
+    source->info = info;
+    source->bytes_per_sample = bytes_per_sample;
+    source->seq = static_cast<uint16_t>(rand());
+    source->fd = open_source_socket(info);
+    if (source->fd < 0) {
+      BOOST_LOG_TRIVIAL(error) << "userspace_driver:: cannot open source "
+                               << info.m_cName << " : " << strerror(errno);
+      return DriverErrc::command_failed;
+    }
+    handle = next_handle_++;
+    sources_[handle] = source;
+  } else {
+    auto sink = std::make_shared<Sink>();
+    sink->info = info;
+    sink->bytes_per_sample = bytes_per_sample;
+    sink->delay = info.m_ui32PlayOutDelay + std::max(playout_delay_, 0);
+    /* hold the delay plus the largest packet and tic, twice */
+    uint64_t needed = 2 * (static_cast<uint64_t>(sink->delay) +
+                           std::max(frames, info.m_ui32FrameSize) +
+                           4 * max_tic_frame_size_);
+    sink->ring_frames = min_jitter_buffer_frames;
+    while (sink->ring_frames < needed && sink->ring_frames < (1U << 20)) {
+      sink->ring_frames <<= 1;
+    }
+    if (sink->ring_frames < needed) {
+      BOOST_LOG_TRIVIAL(error) << "userspace_driver:: sink delay "
+                               << sink->delay << " too large";
+      return DriverErrc::invalid_value;
+    }
+    sink->ring.assign(
+        static_cast<size_t>(sink->ring_frames) * info.m_byNbOfChannels, 0);
+    sink->ring_ts.assign(sink->ring_frames, 0);
+    sink->ring_valid.assign(sink->ring_frames, 0);
+    sink->fd = open_sink_socket(info);
+    if (sink->fd < 0) {
+      BOOST_LOG_TRIVIAL(error) << "userspace_driver:: cannot open sink "
+                               << info.m_cName << " : " << strerror(errno);
+      return DriverErrc::command_failed;
+    }
+    handle = next_handle_++;
+    sinks_[handle] = sink;
+  }
+
+  BOOST_LOG_TRIVIAL(info) << "userspace_driver:: added "
+                          << (info.m_bSource ? "source " : "sink ")
+                          << info.m_cName << " handle " << handle;
+  return {};
+}
+
+std::error_code UserspaceDriver::remove_stream(uint64_t handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  /* a sink in use by the receive thread is closed when released */
+  if (!sources_.erase(handle) && !sinks_.erase(handle)) {
+    return DriverErrc::invalid_value;
+  }
+  BOOST_LOG_TRIVIAL(info) << "userspace_driver:: removed handle " << handle;
+  return {};
+}
+
+std::error_code UserspaceDriver::get_stream_status(
+    uint64_t handle,
+    TRTP_stream_status& status) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  memset(&status, 0, sizeof(status));
+  if (sources_.find(handle) != sources_.end()) {
+    return {};
+  }
+  auto it = sinks_.find(handle);
+  if (it == sinks_.end()) {
+    return DriverErrc::invalid_value;
+  }
+
+  auto& sink = *it->second;
+  uint64_t now_ns = get_tai_ns();
+  bool receiving =
+      sink.last_packet_ns &&
+      now_ns - sink.last_packet_ns < receiving_timeout_ms * 1000000ULL;
+  status.u.flags =
+      sink.flags | (receiving ? 0x10 : 0) | (sink.muted ? 0x20 : 0);
+  status.sink_min_time = sink.min_time_valid ? sink.min_time : 0;
+  sink.flags = 0;
+  sink.min_time_valid = false;
+  return {};
+}
+
+uint32_t UserspaceDriver::tic_frames() const {
+  uint64_t mult = sample_rate_ >= 176400 ? 4 : (sample_rate_ >= 88200 ? 2 : 1);
+  uint64_t frames = std::min(tic_frame_size_at_1fs_ * mult,
+                             std::max(max_tic_frame_size_, mult));
+  return static_cast<uint32_t>(std::max<uint64_t>(frames, 1));
+}
+
+void UserspaceDriver::read_playback(uint64_t first, uint32_t frames) {
+  size_t frame_bytes = channels_ * sizeof(int32_t);
+  size_t have = playback_partial_.size();
+  size_t wanted = frames * frame_bytes;
+  if (playback_fd_ >= 0 && have < wanted) {
+    playback_partial_.resize(wanted);
+    ssize_t ret =
+        ::read(playback_fd_, playback_partial_.data() + have, wanted - have);
+    if (ret > 0) {
+      have += ret;
+    }
+  }
+
+  /* frames not available yet are played as silence */
+  size_t whole = std::min(have / frame_bytes, static_cast<size_t>(frames));
+  for (uint32_t n = 0; n < frames; n++) {
+    int32_t* dst = &playback_ring_[((first + n) % playback_ring_frames) *
+                                   channels_];
+    if (n < whole) {
+      memcpy(dst, playback_partial_.data() + n * frame_bytes, frame_bytes);
+    } else {
+      memset(dst, 0, frame_bytes);
+    }
+  }
+  playback_partial_.erase(playback_partial_.begin(),
+                          playback_partial_.begin() + whole * frame_bytes);
+  playback_partial_.resize(have - whole * frame_bytes);
+}
+
+void UserspaceDriver::write_capture(uint32_t frames) {
+  if (capture_path_.empty()) {
+    return;
+  }
+  if (capture_fd_ < 0) {
+    /* a FIFO cannot be opened for writing until a reader connects */
+    uint64_t now_ns = get_tai_ns();
+    if (now_ns < capture_retry_ns_) {
+      return;
+    }
+    capture_fd_ = ::open(capture_path_.c_str(),
+                         O_WRONLY | O_NONBLOCK | O_CREAT | O_TRUNC | O_CLOEXEC,
+                         0644);
+    if (capture_fd_ < 0) {
+      capture_retry_ns_ = now_ns + ns_per_sec;
+      return;
+    }
+    BOOST_LOG_TRIVIAL(info) << "userspace_driver:: capture to "
+                            << capture_path_;
+    capture_pending_.clear();
+  }
+
+  size_t bytes = frames * channels_ * sizeof(int32_t);
+  size_t max_pending =
+      max_pending_capture_secs * sample_rate_ * channels_ * sizeof(int32_t);
+  if (capture_pending_.size() + bytes <= max_pending) {
+    auto data = reinterpret_cast<const uint8_t*>(capture_frames_.data());
+    capture_pending_.insert(capture_pending_.end(), data, data + bytes);
+  } /* else the reader is too slow, drop this tic */
+
+  ssize_t ret =
+      ::write(capture_fd_, capture_pending_.data(), capture_pending_.size());
+  if (ret > 0) {
+    capture_pending_.erase(capture_pending_.begin(),
+                           capture_pending_.begin() + ret);
+  } else if (ret < 0 && errno != EAGAIN) {
+    BOOST_LOG_TRIVIAL(warning) << "userspace_driver:: capture write failed : "
+                               << strerror(errno);
+    ::close(capture_fd_);
+    capture_fd_ = -1;
+    capture_retry_ns_ = get_tai_ns() + ns_per_sec;
+  }
+}
+
+void UserspaceDriver::send_source(Source& source,
+                                  uint64_t start,
+                                  uint64_t end) {
+  const auto& info = source.info;
+  uint32_t frames = info.m_ui32MaxSamplesPerPacket;
+  /* first tic or the source fell behind the playback ring */
+  if (!source.next_frame || source.next_frame > end ||
+      source.next_frame + playback_ring_frames / 2 < end) {
+    source.next_frame = start;
+  }
+
+  struct mmsghdr msgs[max_packets_per_batch];
+  struct iovec iovs[max_packets_per_batch];
+  size_t packet_size = rtp_header_len +
+      frames * info.m_byNbOfChannels * source.bytes_per_sample;
+  while (source.next_frame + frames <= end) {
+    uint32_t count = 0;
+    for (; count < max_packets_per_batch && source.next_frame + frames <= end;
+         count++) {
+      uint8_t* packet = send_buffer_.data() + count * max_packet_size;
+      uint32_t ts =
+          static_cast<uint32_t>(source.next_frame) + info.m_ui32RTPTimestampOffset;
+      uint32_t ssrc = info.m_ui32SSRC;
+      packet[0] = 0x80; /* version 2 */
+      packet[1] = info.m_byPayloadType & 0x7f;
+      packet[2] = source.seq >> 8;
+      packet[3] = source.seq & 0xff;
+      for (int i = 0; i < 4; i++) {
+        packet[4 + i] = ts >> (24 - 8 * i);
+        packet[8 + i] = ssrc >> (24 - 8 * i);
+      }
+      uint8_t* p = packet + rtp_header_len;
+      for (uint32_t n = 0; n < frames; n++) {
+        const int32_t* frame =
+            &playback_ring_[((source.next_frame + n) % playback_ring_frames) *
+                            channels_];
+        for (int ch = 0; ch < info.m_byNbOfChannels; ch++) {
+          uint32_t sample = frame[info.m_aui32Routing[ch]];
+          for (uint32_t b = 0; b < source.bytes_per_sample; b++) {
+            *p++ = sample >> (24 - 8 * b);
+          }
+        }
+      }
+      iovs[count].iov_base = packet;
+      iovs[count].iov_len = packet_size;
+      memset(&msgs[count], 0, sizeof(msgs[count]));
+      msgs[count].msg_hdr.msg_iov = &iovs[count];
+      msgs[count].msg_hdr.msg_iovlen = 1;
+      source.seq++;
+      source.next_frame += frames;
+    }
+    /* packets not sent are lost as they would be on the wire */
+    if (sendmmsg(source.fd, msgs, count, MSG_DONTWAIT) < 0 &&
+        errno != EAGAIN) {
+      BOOST_LOG_TRIVIAL(debug) << "userspace_driver:: send failed : "
+                               << strerror(errno);
+    }
+  }
+}
+
+void UserspaceDriver::play_sink(Sink& sink, uint64_t start, uint32_t frames) {
+  const auto& info = sink.info;
+  bool audio = false;
+  for (uint32_t n = 0; n < frames; n++) {
+    uint32_t ts = static_cast<uint32_t>(start + n - sink.delay) +
+                  info.m_ui32RTPTimestampOffset;
+    uint32_t idx = ts & (sink.ring_frames - 1);
+    if (!sink.ring_valid[idx] || sink.ring_ts[idx] != ts) {
+      continue;
+    }
+    audio = true;
+    const int32_t* src = &sink.ring[idx * info.m_byNbOfChannels];
+    int32_t* dst = &capture_frames_[n * channels_];
+    for (int ch = 0; ch < info.m_byNbOfChannels; ch++) {
+      dst[info.m_aui32Routing[ch]] = src[ch];
+    }
+  }
+  sink.muted = !audio;
+}
+
+bool UserspaceDriver::tic_loop() {
+  /* a capture FIFO without reader fails the write instead of SIGPIPE */
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+  uint32_t rate = 0;
+  uint64_t start = 0;
+  while (running_) {
+    uint32_t frames;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      frames = tic_frames();
+      if (rate != sample_rate_) {
+        rate = sample_rate_;
+        start = 0;
+      }
+    }
+
+    uint64_t now = get_frame(get_tai_ns(), rate);
+    if (!start || now + frames < start || now > start + 8 * frames) {
+      /* first tic, sample rate or clock changed or too late: resync */
+      if (start) {
+        BOOST_LOG_TRIVIAL(warning)
+            << "userspace_driver:: media clock resync at frame " << now;
+      }
+      start = now - now % frames;
+    }
+
+    uint64_t end = start + frames;
+    uint64_t wake_ns = get_ns(end, rate);
+    struct timespec ts;
+    ts.tv_sec = wake_ns / ns_per_sec;
+    ts.tv_nsec = wake_ns % ns_per_sec;
+    while (clock_nanosleep(CLOCK_TAI, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+
+    read_playback(start, frames);
+    capture_frames_.assign(frames * channels_, 0);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& [handle, source] : sources_) {
+        send_source(*source, start, end);
+      }
+      for (auto& [handle, sink] : sinks_) {
+        play_sink(*sink, start, frames);
+      }
+    }
+    write_capture(frames);
+    start = end;
+  }
+  return true;
+}
+
+void UserspaceDriver::receive_packets(Sink& sink,
+                                      struct mmsghdr* msgs,
+                                      int count,
+                                      uint64_t now_ns) {
+  const auto& info = sink.info;
+  uint32_t frame_bytes = info.m_byNbOfChannels * sink.bytes_per_sample;
+  uint32_t arrival_ts =
+      static_cast<uint32_t>(get_frame(now_ns, info.m_ui32SamplingRate)) +
+      info.m_ui32RTPTimestampOffset;
+
+  for (int i = 0; i < count; i++) {
+    const uint8_t* packet =
+        static_cast<const uint8_t*>(msgs[i].msg_hdr.msg_iov->iov_base);
+    size_t len = msgs[i].msg_len;
+    if (len < rtp_header_len || (packet[0] >> 6) != 2) {
+      continue;
+    }
+    size_t header = rtp_header_len + 4 * (packet[0] & 0x0f); /* CSRC */
+    if ((packet[0] & 0x10) && header + 4 <= len) {           /* extension */
+      header += 4 + 4 * ((packet[header + 2] << 8) | packet[header + 3]);
+    }
+    if ((packet[0] & 0x20) && len > header) { /* padding */
+      len -= std::min<size_t>(packet[len - 1], len - header);
+    }
+    if (header > len) {
+      continue;
+    }
+
+    uint8_t payload_type = packet[1] & 0x7f;
+    uint16_t seq = (packet[2] << 8) | packet[3];
+    uint32_t ts = 0, ssrc = 0;
+    for (int b = 0; b < 4; b++) {
+      ts = (ts << 8) | packet[4 + b];
+      ssrc = (ssrc << 8) | packet[8 + b];
+    }
+
+    if (payload_type != info.m_byPayloadType) {
+      sink.flags |= 0x04;
+      continue;
+    }
+    if (!sink.ssrc_locked) {
+      sink.ssrc_locked = true;
+      sink.ssrc = ssrc;
+    } else if (ssrc != sink.ssrc) {
+      sink.flags |= 0x02;
+      continue;
+    } else if (seq != static_cast<uint16_t>(sink.last_seq + 1)) {
+      sink.flags |= 0x01;
+    }
+    sink.last_seq = seq;
+
+    size_t payload = len - header;
+    uint32_t frames = payload / frame_bytes;
+    if (payload % frame_bytes || !frames) {
+      sink.flags |= 0x08;
+    }
+    sink.last_packet_ns = now_ns;
+
+    /* samples left before playout, negative if the packet is late */
+    int32_t min_time = static_cast<int32_t>(ts + sink.delay - arrival_ts);
+    if (!sink.min_time_valid || min_time < sink.min_time) {
+      sink.min_time = min_time;
+      sink.min_time_valid = true;
+    }
+
+    const uint8_t* p = packet + header;
+    for (uint32_t n = 0; n < frames; n++) {
+      uint32_t frame_ts = ts + n;
+      uint32_t idx = frame_ts & (sink.ring_frames - 1);
+      int32_t* dst = &sink.ring[idx * info.m_byNbOfChannels];
+      for (int ch = 0; ch < info.m_byNbOfChannels; ch++) {
+        uint32_t sample = 0;
+        for (uint32_t b = 0; b < sink.bytes_per_sample; b++) {
+          sample |= static_cast<uint32_t>(*p++) << (24 - 8 * b);
+        }
+        dst[ch] = static_cast<int32_t>(sample);
+      }
+      sink.ring_ts[idx] = frame_ts;
+      sink.ring_valid[idx] = 1;
+    }
+  }
+}
+
+bool UserspaceDriver::receive_loop() {
+  std::vector<uint8_t> buffer(max_packets_per_batch * max_packet_size);
+  struct mmsghdr msgs[max_packets_per_batch];
+  struct iovec iovs[max_packets_per_batch];
+  memset(msgs, 0, sizeof(msgs));
+  for (uint32_t i = 0; i < max_packets_per_batch; i++) {
+    iovs[i].iov_base = buffer.data() + i * max_packet_size;
+    iovs[i].iov_len = max_packet_size;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  std::vector<std::shared_ptr<Sink> > sinks;
+  std::vector<struct pollfd> fds;
+  while (running_) {
+    sinks.clear();
+    fds.clear();
+    {
+      /* keep the sinks alive while their sockets are polled */
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& [handle, sink] : sinks_) {
+        sinks.push_back(sink);
+        fds.push_back({sink->fd, POLLIN, 0});
+      }
+    }
+    if (fds.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      continue;
+    }
+
+    if (poll(fds.data(), fds.size(), 20) <= 0) {
+      continue;
+    }
+    for (size_t i = 0; i < fds.size(); i++) {
+      if (!(fds[i].revents & POLLIN)) {
+        continue;
+      }
+      int count;
+      do {
+        count = recvmmsg(fds[i].fd, msgs, max_packets_per_batch, MSG_DONTWAIT,
+                         nullptr);
+        if (count > 0) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          receive_packets(*sinks[i], msgs, count, get_tai_ns());
+        }
+      } while (count == static_cast<int>(max_packets_per_batch));
+    }
+  }
+  return true;
+}
@@ -0,0 +1,158 @@
+//
+//  userspace_driver.hpp
+//
+//  Copyright (c) 2019 2020 Andrea Bondavalli. All rights reserved.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _USERSPACE_DRIVER_HPP_
+#define _USERSPACE_DRIVER_HPP_
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MT_ALSA_message_defs.h"
+#include "RTP_stream_info.h"
+#include "audio_streamer_clock_PTP_defs.h"
+#include "config.hpp"
+#include "error_code.hpp"
+
+/*
+ * AES67 RTP data plane running in the daemon process.
+ * It executes the same commands the kernel module receives via netlink and
+ * sends and receives the RTP streams with sendmmsg/recvmmsg.
+ * The media clock is the system CLOCK_TAI, disciplined to PTP by ptp4l and
+ * phc2sys. The audio endpoints are a playback file or FIFO read by the
+ * sources and a capture file or FIFO written by the sinks, both interleaved
+ * S32_LE with the configured number of channels.
+ */
+class UserspaceDriver {
+ public:
+  constexpr static uint32_t max_packets_per_batch = 32;
+  constexpr static uint32_t max_packet_size = 1500;
+  constexpr static uint32_t playback_ring_frames = 8192;
+  constexpr static uint32_t min_jitter_buffer_frames = 4096;
+  constexpr static uint32_t receiving_timeout_ms = 200;
+  constexpr static size_t max_pending_capture_secs = 1;
+
+  UserspaceDriver() = default;
+  UserspaceDriver(const UserspaceDriver&) = delete;
+  UserspaceDriver& operator=(const UserspaceDriver&) = delete;
+  ~UserspaceDriver() { terminate(); };
+
+  bool init(const Config& config);
+  bool terminate();
+
+  /* execute a driver command, response data is copied to resp */
+  std::error_code command(enum MT_ALSA_msg_id id,
+                          size_t req_size,
+                          const uint8_t* req,
+                          size_t& resp_size,
+                          uint8_t* resp);
+
+ private:
+  struct Source {
+    ~Source();
+
+    TRTP_stream_info info;
+    int fd{-1};
+    uint16_t seq{0};
+    uint64_t next_frame{0}; /* first frame of the next packet */
+    uint32_t bytes_per_sample{0};
+  };
+
+  struct Sink {
+    ~Sink();
+
+    TRTP_stream_info info;
+    int fd{-1};
+    uint32_t bytes_per_sample{0};
+    uint32_t delay{0}; /* sink plus global playout delay */
+    /* jitter buffer indexed by RTP timestamp */
+    uint32_t ring_frames{0};
+    std::vector<int32_t> ring;
+    std::vector<uint32_t> ring_ts;
+    std::vector<uint8_t> ring_valid;
+    /* status, reset when read */
+    bool ssrc_locked{false};
+    uint32_t ssrc{0};
+    uint16_t last_seq{0};
+    uint32_t flags{0};
+    int32_t min_time{0};
+    bool min_time_valid{false};
+    uint64_t last_packet_ns{0};
+    bool muted{true};
+  };
+
+  std::error_code add_stream(const TRTP_stream_info& info, uint64_t& handle);
+  std::error_code remove_stream(uint64_t handle);
+  std::error_code get_stream_status(uint64_t handle,
+                                    TRTP_stream_status& status);
+  std::error_code get_ptp_status(TPTPStatus& status) const;
+
+  int open_source_socket(const TRTP_stream_info& info) const;
+  int open_sink_socket(const TRTP_stream_info& info) const;
+  uint32_t tic_frames() const;
+  static uint64_t get_frame(uint64_t ns, uint32_t rate);
+  static uint64_t get_ns(uint64_t frame, uint32_t rate);
+  static uint64_t get_tai_ns();
+
+  bool tic_loop();
+  bool receive_loop();
+  void read_playback(uint64_t first, uint32_t frames);
+  void write_capture(uint32_t frames);
+  void send_source(Source& source, uint64_t start, uint64_t end);
+  void play_sink(Sink& sink, uint64_t start, uint32_t frames);
+  void receive_packets(Sink& sink,
+                       struct mmsghdr* msgs,
+                       int count,
+                       uint64_t now_ns);
+
+  std::atomic_bool running_{false};
+  std::future<bool> tic_res_;
+  std::future<bool> receive_res_;
+  std::mutex mutex_; /* streams, settings and status */
+
+  std::string interface_name_;
+  uint32_t ip_addr_{0};
+  uint32_t channels_{8};
+  uint32_t sample_rate_{48000};
+  uint64_t tic_frame_size_at_1fs_{192};
+  uint64_t max_tic_frame_size_{1024};
+  int32_t playout_delay_{0};
+  TPTPConfig ptp_config_{0, 46};
+
+  uint64_t next_handle_{1};
+  std::map<uint64_t, std::shared_ptr<Source> > sources_;
+  std::map<uint64_t, std::shared_ptr<Sink> > sinks_;
+
+  /* audio endpoints */
+  std::string playback_path_;
+  std::string capture_path_;
+  int playback_fd_{-1};
+  int capture_fd_{-1};
+  std::vector<uint8_t> send_buffer_;
+  std::vector<int32_t> playback_ring_;
+  std::vector<uint8_t> playback_partial_;
+  std::vector<int32_t> capture_frames_;
+  std::vector<uint8_t> capture_pending_;
+  uint64_t capture_retry_ns_{0};
+};
+
+#endif
@@ -23,19 +23,6 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 
-uint16_t crc16(const uint8_t* p, size_t len) {
-  uint8_t x;
-  uint16_t crc = 0xFFFF;
-
-  while (len--) {
-    x = crc >> 8 ^ *p++;
-    x ^= x >> 4;
-    crc = (crc << 8) ^ (static_cast<uint16_t>(x << 12)) ^
-          (static_cast<uint16_t>(x << 5)) ^ (static_cast<uint16_t>(x));
-  }
-  return crc;
-}
-
 std::tuple<bool /* res */,
            std::string /* protocol */,
            std::string /* host */,
@@ -97,3 +84,32 @@ std::string sdp_get_subject(const std::string& sdp) {
   }
   return "";
 }
+
+std::tuple<bool /* res */,
+           std::string /* username */,
+           std::string /* session id */,
+           uint64_t /* session version */,
+           std::string /* address */>
+sdp_get_origin(const std::string& sdp) {
+  std::stringstream ss(sdp);
+  std::string line;
+  while (getline(ss, line, '\n')) {
+    if (line.substr(0, 2) == "o=") {
+      std::vector<std::string> fields;
+      auto origin = line.substr(2);
+      boost::trim(origin);
+      boost::split(fields, origin, boost::is_any_of(" "),
+                   boost::token_compress_on);
+      if (fields.size() != 6) {
+        break;
+      }
+      uint64_t version = 0;
+      try {
+        version = std::stoull(fields[2]);
+      } catch (...) {
+      }
+      return {true, fields[0], fields[1], version, fields[5]};
+    }
+  }
+  return {false, "", "", 0, ""};
+}
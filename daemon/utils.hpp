@@ -25,8 +25,6 @@
 #include <cstddef>
 #include <iostream>
 
-uint16_t crc16(const uint8_t* p, size_t len);
-
 std::tuple<bool /* res */,
            std::string /* protocol */,
            std::string /* host */,
@@ -38,4 +36,12 @@ std::string get_node_id(uint32_t ip_addr);
 
 std::string sdp_get_subject(const std::string& sdp);
 
+/* o=<username> <sess-id> <sess-version> <nettype> <addrtype> <address> */
+std::tuple<bool /* res */,
+           std::string /* username */,
+           std::string /* session id */,
+           uint64_t /* session version */,
+           std::string /* address */>
+sdp_get_origin(const std::string& sdp);
+
 #endif
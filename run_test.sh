@@ -42,12 +42,13 @@ cd test
 echo 'Compiling tools ...' >&2
 make
 echo 'Creating test file ...' >&2
-if ! ./createtest $1 $2 $3 $4 ; then
-  echo 'Usage run_test.sh sample_format sample_rate channels duration' >&2
+if ! ./createtest $1 $2 $3 $4 $5 ; then
+  echo 'Usage run_test.sh sample_format sample_rate channels duration [pattern]' >&2
   echo '  sample_format can be one of S16_LE, S24_3LE, S32_LE' >&2
   echo '  sample_rate can be one of 44100, 48000, 96000' >&2
-  echo '  channels can be one of 1, 2, 4' >&2
+  echo '  channels is in the range 1 to 64' >&2
   echo '  duration is in the range 1 to 10 minutes' >&2
+  echo '  pattern can be one of bytes (default), counter' >&2
   exit 1
 else
   echo 'test file created' >&2
@@ -58,6 +59,7 @@ SAMPLE_FORMAT=$1
 SAMPLE_RATE=$2
 CHANNELS=$3
 DURATION=$4
+PATTERN=${5:-bytes}
 SEC=$((DURATION*60))
 
 if [ $SAMPLE_FORMAT == "S16_LE" ]; then
@@ -151,7 +153,9 @@ fi
 
 echo "Test result:"
 cd test
-./check $SAMPLE_FORMAT $CHANNELS
+./check $SAMPLE_FORMAT $CHANNELS ./sink_test.raw $PATTERN
+echo "Measuring latency ..."
+./latency plughw:RAVENNA $SAMPLE_FORMAT $SAMPLE_RATE $CHANNELS 10 ./latency.csv
 cd ..
 
 echo "Terminating processes ..."
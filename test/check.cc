@@ -1,85 +1,262 @@
-// basic file operations
+// verify the capture of the test pattern created by createtest
 #include <iostream>
-#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "pattern.h"
 
 using namespace std;
 
-int main(int argc, char* argv[]) 
+struct Discontinuity {
+  size_t offset;
+  long frames;          // > 0 dropped, < 0 repeated
+  size_t invalid_bytes; // bytes skipped to resync
+  size_t swapped;       // frames with the channels out of order
+};
+
+// two consecutive frames in sequence at data, or one at the end of the data
+static bool sync_at(const Pattern& p, const uint8_t* data, size_t left,
+                    uint64_t& index) {
+  if (!frame_index(p, data, index))
+    return false;
+  if (left < 2 * p.frame_bytes)
+    return true;
+  uint64_t next = 0;
+  return frame_index(p, data + p.frame_bytes, next) &&
+         next == (index + 1) % p.period;
+}
+
+// offset of the first different byte, or size if equal
+static size_t mismatch_generic(const uint8_t* a, const uint8_t* b, size_t size) {
+  if (!memcmp(a, b, size))
+    return size;
+  size_t i = 0;
+  while (a[i] == b[i])
+    i++;
+  return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static size_t mismatch_sse2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                _mm_loadu_si128((const __m128i*)(b + i)));
+    unsigned mask = _mm_movemask_epi8(eq) ^ 0xffff;
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + mismatch_generic(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch_avx2(const uint8_t* a, const uint8_t* b, size_t size) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    __m256i eq0 = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*)(a + i)),
+        _mm256_loadu_si256((const __m256i*)(b + i)));
+    __m256i eq1 = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256((const __m256i*)(a + i + 32)),
+        _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+    if (_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) != -1)
+      break;
+  }
+  return i + mismatch_sse2(a + i, b + i, size - i);
+}
+#endif
+
+typedef size_t (*Mismatch)(const uint8_t*, const uint8_t*, size_t);
+
+static Mismatch select_mismatch() {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2"))
+    return mismatch_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return mismatch_sse2;
+#endif
+  return mismatch_generic;
+}
+
+int main(int argc, char* argv[])
 {
   if (argc < 3) {
-    cerr << "Usage: " << argv[0] << " sample_format channels" << endl;
+    cerr << "Usage: " << argv[0]
+         << " sample_format channels [file] [bytes|counter]" << endl;
     exit(1);
   }
 
-  int len(0);
   string format(argv[1]);
-  if (format == "S16_LE")
-    len = 2;
-  else if (format == "S24_3LE")
-    len = 3;
-  else if (format == "S32_LE")
-    len = 4;
-  else {
-    cerr << "Unsupported format " << format << endl;
-    exit(1);
-  }
-
   int channels = atoi(argv[2]);
-  if (channels != 1 && channels != 2 && channels != 4 && channels != 8) {
-    cerr << "Unsupported channels " << channels << endl;
+  string kind(argc > 4 ? argv[4] : "bytes");
+  Pattern p;
+  if (!make_pattern(p, format, channels, kind)) {
+    cerr << "Unsupported format " << format << ", channels " << channels
+         << " or pattern " << kind << endl;
     exit(1);
   }
 
-  fstream fl;
-  fl.open("./sink_test.raw", ios::in|ios::binary);
-  if (!fl.is_open()) {
+  const char* file_name = argc > 3 ? argv[3] : "./sink_test.raw";
+  int fd = open(file_name, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
     cout << "cannot open file " << endl;
     exit(1);
   }
-  auto begin = fl.tellp();
-  fl.seekp(0, ios::end);
-  auto end = fl.tellp();
-  fl.seekp(0, ios::beg);
-  auto prev = fl.tellp();
-  // skip inital silence
-  while((prev = fl.tellp()) != end && fl.get() == 0);
-
-  uint8_t curr = 0, byte = 0;
-  bool first = true;
-  fl.seekp(prev);
-  while(fl.tellp() != end) {
-    int ch(channels);
-    while (ch--) {
-      if (!first) {
-        byte = fl.get();
-        if (byte != (uint8_t)curr) goto end;
+  size_t size = st.st_size;
+  const uint8_t* data = nullptr;
+  if (size) {
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      cout << "cannot map file " << endl;
+      exit(1);
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+    data = (const uint8_t*)addr;
+  }
+  close(fd);
+
+  auto start_time = chrono::steady_clock::now();
+  Mismatch mismatch = select_mismatch();
+  vector<uint8_t> expected(block_frames * p.frame_bytes);
+  uint64_t filled = p.period;  // index of the frames in expected, none yet
+  vector<Discontinuity> discontinuities;
+  size_t frames = 0, run = 0, longest_run = 0;
+  size_t dropped = 0, repeated = 0, invalid_bytes = 0, swapped = 0;
+
+  // skip the initial silence
+  size_t pos = 0;
+  uint64_t index = 0;  // of the next frame expected, modulo the period
+  while (pos + p.frame_bytes <= size &&
+         !sync_at(p, data + pos, size - pos, index))
+    pos++;
+  size_t first = pos;
+
+  while (pos + p.frame_bytes <= size) {
+    // compare whole frames with the pattern, up to one block at once
+    size_t count = (size - pos) / p.frame_bytes;
+    if (count > block_frames)
+      count = block_frames;
+    if (filled != index || block_frames % p.period) {
+      fill(p, expected.data(), index, block_frames);
+      filled = index;
+    }
+    size_t equal = mismatch(data + pos, expected.data(), count * p.frame_bytes) /
+                   p.frame_bytes;
+    frames += equal;
+    run += equal;
+    pos += equal * p.frame_bytes;
+    index = (index + equal) % p.period;
+    if (equal == count)
+      continue;
+
+    // frame not in sequence
+    if (run > longest_run)
+      longest_run = run;
+    run = 0;
+    Discontinuity d = {pos, 0, 0, 0};
+    while (pos + p.frame_bytes <= size && swapped_frame(p, data + pos, index)) {
+      d.swapped++;
+      pos += p.frame_bytes;
+      index = (index + 1) % p.period;
+    }
+    if (d.swapped) {
+      swapped += d.swapped;
+      frames += d.swapped;
+      discontinuities.push_back(d);
+      continue;
+    }
+
+    // resync on the pattern or on frames in sequence with swapped channels
+    size_t next = pos;
+    uint64_t actual = 0;
+    bool swap = false;
+    while (next + p.frame_bytes <= size &&
+           !sync_at(p, data + next, size - next, actual)) {
+      if ((next - pos) % p.frame_bytes == 0) {
+        actual = (index + (next - pos) / p.frame_bytes) % p.period;
+        if ((swap = swapped_frame(p, data + next, actual)))
+          break;
       }
-      if (len > 1) {
-        byte = fl.get();
-        if (byte != (uint8_t)(curr+1)) goto end;
-        if (len > 2) {
-          byte = fl.get();
-          if (byte != (uint8_t)(curr+2)) goto end;
-          if (len > 3) {
-            byte = fl.get();
-            if (byte != (uint8_t)(curr+3)) goto end;
-	  }
-        }
+      next++;
+    }
+    d.invalid_bytes = next - pos;
+    invalid_bytes += d.invalid_bytes;
+    if (swap)
+      index = actual;
+    else if (next + p.frame_bytes <= size) {
+      // frames jumped, modulo the pattern period, from where the sequence
+      // would be if the invalid bytes replaced whole frames. No jump if the
+      // sequence continues after them, e.g. silence inserted on an underrun
+      uint64_t replaced = (index + d.invalid_bytes / p.frame_bytes) % p.period;
+      uint64_t jump = (actual + p.period - replaced) % p.period;
+      if (d.invalid_bytes % p.frame_bytes == 0 && jump && actual != index) {
+        d.frames = jump <= p.period / 2 ? (long)jump : (long)jump - (long)p.period;
+        if (d.frames > 0)
+          dropped += d.frames;
+        else
+          repeated += -d.frames;
       }
-      first = false;
+      index = actual;
     }
-    curr += len;
+    discontinuities.push_back(d);
+    pos = next;
+  }
+  if (run > longest_run)
+    longest_run = run;
+  double secs = chrono::duration<double>(chrono::steady_clock::now() -
+                                         start_time).count();
+
+  cout << "frames checked: " << frames << ", leading silence: " << first
+       << " bytes" << endl;
+  cout << "pattern " << kind << " period: " << p.period
+       << " frames, dropped and repeated frames are modulo the period" << endl;
+  cout << "discontinuities: " << discontinuities.size() << endl;
+  for (size_t i = 0; i < discontinuities.size() && i < 32; i++) {
+    const Discontinuity& d = discontinuities[i];
+    cout << "  at position " << d.offset << " frame "
+         << (d.offset - first) / p.frame_bytes << ":";
+    if (d.swapped)
+      cout << " " << d.swapped << " frames with swapped channels";
+    if (d.invalid_bytes)
+      cout << " " << d.invalid_bytes << " invalid bytes"
+           << (d.offset + d.invalid_bytes + p.frame_bytes > size
+                   ? " to the end of file" : "");
+    if (d.frames > 0)
+      cout << " " << d.frames << " frames dropped";
+    if (d.frames < 0)
+      cout << " " << -d.frames << " frames repeated";
+    cout << endl;
   }
+  if (discontinuities.size() > 32)
+    cout << "  ..." << endl;
+  cout << "dropped frames: " << dropped << ", repeated frames: " << repeated
+       << ", invalid frames: "
+       << (invalid_bytes + p.frame_bytes - 1) / p.frame_bytes
+       << ", swapped frames: " << swapped << endl;
+  cout << "longest clean run: " << longest_run << " frames" << endl;
+  cout << "verified " << size << " bytes in " << fixed << setprecision(3)
+       << secs << " s" << endl;
 
-end:
-  //cout << "expected " << (int)curr << " byte " << (int)byte << endl;
   int rc = 0;
-  if (first || fl.tellp() != end)
-  {
-     cout << "error at position: " << fl.tellp() << endl;
-     rc = 1;
+  if (!frames || !discontinuities.empty()) {
+    cout << "error at position: "
+         << (frames ? discontinuities[0].offset : first) << endl;
+    rc = 1;
   }
   else cout << "ok" << endl;
-  fl.close();
+  if (size)
+    munmap((void*)data, size);
   return rc;
 }
@@ -1,26 +1,27 @@
-// basic file operations
+// create the test file played during the loopback test
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include "pattern.h"
 
 using namespace std;
 
-int main(int argc, char* argv[]) 
+int main(int argc, char* argv[])
 {
   if (argc < 5) {
-    cerr << "Usage " << argv[0] << " sample_format sample_rate channels duration" << endl;
+    cerr << "Usage " << argv[0]
+         << " sample_format sample_rate channels duration [bytes|counter]"
+         << endl;
     exit(1);
   }
 
-  int len(0);
   string format(argv[1]);
-  if (format == "S16_LE")
-    len = 2;
-  else if (format == "S24_3LE") 
-    len = 3;
-  else if (format == "S32_LE") 
-    len = 4;
-  else {
-    cerr << "Unsupported format " <<  format << endl;
+  int channels = atoi(argv[3]);
+  string kind(argc > 5 ? argv[5] : "bytes");
+  Pattern p;
+  if (!make_pattern(p, format, channels, kind)) {
+    cerr << "Unsupported format " << format << ", channels " << channels
+         << " or pattern " << kind << endl;
     exit(1);
   }
 
@@ -30,41 +31,32 @@ int main(int argc, char* argv[])
     exit(1);
   }
 
-  int channels = atoi(argv[3]);
-  if (channels != 1 && channels != 2 && channels != 4 && channels != 8) {
-    cerr << "Unsupported channels " << channels << endl;
-    exit(1);
-  }
-
   int duration = atoi(argv[4]);
   if (duration > 10 || duration < 1) {
     cerr << "Unsupported duration " << duration << " minutes" << endl;
     exit(1);
   }
 
-  int secs(duration * 60);
-  unsigned char byte(0);
+  // the bytes pattern repeats within a block, generate it once
+  uint64_t frames = (uint64_t)duration * 60 * rate;
+  vector<uint8_t> block(block_frames * p.frame_bytes);
+  bool repeat = block_frames % p.period == 0;
+  if (repeat)
+    fill(p, block.data(), 0, block_frames);
+
   fstream myfile;
   myfile.open("test.raw", ios::out|ios::binary);
-  while(secs--) {
-    int samples(rate);
-    while (samples--) {
-      int ch(channels);
-      while (ch--) {
-        myfile.put(byte);
-	if (len > 1) {
-          myfile.put(byte+1);
-	  if (len > 2) {
-            myfile.put(byte+2);
-	    if (len > 3)
-              myfile.put(byte+3);
-          }
-	}
-      }
-      byte+=len;
-    }
+  for (uint64_t frame = 0; frame < frames && myfile; frame += block_frames) {
+    size_t count = frames - frame < block_frames ? frames - frame : block_frames;
+    if (!repeat)
+      fill(p, block.data(), frame, count);
+    myfile.write((const char*)block.data(), count * p.frame_bytes);
   }
   myfile.close();
+  if (!myfile) {
+    cerr << "Failed to write test.raw" << endl;
+    exit(1);
+  }
   return 0;
 
 }
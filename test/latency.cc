@@ -0,0 +1,238 @@
+// measure the end-to-end latency from an ALSA playback device to a capture
+// device, e.g. from a RAVENNA source to a sink on the network loopback
+//
+// The counter pattern is played and recorded back. The playback and capture
+// hardware positions are timestamped with snd_pcm_htimestamp() so the time
+// a frame leaves the playback device and the time it reaches the capture
+// device can be compared on the same clock. The first frame captured after
+// the initial silence gives the absolute latency, the following ones are
+// tracked from it since the counter repeats (every 256 frames for S16_LE).
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <alsa/asoundlib.h>
+#include "pattern.h"
+
+using namespace std;
+
+struct Device {
+  snd_pcm_t* pcm{nullptr};
+  snd_pcm_uframes_t period{0};
+  snd_pcm_uframes_t buffer{0};
+  uint64_t frames{0};  // written or read by the application
+  size_t xruns{0};
+};
+
+static bool open_device(Device& dev, const char* name, snd_pcm_stream_t stream,
+                        snd_pcm_format_t format, int rate, int channels,
+                        unsigned int latency_us) {
+  int err = snd_pcm_open(&dev.pcm, name, stream, 0);
+  if (err < 0) {
+    cerr << "cannot open " << name << ": " << snd_strerror(err) << endl;
+    return false;
+  }
+  // no resampling, the pattern must reach the capture unchanged
+  err = snd_pcm_set_params(dev.pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+                           channels, rate, 0, latency_us);
+  if (err < 0 || (err = snd_pcm_get_params(dev.pcm, &dev.buffer,
+                                           &dev.period)) < 0) {
+    cerr << "cannot configure " << name << ": " << snd_strerror(err) << endl;
+    return false;
+  }
+  // timestamp the hardware position updates
+  snd_pcm_sw_params_t* sw;
+  snd_pcm_sw_params_alloca(&sw);
+  snd_pcm_sw_params_current(dev.pcm, sw);
+  snd_pcm_sw_params_set_tstamp_mode(dev.pcm, sw, SND_PCM_TSTAMP_ENABLE);
+  snd_pcm_sw_params_set_tstamp_type(dev.pcm, sw,
+                                    SND_PCM_TSTAMP_TYPE_MONOTONIC);
+  if ((err = snd_pcm_sw_params(dev.pcm, sw)) < 0) {
+    cerr << "cannot enable timestamps on " << name << ": "
+         << snd_strerror(err) << endl;
+    return false;
+  }
+  return true;
+}
+
+// hardware frame position and its time in seconds, false if unavailable
+static bool hw_position(const Device& dev, snd_pcm_stream_t stream,
+                        double& position, double& time) {
+  snd_pcm_uframes_t avail;
+  snd_htimestamp_t ts;
+  if (snd_pcm_htimestamp(dev.pcm, &avail, &ts) < 0 ||
+      (!ts.tv_sec && !ts.tv_nsec))
+    return false;
+  // frames queued for playback or captured and not read yet
+  if (stream == SND_PCM_STREAM_PLAYBACK)
+    position = (double)dev.frames - (double)(dev.buffer - avail);
+  else
+    position = (double)dev.frames + avail;
+  time = ts.tv_sec + ts.tv_nsec * 1e-9;
+  return true;
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+  size_t i = (size_t)(p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 5) {
+    cerr << "Usage: " << argv[0]
+         << " device sample_format sample_rate channels [seconds] [csv_file]"
+         << endl;
+    cerr << "  measures the latency from the playback to the capture of device"
+         << endl;
+    exit(1);
+  }
+
+  const char* device = argv[1];
+  string format(argv[2]);
+  int rate(atoi(argv[3]));
+  int channels(atoi(argv[4]));
+  int seconds(argc > 5 ? atoi(argv[5]) : 10);
+  const char* csv_name = argc > 6 ? argv[6] : nullptr;
+
+  Pattern p;
+  if (!make_pattern(p, format, channels, "counter")) {
+    cerr << "Unsupported format " << format << " or channels " << channels
+         << endl;
+    exit(1);
+  }
+  if (rate != 44100 && rate != 48000 && rate != 96000) {
+    cerr << "Unsupported rate " << rate << endl;
+    exit(1);
+  }
+  if (seconds < 1) {
+    cerr << "Unsupported duration " << seconds << " seconds" << endl;
+    exit(1);
+  }
+  snd_pcm_format_t pcm_format = p.len == 2 ? SND_PCM_FORMAT_S16_LE :
+                                p.len == 3 ? SND_PCM_FORMAT_S24_3LE :
+                                             SND_PCM_FORMAT_S32_LE;
+
+  Device play, capture;
+  if (!open_device(play, device, SND_PCM_STREAM_PLAYBACK, pcm_format, rate,
+                   channels, 20000) ||
+      !open_device(capture, device, SND_PCM_STREAM_CAPTURE, pcm_format, rate,
+                   channels, 20000))
+    exit(1);
+  snd_pcm_nonblock(play.pcm, 1);
+
+  ofstream csv;
+  if (csv_name) {
+    csv.open(csv_name);
+    csv << "seconds,latency_ms" << endl;
+  }
+
+  vector<uint8_t> out(play.buffer * p.frame_bytes);
+  vector<uint8_t> in(capture.period * p.frame_bytes);
+  vector<double> latencies;
+  double first_time = 0, last = 0;
+  uint64_t total = (uint64_t)seconds * rate;
+  snd_pcm_start(capture.pcm);
+
+  while (capture.frames < total) {
+    // keep the playback buffer full
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(play.pcm);
+    if (avail < 0) {
+      play.xruns++;
+      snd_pcm_recover(play.pcm, avail, 1);
+      continue;
+    }
+    if (avail > 0) {
+      fill(p, out.data(), play.frames, avail);
+      snd_pcm_sframes_t n = snd_pcm_writei(play.pcm, out.data(), avail);
+      if (n > 0)
+        play.frames += n;
+      else if (n < 0 && n != -EAGAIN) {
+        play.xruns++;
+        snd_pcm_recover(play.pcm, n, 1);
+      }
+    }
+
+    uint64_t first_frame = capture.frames;
+    snd_pcm_sframes_t n = snd_pcm_readi(capture.pcm, in.data(), capture.period);
+    if (n < 0) {
+      capture.xruns++;
+      snd_pcm_recover(capture.pcm, n, 1);
+      continue;
+    }
+    capture.frames += n;
+
+    // first frame of the pattern captured
+    uint64_t counter = 0;
+    snd_pcm_sframes_t i = 0;
+    while (i < n && !frame_index(p, in.data() + i * p.frame_bytes, counter))
+      i++;
+    double play_pos, play_time, capture_pos, capture_time;
+    if (i == n ||
+        !hw_position(capture, SND_PCM_STREAM_CAPTURE, capture_pos,
+                     capture_time) ||
+        !hw_position(play, SND_PCM_STREAM_PLAYBACK, play_pos, play_time))
+      continue;
+
+    // time the frame was captured and the playback position at that time,
+    // the frames between them are the latency, modulo the counter period
+    // after the first one
+    double captured = capture_time - (capture_pos - (first_frame + i)) / rate;
+    double played = play_pos + (captured - play_time) * rate;
+    double frames = played - counter;
+    if (!latencies.empty()) {
+      double change = fmod(frames - last, (double)p.period);
+      if (change > p.period / 2.0)
+        change -= p.period;
+      else if (change <= -(p.period / 2.0))
+        change += p.period;
+      frames = last + change;
+    }
+    if (frames < 0)
+      continue;
+    if (latencies.empty())
+      first_time = captured;
+    last = frames;
+    double latency = 1000.0 * frames / rate;
+    latencies.push_back(latency);
+    if (csv_name)
+      csv << fixed << setprecision(6) << captured - first_time << ","
+          << latency << endl;
+  }
+  snd_pcm_close(play.pcm);
+  snd_pcm_close(capture.pcm);
+
+  cout << "device " << device << ", " << format << ", " << rate << " Hz, "
+       << channels << " channels" << endl;
+  cout << "playback period " << play.period << " buffer " << play.buffer
+       << " frames, capture period " << capture.period << " buffer "
+       << capture.buffer << " frames" << endl;
+  cout << "measurements: " << latencies.size() << ", playback xruns: "
+       << play.xruns << ", capture xruns: " << capture.xruns << endl;
+  if (latencies.empty()) {
+    cout << "no pattern captured" << endl;
+    return 1;
+  }
+
+  double sum = 0, sum2 = 0;
+  for (double l : latencies) {
+    sum += l;
+    sum2 += l * l;
+  }
+  double mean = sum / latencies.size();
+  double dev = sqrt(max(0.0, sum2 / latencies.size() - mean * mean));
+  sort(latencies.begin(), latencies.end());
+  cout << fixed << setprecision(3);
+  cout << "latency ms min: " << latencies.front() << ", mean: " << mean
+       << ", max: " << latencies.back() << ", std dev: " << dev << endl;
+  cout << "percentiles ms 50%: " << percentile(latencies, 50)
+       << ", 90%: " << percentile(latencies, 90)
+       << ", 99%: " << percentile(latencies, 99)
+       << ", 99.9%: " << percentile(latencies, 99.9) << endl;
+  cout << "variation ms (max - min): "
+       << latencies.back() - latencies.front() << endl;
+  return 0;
+}
@@ -0,0 +1,154 @@
+// test patterns written by createtest and verified by check
+#ifndef _PATTERN_H_
+#define _PATTERN_H_
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+// bytes:   every sample of frame n is (b, b+1, ..., b+len-1) with
+//          b = n * len mod 256, the pattern repeats every 64 to 256 frames
+// counter: every sample carries 0x80 | channel in the most significant byte
+//          and the frame counter in the others, the pattern repeats every
+//          2^(8 * (len - 1)) frames: 256 for S16_LE, 65536 for S24_3LE and
+//          16777216 (more than 5 minutes at 48kHz) for S32_LE
+enum class PatternKind { bytes, counter };
+
+const int max_channels = 64;
+// frames generated or compared at once, a multiple of the bytes pattern period
+const size_t block_frames = 4096;
+
+struct Pattern {
+  PatternKind kind;
+  int len;              // bytes per sample
+  int channels;
+  size_t frame_bytes;
+  uint64_t period;      // frames before the pattern repeats
+};
+
+inline int gcd(int a, int b) {
+  return b ? gcd(b, a % b) : a;
+}
+
+// returns false if the format, channels or pattern name are not supported
+inline bool make_pattern(Pattern& p,
+                         const std::string& format,
+                         int channels,
+                         const std::string& kind) {
+  if (format == "S16_LE")
+    p.len = 2;
+  else if (format == "S24_3LE")
+    p.len = 3;
+  else if (format == "S32_LE")
+    p.len = 4;
+  else
+    return false;
+  if (channels < 1 || channels > max_channels)
+    return false;
+  if (kind == "bytes")
+    p.kind = PatternKind::bytes;
+  else if (kind == "counter")
+    p.kind = PatternKind::counter;
+  else
+    return false;
+  p.channels = channels;
+  p.frame_bytes = p.len * channels;
+  p.period = p.kind == PatternKind::bytes ? 256 / gcd(p.len, 256)
+                                          : 1ULL << (8 * (p.len - 1));
+  return true;
+}
+
+template <int len>
+inline void fill_counter(const Pattern& p, uint8_t* out, uint64_t first,
+                         size_t frames) {
+  for (size_t n = 0; n < frames; n++) {
+    uint64_t frame = (first + n) % p.period;
+    for (int ch = 0; ch < p.channels; ch++) {
+      for (int i = 0; i < len - 1; i++)
+        *out++ = frame >> (8 * i);
+      *out++ = 0x80 | ch;
+    }
+  }
+}
+
+// write frames of the pattern starting at frame index first
+inline void fill(const Pattern& p, uint8_t* out, uint64_t first, size_t frames) {
+  if (p.kind == PatternKind::counter) {
+    if (p.len == 2)
+      fill_counter<2>(p, out, first, frames);
+    else if (p.len == 3)
+      fill_counter<3>(p, out, first, frames);
+    else
+      fill_counter<4>(p, out, first, frames);
+    return;
+  }
+  for (size_t n = 0; n < frames; n++) {
+    uint8_t b = (first + n) * p.len;
+    for (int ch = 0; ch < p.channels; ch++)
+      for (int i = 0; i < p.len; i++)
+        *out++ = b + i;
+  }
+}
+
+// counter of a sample of the counter pattern and its channel, false if the
+// sample is not part of the pattern
+inline bool sample_counter(const Pattern& p, const uint8_t* s,
+                           uint64_t& counter, int& channel) {
+  if (!(s[p.len - 1] & 0x80))
+    return false;
+  channel = s[p.len - 1] & 0x7f;
+  counter = 0;
+  for (int i = 0; i < p.len - 1; i++)
+    counter |= (uint64_t)s[i] << (8 * i);
+  return channel < p.channels;
+}
+
+// index, modulo the period, of a frame of the pattern, false if invalid
+inline bool frame_index(const Pattern& p, const uint8_t* f, uint64_t& index) {
+  if (p.kind == PatternKind::bytes) {
+    uint8_t b = f[0];
+    int g = gcd(p.len, 256);
+    if (b % g)
+      return false;
+    for (int ch = 0; ch < p.channels; ch++)
+      for (int i = 0; i < p.len; i++)
+        if (*f++ != (uint8_t)(b + i))
+          return false;
+    // solve index * len = b mod 256
+    uint64_t step = p.len / g, inverse = 1;
+    while ((step * inverse) % p.period != 1 % p.period)
+      inverse++;
+    index = (b / g) * inverse % p.period;
+    return true;
+  }
+  for (int ch = 0; ch < p.channels; ch++, f += p.len) {
+    uint64_t counter;
+    int channel;
+    if (!sample_counter(p, f, counter, channel) || channel != ch ||
+        (ch && counter != index))
+      return false;
+    index = counter;
+  }
+  return true;
+}
+
+// a frame of the counter pattern with the expected index but with the
+// channels in a different order
+inline bool swapped_frame(const Pattern& p, const uint8_t* f, uint64_t index) {
+  if (p.kind != PatternKind::counter)
+    return false;
+  uint64_t seen = 0;
+  bool swapped = false;
+  for (int ch = 0; ch < p.channels; ch++, f += p.len) {
+    uint64_t counter;
+    int channel;
+    if (!sample_counter(p, f, counter, channel) || counter != index ||
+        (seen & (1ULL << channel)))
+      return false;
+    seen |= 1ULL << channel;
+    swapped |= channel != ch;
+  }
+  return swapped;
+}
+
+#endif
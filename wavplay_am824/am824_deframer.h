@@ -0,0 +1,488 @@
+
+/************************************************************************************************************
+ * WavPlay AM824
+ * Copyright (C) 2020, Dolby Laboratories Inc.
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ ************************************************************************************************************/
+
+#ifndef _AM824_DEFRAMER_H_
+#define _AM824_DEFRAMER_H_
+
+#include "am824_framer.h"
+
+#define AM824_AUDIO_MASK 0x00ffffff
+#define AM824_CHANNEL_STATUS_BIT (1 << 26)
+#define AM824_FRAME_START_BIT (1 << 28)
+#define AM824_BLOCK_START_BIT (1 << 29)
+/* Bits covered by the parity, including the parity bit itself */
+#define AM824_PARITY_MASK 0x3fffffff
+
+enum AM824DeframerErrorType {
+  AM824_DEFRAMER_PARITY_ERROR = 0,
+  AM824_DEFRAMER_FRAME_START_ERROR,
+  AM824_DEFRAMER_BLOCK_START_ERROR,
+  AM824_DEFRAMER_CRC_ERROR,
+  AM824_DEFRAMER_ERROR_TYPES
+};
+
+struct AM824DeframerError {
+  AM824DeframerErrorType type;
+  uint64_t frameIndex; /* Frame from the start of the stream */
+  uint8_t channel;
+};
+
+/* Validation kernels.
+ * Every kernel checks up to count samples starting at position in the
+ * channel status block against expected, the frame start and block start
+ * bits of each sample, and stops before the first vector containing a
+ * parity or a framing error. For the valid samples the channel status bits
+ * are stored in the cbits bitmap and the 24 bit PCM samples are written to
+ * pcm if not NULL. Returns the number of valid samples processed, the
+ * caller checks the next sample with the scalar code.
+ */
+typedef unsigned long (*AM824ValidateKernel)(const uint8_t* input,
+                                             uint8_t* pcm,
+                                             unsigned long count,
+                                             const uint32_t* expected,
+                                             uint64_t* cbits,
+                                             unsigned int position,
+                                             bool bigEndian);
+
+static inline void am824SetBits(uint64_t* bitmap,
+                                unsigned int position,
+                                uint64_t bits,
+                                unsigned int numBits) {
+  unsigned int shift = position % 64;
+  bitmap[position / 64] |= bits << shift;
+  if (shift + numBits > 64) {
+    bitmap[position / 64 + 1] |= bits >> (64 - shift);
+  }
+}
+
+#if defined(AM824_SIMD_X86)
+/* store the 12 low bytes without writing past them */
+__attribute__((target("ssse3"))) static inline void am824Store12(
+    uint8_t* p,
+    __m128i v) {
+  int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+  _mm_storel_epi64((__m128i*)p, v);
+  memcpy(p + 8, &tail, sizeof(tail));
+}
+
+__attribute__((target("ssse3"))) static unsigned long am824ValidateSSSE3(
+    const uint8_t* input,
+    uint8_t* pcm,
+    unsigned long count,
+    const uint32_t* expected,
+    uint64_t* cbits,
+    unsigned int position,
+    bool bigEndian) {
+  const __m128i pack24 =
+      _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m128i swap32 =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m128i parityMask = _mm_set1_epi32(AM824_PARITY_MASK);
+  const __m128i framingMask =
+      _mm_set1_epi32(AM824_FRAME_START_BIT | AM824_BLOCK_START_BIT);
+  const __m128i one = _mm_set1_epi32(1);
+  unsigned long i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    __m128i word = _mm_loadu_si128((const __m128i*)(input + i * 4));
+    if (bigEndian) {
+      word = _mm_shuffle_epi8(word, swap32);
+    }
+    __m128i parity = _mm_and_si128(word, parityMask);
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 16));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 8));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 4));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 2));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 1));
+    __m128i framing =
+        _mm_xor_si128(_mm_and_si128(word, framingMask),
+                      _mm_loadu_si128((const __m128i*)(expected + i)));
+    __m128i bad = _mm_or_si128(_mm_and_si128(parity, one), framing);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(bad, _mm_setzero_si128())) !=
+        0xffff) {
+      break;
+    }
+    am824SetBits(cbits, position + i,
+                 _mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(word, 5))),
+                 4);
+    if (pcm) {
+      am824Store12(pcm + i * 3, _mm_shuffle_epi8(word, pack24));
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static unsigned long am824ValidateAVX2(
+    const uint8_t* input,
+    uint8_t* pcm,
+    unsigned long count,
+    const uint32_t* expected,
+    uint64_t* cbits,
+    unsigned int position,
+    bool bigEndian) {
+  const __m256i pack24 = _mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5,
+      6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m256i swap32 = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+      5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i parityMask = _mm256_set1_epi32(AM824_PARITY_MASK);
+  const __m256i framingMask =
+      _mm256_set1_epi32(AM824_FRAME_START_BIT | AM824_BLOCK_START_BIT);
+  const __m256i one = _mm256_set1_epi32(1);
+  unsigned long i;
+
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m256i word = _mm256_loadu_si256((const __m256i*)(input + i * 4));
+    if (bigEndian) {
+      word = _mm256_shuffle_epi8(word, swap32);
+    }
+    __m256i parity = _mm256_and_si256(word, parityMask);
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 16));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 8));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 4));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 2));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 1));
+    __m256i framing =
+        _mm256_xor_si256(_mm256_and_si256(word, framingMask),
+                         _mm256_loadu_si256((const __m256i*)(expected + i)));
+    __m256i bad = _mm256_or_si256(_mm256_and_si256(parity, one), framing);
+    if (!_mm256_testz_si256(bad, bad)) {
+      break;
+    }
+    am824SetBits(
+        cbits, position + i,
+        _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(word, 5))),
+        8);
+    if (pcm) {
+      __m256i packed = _mm256_shuffle_epi8(word, pack24);
+      am824Store12(pcm + i * 3, _mm256_castsi256_si128(packed));
+      am824Store12(pcm + i * 3 + 12, _mm256_extracti128_si256(packed, 1));
+    }
+  }
+  return i;
+}
+#elif defined(AM824_SIMD_NEON)
+static unsigned long am824ValidateNEON(const uint8_t* input,
+                                       uint8_t* pcm,
+                                       unsigned long count,
+                                       const uint32_t* expected,
+                                       uint64_t* cbits,
+                                       unsigned int position,
+                                       bool bigEndian) {
+  static const uint8_t pack24Bytes[16] = {0, 1,  2,  4,    5,    6,    8,   9,
+                                          10, 12, 13, 14, 0xff, 0xff, 0xff,
+                                          0xff};
+  static const uint32_t laneBits[4] = {1, 2, 4, 8};
+  const uint8x16_t pack24 = vld1q_u8(pack24Bytes);
+  const uint32x4_t lanes = vld1q_u32(laneBits);
+  const uint32x4_t parityMask = vdupq_n_u32(AM824_PARITY_MASK);
+  const uint32x4_t framingMask =
+      vdupq_n_u32(AM824_FRAME_START_BIT | AM824_BLOCK_START_BIT);
+  const uint32x4_t one = vdupq_n_u32(1);
+  unsigned long i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    uint8x16_t bytes = vld1q_u8(input + i * 4);
+    if (bigEndian) {
+      bytes = vrev32q_u8(bytes);
+    }
+    uint32x4_t word = vreinterpretq_u32_u8(bytes);
+    uint32x4_t parity = vandq_u32(word, parityMask);
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 16));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 8));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 4));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 2));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 1));
+    uint32x4_t framing =
+        veorq_u32(vandq_u32(word, framingMask), vld1q_u32(expected + i));
+    uint32x4_t bad = vorrq_u32(vandq_u32(parity, one), framing);
+    if (vmaxvq_u32(bad)) {
+      break;
+    }
+    am824SetBits(cbits, position + i,
+                 vaddvq_u32(vmulq_u32(vandq_u32(vshrq_n_u32(word, 26), one),
+                                      lanes)),
+                 4);
+    if (pcm) {
+      uint8x16_t packed = vqtbl1q_u8(bytes, pack24);
+      uint32_t tail = vgetq_lane_u32(vreinterpretq_u32_u8(packed), 2);
+      vst1_u8(pcm + i * 3, vget_low_u8(packed));
+      memcpy(pcm + i * 3 + 8, &tail, sizeof(tail));
+    }
+  }
+  return i;
+}
+#endif
+
+static inline AM824ValidateKernel am824SelectValidateKernel(void) {
+#if defined(AM824_SIMD_X86)
+  if (__builtin_cpu_supports("avx2")) {
+    return am824ValidateAVX2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return am824ValidateSSSE3;
+  }
+  return NULL;
+#elif defined(AM824_SIMD_NEON)
+  return am824ValidateNEON;
+#else
+  return NULL;
+#endif
+}
+
+class AM824Deframer {
+  uint8_t numChannels;
+  /* channels of each independent stream, the first carries the frame start */
+  uint8_t streamChannels;
+  AM824Endianess endian;
+  uint8_t crcTable[256];
+  unsigned int blockSamples;
+  /* expected frame start and block start bits of every sample of a block */
+  uint32_t* expected;
+  /* channel status bits of the current block, one bit per sample */
+  uint64_t* cbits;
+  /* channel status of the last complete block of every channel */
+  uint8_t* channelStatus;
+  bool synced;
+  unsigned int position; /* Sample position in the block when synced */
+  uint64_t sampleIndex;  /* Samples processed from the start of the stream */
+  uint64_t blocksChecked;
+  uint64_t errorCounts[AM824_DEFRAMER_ERROR_TYPES];
+  AM824DeframerError* errors;
+  unsigned long maxErrors;
+  unsigned long numErrors;
+  AM824ValidateKernel kernel;
+
+  void addError(AM824DeframerErrorType type,
+                uint64_t frameIndex,
+                uint8_t channel) {
+    errorCounts[type]++;
+    if (numErrors < maxErrors) {
+      errors[numErrors].type = type;
+      errors[numErrors].frameIndex = frameIndex;
+      errors[numErrors].channel = channel;
+      numErrors++;
+    }
+  }
+
+  void buildExpected(void) {
+    for (unsigned int i = 0; i < blockSamples; i++) {
+      expected[i] =
+          (i < numChannels ? AM824_BLOCK_START_BIT : 0) |
+          (i % numChannels % streamChannels == 0 ? AM824_FRAME_START_BIT : 0);
+    }
+  }
+
+  void startBlock(void) {
+    memset(cbits, 0, sizeof(uint64_t) * (blockSamples / 64 + 2));
+    position = 0;
+    synced = true;
+  }
+
+  // Reassemble and check the channel status of every channel
+  void endBlock(void) {
+    uint64_t frameIndex = sampleIndex / numChannels - CHANNEL_STATUS_FRAMES;
+    for (unsigned int channel = 0; channel < numChannels; channel++) {
+      uint8_t* status = channelStatus + channel * CHANNEL_STATUS_BYTES;
+      memset(status, 0, CHANNEL_STATUS_BYTES);
+      for (unsigned int frame = 0; frame < CHANNEL_STATUS_FRAMES; frame++) {
+        unsigned int bit = frame * numChannels + channel;
+        status[frame / 8] |= ((cbits[bit / 64] >> (bit % 64)) & 1)
+                             << (frame % 8);
+      }
+      if (am824ChannelStatusCRC(crcTable, status) !=
+          status[CHANNEL_STATUS_BYTES - 1]) {
+        addError(AM824_DEFRAMER_CRC_ERROR, frameIndex, channel);
+      }
+    }
+    blocksChecked++;
+    startBlock();
+  }
+
+  uint32_t loadWord(const uint8_t* p) const {
+    if (endian == AM824_BIG_ENDIAN) {
+      return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  // Check a single sample, this also handles the block synchronization
+  void checkSample(uint32_t word) {
+    uint64_t frameIndex = sampleIndex / numChannels;
+    uint8_t channel = sampleIndex % numChannels;
+
+    if (am824Parity(word & AM824_PARITY_MASK)) {
+      addError(AM824_DEFRAMER_PARITY_ERROR, frameIndex, channel);
+    }
+    if (((word & AM824_FRAME_START_BIT) != 0) !=
+        (channel % streamChannels == 0)) {
+      addError(AM824_DEFRAMER_FRAME_START_ERROR, frameIndex, channel);
+    }
+
+    if (synced) {
+      if ((word ^ expected[position]) & AM824_BLOCK_START_BIT) {
+        addError(AM824_DEFRAMER_BLOCK_START_ERROR, frameIndex, channel);
+        // realign to an early block start, otherwise wait for the next one
+        if ((word & AM824_BLOCK_START_BIT) && channel == 0) {
+          startBlock();
+        } else {
+          synced = false;
+        }
+      }
+    } else if (word & AM824_BLOCK_START_BIT) {
+      if (channel == 0) {
+        startBlock();
+      } else {
+        addError(AM824_DEFRAMER_BLOCK_START_ERROR, frameIndex, channel);
+      }
+    }
+
+    sampleIndex++;
+    if (synced) {
+      am824SetBits(cbits, position, (word >> 26) & 1, 1);
+      position++;
+      if (position == blockSamples) {
+        endBlock();
+      }
+    }
+  }
+
+ public:
+  AM824Deframer(
+      uint8_t newNumChannels, /* Input - Number of channels of the stream */
+      AM824Endianess inputEndianess, /* Input - Endianess of input samples */
+      unsigned long newMaxErrors = 1024) /* Input - Number of errors to keep */
+  {
+    numChannels = newNumChannels;
+    streamChannels = numChannels ? numChannels : 1;
+    endian = inputEndianess;
+    blockSamples = CHANNEL_STATUS_FRAMES * numChannels;
+    expected = new uint32_t[blockSamples];
+    cbits = new uint64_t[blockSamples / 64 + 2];
+    channelStatus = new uint8_t[CHANNEL_STATUS_BYTES * numChannels];
+    maxErrors = newMaxErrors;
+    errors = new AM824DeframerError[maxErrors];
+    kernel = am824SelectValidateKernel();
+    am824CrcTableInit(crcTable);
+    buildExpected();
+    memset(channelStatus, 0, CHANNEL_STATUS_BYTES * numChannels);
+    reset();
+  }
+
+  ~AM824Deframer() {
+    delete[] expected;
+    delete[] cbits;
+    delete[] channelStatus;
+    delete[] errors;
+  }
+
+  AM824Deframer(const AM824Deframer&) = delete;
+  AM824Deframer& operator=(const AM824Deframer&) = delete;
+
+  // Channels of each independent stream, see AM824Framer::setStreamChannels()
+  AM824ErrorCode setStreamChannels(uint8_t channels) {
+    if (channels == 0 || channels > numChannels) {
+      return (AM824_ERR_BAD_CHANNEL);
+    }
+    streamChannels = channels;
+    buildExpected();
+    return (AM824_ERR_OK);
+  }
+
+  void reset(void) {
+    synced = false;
+    position = 0;
+    sampleIndex = 0;
+    blocksChecked = 0;
+    numErrors = 0;
+    memset(errorCounts, 0, sizeof(errorCounts));
+  }
+
+  // Validate numFrames interleaved frames of 32 bit AM824 samples and
+  // extract the 24 bit PCM samples (3 bytes little endian) to pcmOutput if
+  // not NULL. Frames before the first block start are checked for parity
+  // and frame start only. Returns the number of errors detected.
+  unsigned long processFrames(const uint8_t* inputBytes,
+                              uint8_t* pcmOutput,
+                              unsigned long numFrames) {
+    unsigned long count = numFrames * numChannels;
+    uint64_t errorsBefore = getErrorCount();
+    bool bigEndian = (endian == AM824_BIG_ENDIAN);
+
+    while (count) {
+      if (synced && kernel) {
+        // validate up to the end of the block or to the first error
+        unsigned long blockCount = blockSamples - position;
+        if (blockCount > count) {
+          blockCount = count;
+        }
+        unsigned long valid =
+            kernel(inputBytes, pcmOutput, blockCount, expected + position,
+                   cbits, position, bigEndian);
+        inputBytes += valid * 4;
+        if (pcmOutput) {
+          pcmOutput += valid * 3;
+        }
+        count -= valid;
+        sampleIndex += valid;
+        position += valid;
+        if (position == blockSamples) {
+          endBlock();
+        }
+        if (valid == blockCount) {
+          continue;
+        }
+      }
+      uint32_t word = loadWord(inputBytes);
+      checkSample(word);
+      if (pcmOutput) {
+        *pcmOutput++ = word;
+        *pcmOutput++ = word >> 8;
+        *pcmOutput++ = word >> 16;
+      }
+      inputBytes += 4;
+      count--;
+    }
+    return getErrorCount() - errorsBefore;
+  }
+
+  bool isSynced(void) const { return synced; }
+  uint64_t getFramesProcessed(void) const { return sampleIndex / numChannels; }
+  uint64_t getBlocksChecked(void) const { return blocksChecked; }
+  uint64_t getErrorCount(AM824DeframerErrorType type) const {
+    return errorCounts[type];
+  }
+  uint64_t getErrorCount(void) const {
+    uint64_t count = 0;
+    for (int type = 0; type < AM824_DEFRAMER_ERROR_TYPES; type++) {
+      count += errorCounts[type];
+    }
+    return count;
+  }
+  // First errors detected, up to the maximum set in the constructor
+  const AM824DeframerError* getErrors(unsigned long& count) const {
+    count = numErrors;
+    return errors;
+  }
+  // Channel status of the last complete block of the channel
+  const uint8_t* getChannelStatus(uint8_t channel) const {
+    return channelStatus + channel * CHANNEL_STATUS_BYTES;
+  }
+};
+
+#endif
@@ -15,9 +15,26 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  ************************************************************************************************************/
 
+#ifndef _AM824_FRAMER_H_
+#define _AM824_FRAMER_H_
+
+#include <math.h>
 #include <stdint.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AM824_SIMD_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define AM824_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 #define CHANNEL_STATUS_BYTES 24
+#define CHANNEL_STATUS_FRAMES (CHANNEL_STATUS_BYTES * 8)
+/* Frames of every channel converted at once by the planar conversion */
+#define AM824_PLANAR_FRAMES 32
 
 #define WIDTH (8)
 #define BOTTOMBIT 1
@@ -26,7 +43,8 @@
 enum AM824ErrorCode {
   AM824_ERR_OK = 0,
   AM824_ERR_BAD_SAMPLING_FREQUENCY = -1,
-  AM824_ERR_UNSUPPORTED_BITDEPTH = -2
+  AM824_ERR_UNSUPPORTED_BITDEPTH = -2,
+  AM824_ERR_BAD_CHANNEL = -3
 };
 
 enum AM824SamplingFrequency {
@@ -38,15 +56,341 @@ enum AM824SamplingFrequency {
 
 enum AM824Endianess { AM824_BIG_ENDIAN, AM824_LITTLE_ENDIAN };
 
+enum AM824InputFormat { AM824_INPUT_PCM, AM824_INPUT_FLOAT };
+
+/* Layout of the input samples in memory, machine order */
+enum AM824SampleType {
+  AM824_SAMPLE_16,    /* 2 bytes, MSB justified to 24 bit */
+  AM824_SAMPLE_24,    /* 3 packed bytes, also used for 20 bit */
+  AM824_SAMPLE_32,    /* 4 bytes, the top 24 bits are used */
+  AM824_SAMPLE_FLOAT  /* 4 bytes float, full scale is [-1.0, 1.0) */
+};
+
+/* Block conversion kernels.
+ * Every kernel converts count input samples of the given type using flags,
+ * the precomputed channel status, block
+ * start, frame start and parity bits of each sample, and returns the number
+ * of samples converted. The caller converts the remaining samples with
+ * am824Word().
+ * Since the audio and the flag bits don't overlap the parity of the word is
+ * the parity of the audio bits xor the parity already folded into flags.
+ */
+typedef unsigned long (*AM824Kernel)(const uint8_t* input,
+                                     uint8_t* output,
+                                     unsigned long count,
+                                     const uint32_t* flags,
+                                     AM824SampleType sampleType,
+                                     bool bigEndian);
+
+/* Channel status CRC, shared with the deframer */
+static inline void am824CrcTableInit(uint8_t* crcTable) {
+  uint8_t remainder;
+
+  for (int dividend = 0; dividend < 256; ++dividend) {
+    remainder = dividend << (WIDTH - 8);
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      if (remainder & BOTTOMBIT) {
+        remainder = (remainder >> 1) ^ REFLECTED_POLYNOMIAL;
+      } else {
+        remainder = (remainder >> 1);
+      }
+    }
+    crcTable[dividend] = remainder;
+  }
+}
+
+/* CRC of the first 23 bytes of a channel status block */
+static inline uint8_t am824ChannelStatusCRC(const uint8_t* crcTable,
+                                            const uint8_t* channelStatus) {
+  uint8_t data;
+  uint8_t remainder = 0xff;
+
+  for (int byte = 0; byte < CHANNEL_STATUS_BYTES - 1; byte++) {
+    data = channelStatus[byte] ^ remainder;
+    remainder = crcTable[data];
+  }
+  return remainder;
+}
+
+static inline uint32_t am824Parity(uint32_t n) {
+  n ^= n >> 16;
+  n ^= n >> 8;
+  n ^= n >> 4;
+  n ^= n >> 2;
+  n ^= n >> 1;
+  return n & 1;
+}
+
+static inline uint32_t am824Word(uint32_t sample, uint32_t flags) {
+  return (sample | flags) ^ (am824Parity(sample) << 27);
+}
+
+/* Float to 24 bit, clipped and rounded to nearest even like the kernels,
+ * NaN converts to positive full scale. bits is the float bit pattern. */
+static inline uint32_t am824FloatTo24(uint32_t bits) {
+  float value;
+
+  memcpy(&value, &bits, sizeof(value));
+  value *= 8388608.0f;
+  if (!(value < 8388607.0f)) {
+    value = 8388607.0f;
+  }
+  if (!(value > -8388608.0f)) {
+    value = -8388608.0f;
+  }
+  return (uint32_t)lrintf(value) & 0xffffff;
+}
+
+/* 24 bit audio bits of an AM824 word from an input sample */
+static inline uint32_t am824AlignSample(uint32_t sample,
+                                        AM824SampleType sampleType) {
+  switch (sampleType) {
+    case AM824_SAMPLE_16:
+      return sample << 8;
+    case AM824_SAMPLE_32:
+      return sample >> 8;
+    case AM824_SAMPLE_FLOAT:
+      return am824FloatTo24(sample);
+    default:
+      return sample;
+  }
+}
+
+/* Input sample at index i of the given type */
+static inline uint32_t am824LoadSample(const uint8_t* input,
+                                       unsigned long i,
+                                       AM824SampleType sampleType) {
+  uint32_t sample;
+
+  if (sampleType == AM824_SAMPLE_16) {
+    uint16_t sample16;
+    memcpy(&sample16, input + i * 2, sizeof(sample16));
+    sample = sample16;
+  } else if (sampleType == AM824_SAMPLE_24) {
+    const uint8_t* p = input + i * 3;
+    sample = p[0] | (p[1] << 8) | (p[2] << 16);
+  } else {
+    memcpy(&sample, input + i * 4, sizeof(sample));
+  }
+  return am824AlignSample(sample, sampleType);
+}
+
+static inline unsigned int am824SampleBytes(AM824SampleType sampleType) {
+  return sampleType == AM824_SAMPLE_16 ? 2
+                                       : (sampleType == AM824_SAMPLE_24 ? 3 : 4);
+}
+
+#if defined(AM824_SIMD_X86)
+/* load 4 packed 24 bit samples without reading past them */
+__attribute__((target("ssse3"))) static inline __m128i am824Load12(
+    const uint8_t* p) {
+  int32_t tail;
+  memcpy(&tail, p + 8, sizeof(tail));
+  return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)p),
+                            _mm_cvtsi32_si128(tail));
+}
+
+__attribute__((target("ssse3"))) static unsigned long am824ConvertSSSE3(
+    const uint8_t* input,
+    uint8_t* output,
+    unsigned long count,
+    const uint32_t* flags,
+    AM824SampleType sampleType,
+    bool bigEndian) {
+  const __m128i unpack24 =
+      _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i swap32 =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i mask24 = _mm_set1_epi32(0xffffff);
+  const __m128 scale = _mm_set1_ps(8388608.0f);
+  const __m128 maxValue = _mm_set1_ps(8388607.0f);
+  const __m128 minValue = _mm_set1_ps(-8388608.0f);
+  unsigned long i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    __m128i sample;
+    if (sampleType == AM824_SAMPLE_16) {
+      sample = _mm_loadl_epi64((const __m128i*)(input + i * 2));
+      sample = _mm_srli_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), sample),
+                              8);
+    } else if (sampleType == AM824_SAMPLE_24) {
+      sample = _mm_shuffle_epi8(am824Load12(input + i * 3), unpack24);
+    } else if (sampleType == AM824_SAMPLE_32) {
+      sample = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(input + i * 4)),
+                              8);
+    } else {
+      // min and max return the second operand for NaN, like am824FloatTo24()
+      __m128 value =
+          _mm_mul_ps(_mm_loadu_ps((const float*)(input + i * 4)), scale);
+      value = _mm_max_ps(_mm_min_ps(value, maxValue), minValue);
+      sample = _mm_and_si128(_mm_cvtps_epi32(value), mask24);
+    }
+    __m128i parity = _mm_xor_si128(sample, _mm_srli_epi32(sample, 16));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 8));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 4));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 2));
+    parity = _mm_xor_si128(parity, _mm_srli_epi32(parity, 1));
+    parity = _mm_slli_epi32(_mm_and_si128(parity, one), 27);
+    __m128i word = _mm_xor_si128(
+        _mm_or_si128(sample, _mm_loadu_si128((const __m128i*)(flags + i))),
+        parity);
+    if (bigEndian) {
+      word = _mm_shuffle_epi8(word, swap32);
+    }
+    _mm_storeu_si128((__m128i*)(output + i * 4), word);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static unsigned long am824ConvertAVX2(
+    const uint8_t* input,
+    uint8_t* output,
+    unsigned long count,
+    const uint32_t* flags,
+    AM824SampleType sampleType,
+    bool bigEndian) {
+  const __m256i unpack24 = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+      5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m256i swap32 = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6,
+      5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i mask24 = _mm256_set1_epi32(0xffffff);
+  const __m256 scale = _mm256_set1_ps(8388608.0f);
+  const __m256 maxValue = _mm256_set1_ps(8388607.0f);
+  const __m256 minValue = _mm256_set1_ps(-8388608.0f);
+  unsigned long i;
+
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m256i sample;
+    if (sampleType == AM824_SAMPLE_16) {
+      sample = _mm256_slli_epi32(
+          _mm256_cvtepu16_epi32(
+              _mm_loadu_si128((const __m128i*)(input + i * 2))),
+          8);
+    } else if (sampleType == AM824_SAMPLE_24) {
+      sample = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(am824Load12(input + i * 3)),
+          am824Load12(input + i * 3 + 12), 1);
+      sample = _mm256_shuffle_epi8(sample, unpack24);
+    } else if (sampleType == AM824_SAMPLE_32) {
+      sample = _mm256_srli_epi32(
+          _mm256_loadu_si256((const __m256i*)(input + i * 4)), 8);
+    } else {
+      __m256 value = _mm256_mul_ps(
+          _mm256_loadu_ps((const float*)(input + i * 4)), scale);
+      value = _mm256_max_ps(_mm256_min_ps(value, maxValue), minValue);
+      sample = _mm256_and_si256(_mm256_cvtps_epi32(value), mask24);
+    }
+    __m256i parity = _mm256_xor_si256(sample, _mm256_srli_epi32(sample, 16));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 8));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 4));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 2));
+    parity = _mm256_xor_si256(parity, _mm256_srli_epi32(parity, 1));
+    parity = _mm256_slli_epi32(_mm256_and_si256(parity, one), 27);
+    __m256i word = _mm256_xor_si256(
+        _mm256_or_si256(sample,
+                        _mm256_loadu_si256((const __m256i*)(flags + i))),
+        parity);
+    if (bigEndian) {
+      word = _mm256_shuffle_epi8(word, swap32);
+    }
+    _mm256_storeu_si256((__m256i*)(output + i * 4), word);
+  }
+  return i;
+}
+#elif defined(AM824_SIMD_NEON)
+static unsigned long am824ConvertNEON(const uint8_t* input,
+                                      uint8_t* output,
+                                      unsigned long count,
+                                      const uint32_t* flags,
+                                      AM824SampleType sampleType,
+                                      bool bigEndian) {
+  static const uint8_t unpack24Bytes[16] = {0, 1, 2,  0xff, 3, 4,  5,  0xff,
+                                            6, 7, 8,  0xff, 9, 10, 11, 0xff};
+  const uint8x16_t unpack24 = vld1q_u8(unpack24Bytes);
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t mask24 = vdupq_n_u32(0xffffff);
+  const float32x4_t maxValue = vdupq_n_f32(8388607.0f);
+  const float32x4_t minValue = vdupq_n_f32(-8388608.0f);
+  unsigned long i;
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    uint32x4_t sample;
+    if (sampleType == AM824_SAMPLE_16) {
+      sample = vshlq_n_u32(vmovl_u16(vld1_u16((const uint16_t*)(input + i * 2))),
+                           8);
+    } else if (sampleType == AM824_SAMPLE_32) {
+      sample = vshrq_n_u32(vld1q_u32((const uint32_t*)(input + i * 4)), 8);
+    } else if (sampleType == AM824_SAMPLE_FLOAT) {
+      // minnm and maxnm return the number for NaN, like am824FloatTo24()
+      float32x4_t value =
+          vmulq_n_f32(vld1q_f32((const float*)(input + i * 4)), 8388608.0f);
+      value = vmaxnmq_f32(vminnmq_f32(value, maxValue), minValue);
+      sample =
+          vandq_u32(vreinterpretq_u32_s32(vcvtnq_s32_f32(value)), mask24);
+    } else {
+      /* load 4 packed 24 bit samples without reading past them */
+      uint32_t tail;
+      memcpy(&tail, input + i * 3 + 8, sizeof(tail));
+      uint8x16_t bytes = vcombine_u8(vld1_u8(input + i * 3),
+                                     vreinterpret_u8_u32(vdup_n_u32(tail)));
+      sample = vreinterpretq_u32_u8(vqtbl1q_u8(bytes, unpack24));
+    }
+    uint32x4_t parity = veorq_u32(sample, vshrq_n_u32(sample, 16));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 8));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 4));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 2));
+    parity = veorq_u32(parity, vshrq_n_u32(parity, 1));
+    parity = vshlq_n_u32(vandq_u32(parity, one), 27);
+    uint32x4_t word =
+        veorq_u32(vorrq_u32(sample, vld1q_u32(flags + i)), parity);
+    uint8x16_t bytes = vreinterpretq_u8_u32(word);
+    if (bigEndian) {
+      bytes = vrev32q_u8(bytes);
+    }
+    vst1q_u8(output + i * 4, bytes);
+  }
+  return i;
+}
+#endif
+
+static inline AM824Kernel am824SelectKernel(void) {
+#if defined(AM824_SIMD_X86)
+  if (__builtin_cpu_supports("avx2")) {
+    return am824ConvertAVX2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return am824ConvertSSSE3;
+  }
+  return NULL;
+#elif defined(AM824_SIMD_NEON)
+  return am824ConvertNEON;
+#else
+  return NULL;
+#endif
+}
+
 class AM824Framer {
   uint8_t channelStatusIndex;
   uint8_t channelStatusMask;
-  uint8_t channelStatus[CHANNEL_STATUS_BYTES];
+  /* channel status block of every channel */
+  uint8_t* channelStatus;
   uint8_t subFrameCounter;
   uint8_t numChannels;
+  /* channels of each independent stream, the first carries the frame start */
+  uint8_t streamChannels;
   uint8_t bitDepth;
+  AM824SampleType sampleType;
   uint8_t crcTable[256];
   AM824Endianess endian;
+  /* per sample flags of a channel status block, see buildSchedule() */
+  uint32_t* schedule;
+  /* same flags ordered by channel, used for planar input */
+  uint32_t* planarSchedule;
+  AM824Kernel kernel;
 
   static uint8_t getParity(unsigned int n) {
     uint8_t parity = 0;
@@ -57,31 +401,106 @@ class AM824Framer {
     return parity;
   }
 
-  void crcTableInit(void) {
-    uint8_t remainder;
+  void crcTableInit(void) { am824CrcTableInit(crcTable); }
+
+  void setCRC(void) {
+    for (unsigned int channel = 0; channel < numChannels; channel++) {
+      uint8_t* status = channelStatus + channel * CHANNEL_STATUS_BYTES;
+      status[CHANNEL_STATUS_BYTES - 1] = am824ChannelStatusCRC(crcTable, status);
+    }
+    buildSchedule();
+  }
+
+  // Update a channel status byte of every channel
+  void updateChannelStatus(unsigned int byte, uint8_t keep, uint8_t set) {
+    for (unsigned int channel = 0; channel < numChannels; channel++) {
+      uint8_t* status = channelStatus + channel * CHANNEL_STATUS_BYTES;
+      status[byte] = (status[byte] & keep) | set;
+    }
+    setCRC();
+  }
+
+  /* Precompute the channel status, block start and frame start bits and
+   * their parity for every sample of a 192 frames channel status block */
+  void buildSchedule(void) {
+    unsigned int frame, channel;
+    uint32_t* flags = schedule;
 
-    for (int dividend = 0; dividend < 256; ++dividend) {
-      remainder = dividend << (WIDTH - 8);
-      for (uint8_t bit = 0; bit < 8; bit++) {
-        if (remainder & BOTTOMBIT) {
-          remainder = (remainder >> 1) ^ REFLECTED_POLYNOMIAL;
-        } else {
-          remainder = (remainder >> 1);
+    for (frame = 0; frame < CHANNEL_STATUS_FRAMES; frame++) {
+      for (channel = 0; channel < numChannels; channel++) {
+        const uint8_t* status = channelStatus + channel * CHANNEL_STATUS_BYTES;
+        uint32_t sampleFlags = ((status[frame / 8] >> (frame % 8)) & 1) << 26;
+        if (frame == 0) {
+          sampleFlags |= 1 << 29;
+        }
+        if (channel % streamChannels == 0) {
+          sampleFlags |= 1 << 28;
         }
+        sampleFlags |= am824Parity(sampleFlags) << 27;
+        planarSchedule[channel * CHANNEL_STATUS_FRAMES + frame] = sampleFlags;
+        *flags++ = sampleFlags;
       }
-      crcTable[dividend] = remainder;
     }
   }
 
-  void setCRC(void) {
-    uint8_t data;
-    uint8_t remainder = 0xff;
+  static void storeWord(uint32_t outputSample,
+                        bool bigEndian,
+                        uint8_t* outputBytes) {
+    if (bigEndian) {
+      outputBytes[0] = outputSample >> 24;
+      outputBytes[1] = outputSample >> 16;
+      outputBytes[2] = outputSample >> 8;
+      outputBytes[3] = outputSample;
+    } else {
+      outputBytes[0] = outputSample;
+      outputBytes[1] = outputSample >> 8;
+      outputBytes[2] = outputSample >> 16;
+      outputBytes[3] = outputSample >> 24;
+    }
+  }
 
-    for (int byte = 0; byte < 23; byte++) {
-      data = channelStatus[byte] ^ remainder;
-      remainder = crcTable[data];
+  // Convert count contiguous samples with the given flags
+  void convertRun(const uint8_t* inputBytes,
+                  uint8_t* outputBytes,
+                  unsigned long count,
+                  const uint32_t* flags) const {
+    bool bigEndian = (endian == AM824_BIG_ENDIAN);
+    unsigned long i = 0;
+
+    if (kernel) {
+      i = kernel(inputBytes, outputBytes, count, flags, sampleType, bigEndian);
+    }
+    for (; i < count; i++) {
+      storeWord(am824Word(am824LoadSample(inputBytes, i, sampleType), flags[i]),
+                bigEndian, outputBytes + i * 4);
     }
-    channelStatus[23] = remainder;
+  }
+
+  // Convert count samples starting at the sample position within the
+  // channel status block, returns the position after the last sample
+  unsigned int convertSamples(const uint8_t* inputBytes,
+                              uint8_t* outputBytes,
+                              unsigned long count,
+                              unsigned int position) const {
+    unsigned int inputBytesPerSample = am824SampleBytes(sampleType);
+    unsigned int blockSamples = CHANNEL_STATUS_FRAMES * numChannels;
+
+    while (count) {
+      // convert up to the end of the channel status block
+      unsigned long blockCount = blockSamples - position;
+      if (blockCount > count) {
+        blockCount = count;
+      }
+      convertRun(inputBytes, outputBytes, blockCount, schedule + position);
+      inputBytes += blockCount * inputBytesPerSample;
+      outputBytes += blockCount * 4;
+      count -= blockCount;
+      position += blockCount;
+      if (position == blockSamples) {
+        position = 0;
+      }
+    }
+    return position;
   }
 
  public:
@@ -94,13 +513,20 @@ class AM824Framer {
                               32 bit */
       AM824Endianess outputEndianess, /* Input = Endianess of output samples,
                                          input is always machine order */
-      AM824ErrorCode& err)            /* Output - error code */
+      AM824ErrorCode& err,            /* Output - error code */
+      AM824InputFormat inputFormat =
+          AM824_INPUT_PCM) /* Input - Integer or 32 bit float input */
   {
     uint8_t i;
     channelStatusIndex = 0;
     channelStatusMask = 1;
     numChannels = newNumChannels;
+    streamChannels = numChannels ? numChannels : 1;
     subFrameCounter = 0;
+    channelStatus = new uint8_t[CHANNEL_STATUS_BYTES * numChannels];
+    schedule = new uint32_t[CHANNEL_STATUS_FRAMES * numChannels];
+    planarSchedule = new uint32_t[CHANNEL_STATUS_FRAMES * numChannels];
+    kernel = am824SelectKernel();
 
     bitDepth = newBitDepth;
     endian = outputEndianess;
@@ -117,17 +543,29 @@ class AM824Framer {
     // 48kHz
     channelStatus[0] |= 2 << 6;
 
+    if (inputFormat == AM824_INPUT_FLOAT && bitDepth != 32) {
+      err = AM824_ERR_UNSUPPORTED_BITDEPTH;
+      return;
+    }
     switch (bitDepth) {
       case 16:
+        sampleType = AM824_SAMPLE_16;
         channelStatus[2] |= 1 << 3;
         break;
       case 20:
+        sampleType = AM824_SAMPLE_24;
         // Use of Auxillary bits
         channelStatus[2] |= 4;
         // 20 bit data
         channelStatus[2] |= 1 << 3;
         break;
       case 24:
+      case 32:
+        // 32 bit integer and float input are reduced to 24 bit
+        sampleType = bitDepth == 24 ? AM824_SAMPLE_24
+                                    : (inputFormat == AM824_INPUT_FLOAT
+                                           ? AM824_SAMPLE_FLOAT
+                                           : AM824_SAMPLE_32);
         // Use of Auxillary bits
         channelStatus[2] |= 4;
         // 24 bit data
@@ -137,62 +575,97 @@ class AM824Framer {
         err = AM824_ERR_UNSUPPORTED_BITDEPTH;
         return;
     }
+    // Same default channel status on every channel
+    for (i = 1; i < numChannels; i++) {
+      memcpy(channelStatus + i * CHANNEL_STATUS_BYTES, channelStatus,
+             CHANNEL_STATUS_BYTES);
+    }
     crcTableInit();
     setCRC();
     err = AM824_ERR_OK;
   }
 
+  ~AM824Framer() {
+    delete[] channelStatus;
+    delete[] schedule;
+    delete[] planarSchedule;
+  }
+
+  AM824Framer(const AM824Framer&) = delete;
+  AM824Framer& operator=(const AM824Framer&) = delete;
+
+  // The following setters change the channel status of every channel
   AM824ErrorCode setSamplingFrequency(AM824SamplingFrequency fs_code) {
     if (fs_code > FS_32000_HZ) {
       return (AM824_ERR_BAD_SAMPLING_FREQUENCY);
     }
     // Reset top two bits and set accordingly
-    channelStatus[0] &= 0x3f;
-    channelStatus[0] |= fs_code << 6;
-    setCRC();
+    updateChannelStatus(0, 0x3f, fs_code << 6);
     return (AM824_ERR_OK);
   }
 
-  void setProfessionalMode(void) {
-    channelStatus[0] |= 1;
-    setCRC();
-  }
+  void setProfessionalMode(void) { updateChannelStatus(0, 0xff, 1); }
+
+  void setConsumerMode(void) { updateChannelStatus(0, 0xfe, 0); }
 
-  void setConsumerMode(void) {
-    channelStatus[0] &= 0xfe;
+  void setAudioMode(void) { updateChannelStatus(0, 0xfd, 0); }
+
+  void setDataMode(void) { updateChannelStatus(0, 0xff, 2); }
+
+  // Set the channel status of count channels starting at channel, for
+  // example count 2 for an AES3 pair. The CRC byte is computed, only the
+  // first 23 bytes of status are used.
+  AM824ErrorCode setChannelStatus(uint8_t channel,
+                                  const uint8_t* status,
+                                  uint8_t count = 1) {
+    if (count == 0 || channel + count > numChannels) {
+      return (AM824_ERR_BAD_CHANNEL);
+    }
+    for (unsigned int i = channel; i < (unsigned int)channel + count; i++) {
+      memcpy(channelStatus + i * CHANNEL_STATUS_BYTES, status,
+             CHANNEL_STATUS_BYTES - 1);
+    }
     setCRC();
+    return (AM824_ERR_OK);
   }
 
-  void setAudioMode(void) {
-    channelStatus[0] &= 0xfd;
-    setCRC();
+  // Channel status block of the channel, including the CRC
+  const uint8_t* getChannelStatus(uint8_t channel) const {
+    return channelStatus + channel * CHANNEL_STATUS_BYTES;
   }
 
-  void setDataMode(void) {
-    channelStatus[0] |= 2;
-    setCRC();
+  // Split the channels in independent streams of the given number of
+  // channels, for example 2 for AES3 pairs. The first channel of every
+  // stream carries the frame start bit. By default all the channels are a
+  // single stream.
+  AM824ErrorCode setStreamChannels(uint8_t channels) {
+    if (channels == 0 || channels > numChannels) {
+      return (AM824_ERR_BAD_CHANNEL);
+    }
+    streamChannels = channels;
+    buildSchedule();
+    return (AM824_ERR_OK);
   }
 
+  // For float input inputSample is the bit pattern of the float
   void getAM824Sample(uint32_t inputSample, uint8_t* outputBytes) {
     uint32_t outputSample;
     bool channelStatusBit =
-        channelStatus[channelStatusIndex] & channelStatusMask;
+        channelStatus[subFrameCounter * CHANNEL_STATUS_BYTES +
+                      channelStatusIndex] &
+        channelStatusMask;
     bool userBit = false;
     bool validityBit = false;
 
     // Input samples are MSB justified as per AES3
-    if (bitDepth == 16) {
-      outputSample = inputSample << 8;
-    } else {
-      outputSample = inputSample;
-    }
+    outputSample = am824AlignSample(inputSample, sampleType);
 
     // Detect block start
     if ((channelStatusIndex == 0) && (channelStatusMask == 1)) {
       outputSample |= 1 << 29;
     }
     // Detect frame start
-    if (subFrameCounter == 0) {
+    if (subFrameCounter % streamChannels == 0) {
       outputSample |= 1 << 28;
     }
 
@@ -204,9 +677,8 @@ class AM824Framer {
     outputSample |= getParity(outputSample) << 27;
 
     // Now complete all the wraparound checks
-    // Note that channel status chan be different for the different subframes
-    // (channels) but in this example channel status is set to be the same for
-    // all subframes (channels)
+    // Note that channel status can be different for the different subframes
+    // (channels), see setChannelStatus()
     subFrameCounter++;
     if (subFrameCounter == numChannels) {
       subFrameCounter = 0;
@@ -236,6 +708,105 @@ class AM824Framer {
     }
   }
 
+  // Convert numFrames interleaved frames of input samples at once.
+  // Input samples are in machine order, 2 bytes per sample for 16 bit, 3
+  // packed bytes per sample for 20 and 24 bit and 4 bytes for 32 bit and
+  // float, output is always 32 bit.
+  // The output is bit exact with getAM824Sample() and the two can be mixed.
+  void getAM824Frames(const uint8_t* inputBytes,
+                      uint8_t* outputBytes,
+                      unsigned long numFrames) {
+    unsigned int frame = channelStatusIndex * 8;
+    unsigned int position;
+
+    for (uint8_t mask = channelStatusMask; mask > 1; mask >>= 1) {
+      frame++;
+    }
+    position = convertSamples(inputBytes, outputBytes, numFrames * numChannels,
+                              frame * numChannels + subFrameCounter);
+
+    // Store the position for the next call
+    frame = position / numChannels;
+    subFrameCounter = position % numChannels;
+    channelStatusIndex = frame / 8;
+    channelStatusMask = 1 << (frame % 8);
+  }
+
+  // Random access versions, the AM824 word only depends on the absolute
+  // frame index modulo the 192 frames channel status block, so these don't
+  // use or change the framer position and can be called concurrently to
+  // convert different parts of a file, to seek or to loop.
+  void getAM824SampleAt(uint32_t inputSample,
+                        uint64_t frameIndex,
+                        uint8_t channel,
+                        uint8_t* outputBytes) const {
+    uint32_t flags =
+        schedule[(frameIndex % CHANNEL_STATUS_FRAMES) * numChannels + channel];
+    // Input samples are MSB justified as per AES3
+    storeWord(am824Word(am824AlignSample(inputSample, sampleType), flags),
+              endian == AM824_BIG_ENDIAN, outputBytes);
+  }
+
+  void getAM824FramesAt(const uint8_t* inputBytes,
+                        uint8_t* outputBytes,
+                        unsigned long numFrames,
+                        uint64_t firstFrameIndex) const {
+    convertSamples(
+        inputBytes, outputBytes, numFrames * numChannels,
+        (firstFrameIndex % CHANNEL_STATUS_FRAMES) * numChannels);
+  }
+
+  // Planar (structure of arrays) input, inputChannels holds one buffer of
+  // numFrames samples per channel, the output is interleaved. Each channel
+  // is converted separately with the vector kernels, so many independent
+  // streams with their own channel status are framed in one pass.
+  void getAM824FramesPlanarAt(const uint8_t* const* inputChannels,
+                              uint8_t* outputBytes,
+                              unsigned long numFrames,
+                              uint64_t firstFrameIndex) const {
+    unsigned int inputBytesPerSample = am824SampleBytes(sampleType);
+    unsigned int frame = firstFrameIndex % CHANNEL_STATUS_FRAMES;
+    unsigned long done = 0;
+    /* converted words of a few frames of every channel, transposed to the
+     * interleaved output so that the output is written sequentially */
+    uint32_t words[AM824_PLANAR_FRAMES * 256];
+
+    while (done < numFrames) {
+      // convert up to the end of the channel status block
+      unsigned long tileFrames = CHANNEL_STATUS_FRAMES - frame;
+      if (tileFrames > AM824_PLANAR_FRAMES) {
+        tileFrames = AM824_PLANAR_FRAMES;
+      }
+      if (tileFrames > numFrames - done) {
+        tileFrames = numFrames - done;
+      }
+      for (unsigned int channel = 0; channel < numChannels; channel++) {
+        convertRun(inputChannels[channel] + done * inputBytesPerSample,
+                   (uint8_t*)(words + channel * AM824_PLANAR_FRAMES),
+                   tileFrames,
+                   planarSchedule + channel * CHANNEL_STATUS_FRAMES + frame);
+      }
+      uint8_t* output = outputBytes + done * numChannels * 4;
+      for (unsigned long i = 0; i < tileFrames; i++) {
+        for (unsigned int channel = 0; channel < numChannels; channel++) {
+          memcpy(output, words + channel * AM824_PLANAR_FRAMES + i, 4);
+          output += 4;
+        }
+      }
+      done += tileFrames;
+      frame = (frame + tileFrames) % CHANNEL_STATUS_FRAMES;
+    }
+  }
+
+  // Move the position used by getAM824Sample() and getAM824Frames() to the
+  // beginning of the frame with the given absolute index
+  void seek(uint64_t frameIndex) {
+    unsigned int frame = frameIndex % CHANNEL_STATUS_FRAMES;
+    subFrameCounter = 0;
+    channelStatusIndex = frame / 8;
+    channelStatusMask = 1 << (frame % 8);
+  }
+
   /* Simple test code to check CRC implementation */
   /* See EBU Tech 3250 or AES3 for the reference for these examples */
   void testCRC(void) {
@@ -265,4 +836,6 @@ class AM824Framer {
              channelStatus[23]);
     }
   }
-};
\ No newline at end of file
+};
+
+#endif
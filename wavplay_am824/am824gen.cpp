@@ -0,0 +1,232 @@
+/************************************************************************************************************
+ * WavPlay AM824
+ * Copyright (C) 2020, Dolby Laboratories Inc.
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ ************************************************************************************************************/
+
+/* Generates AM824 (L32) test material for a multichannel configuration, for
+ * example 64 channels, framed as independent streams (AES3 pairs by
+ * default) each with its own channel status carrying the channel number.
+ * Every channel plays a different tone. */
+
+#define VERSION_STRING "1.0"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <chrono>
+#include "am824_framer.h"
+
+/* Frames generated and framed at once */
+#define CHUNK_FRAMES 4800
+
+typedef enum {
+  ERR_FILE_NOT_FOUND = -101,
+  ERR_BAD_CMD_OPTION,
+  ERR_NO_MEMORY,
+  ERR_WRITE_FAILED,
+  ERR_OK = 0
+} ErrorCode;
+
+void throwError(ErrorCode err, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  fprintf(stderr, "***Error: ");
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+  fflush(stderr);
+  exit(err);
+}
+
+void print_usage(void) {
+  fprintf(stderr, "am824gen [OPTION]... <OUTPUT FILE> v%s\n", VERSION_STRING);
+  fprintf(stderr,
+          "Copyright Dolby Laboratories Inc., 2020. All rights reserved.\n\n");
+  fprintf(stderr, "-h                   Display this messgage\n");
+  fprintf(stderr, "-c <channels>        Number of channels, default 64\n");
+  fprintf(stderr,
+          "-s <channels>        Channels of each independent stream, default "
+          "2\n");
+  fprintf(stderr,
+          "-r <rate>            Sample rate 32000, 44100 or 48000, default "
+          "48000\n");
+  fprintf(stderr, "-t <seconds>         Duration, default 10\n");
+  fprintf(stderr, "-be                  Write big endian samples\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr,
+          "The output is a raw file of 32 bit AM824 samples, channel n plays "
+          "a tone at 100 * (n + 1) Hz\n");
+}
+
+int main(int argc, char* argv[]) {
+  char outputFileName[256] = "";
+  unsigned int numChannels = 64;
+  unsigned int streamChannels = 2;
+  unsigned int rate = 48000;
+  double duration = 10.0;
+  AM824Endianess endian = AM824_LITTLE_ENDIAN;
+  AM824SamplingFrequency fs;
+  AM824ErrorCode err;
+  FILE* outputFile;
+  float* planar;
+  const uint8_t* inputChannels[256];
+  uint8_t* output;
+  double *phase, *step;
+  uint64_t totalFrames, frame;
+  unsigned int channel;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if ((argv[i][0] != '-') && (strlen(outputFileName) == 0)) {
+      strncpy(outputFileName, argv[i], sizeof(outputFileName) - 1);
+    } else if (!strcmp(argv[i], "-c")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find number of channels");
+      }
+      numChannels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-s")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find channels per stream");
+      }
+      streamChannels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-r")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find sample rate");
+      }
+      rate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-t")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find duration");
+      }
+      duration = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-be")) {
+      endian = AM824_BIG_ENDIAN;
+    } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help") ||
+               !strcmp(argv[i], "--help")) {
+      print_usage();
+      exit(0);
+    } else {
+      print_usage();
+      throwError(ERR_BAD_CMD_OPTION, "Option %s not recognized", argv[i]);
+    }
+  }
+  if (strlen(outputFileName) == 0) {
+    print_usage();
+    throwError(ERR_BAD_CMD_OPTION, "No output file specified");
+  }
+  // the channel number is a 7 bit field of the channel status
+  if (numChannels == 0 || numChannels > 128) {
+    throwError(ERR_BAD_CMD_OPTION, "Unsupported number of channels %u",
+               numChannels);
+  }
+  switch (rate) {
+    case 32000:
+      fs = FS_32000_HZ;
+      break;
+    case 44100:
+      fs = FS_44100_HZ;
+      break;
+    case 48000:
+      fs = FS_48000_HZ;
+      break;
+    default:
+      throwError(ERR_BAD_CMD_OPTION, "Unsupported sample rate %u", rate);
+  }
+
+  AM824Framer framer(numChannels, 32, endian, err, AM824_INPUT_FLOAT);
+  if (err != AM824_ERR_OK) {
+    throwError(ERR_BAD_CMD_OPTION, "AM824 framer initialization failed (%d)",
+               err);
+  }
+  framer.setAudioMode();
+  framer.setProfessionalMode();
+  framer.setSamplingFrequency(fs);
+  if (framer.setStreamChannels(streamChannels) != AM824_ERR_OK) {
+    throwError(ERR_BAD_CMD_OPTION, "Unsupported channels per stream %u",
+               streamChannels);
+  }
+  // Channel number in byte 3 of the channel status (multichannel mode)
+  for (channel = 0; channel < numChannels; channel++) {
+    uint8_t status[CHANNEL_STATUS_BYTES];
+    memcpy(status, framer.getChannelStatus(channel), sizeof(status));
+    status[3] = 0x80 | channel;
+    framer.setChannelStatus(channel, status);
+  }
+
+  outputFile = fopen(outputFileName, "wb");
+  if (!outputFile) {
+    throwError(ERR_FILE_NOT_FOUND, "Can't create %s", outputFileName);
+  }
+  planar = (float*)malloc(sizeof(float) * CHUNK_FRAMES * numChannels);
+  output = (uint8_t*)malloc(CHUNK_FRAMES * numChannels * 4);
+  phase = (double*)malloc(sizeof(double) * numChannels * 2);
+  if (!planar || !output || !phase) {
+    throwError(ERR_NO_MEMORY, "Memory allocation failed");
+  }
+  step = phase + numChannels;
+  for (channel = 0; channel < numChannels; channel++) {
+    inputChannels[channel] = (const uint8_t*)(planar + channel * CHUNK_FRAMES);
+    phase[channel] = 0;
+    step[channel] = 2 * M_PI * 100.0 * (channel + 1) / rate;
+  }
+
+  totalFrames = (uint64_t)(duration * rate);
+  printf("Generating %llu frames of %u channels, %u channels per stream\n",
+         (unsigned long long)totalFrames, numChannels, streamChannels);
+  auto startTime = std::chrono::steady_clock::now();
+  for (frame = 0; frame < totalFrames; frame += CHUNK_FRAMES) {
+    unsigned long frames = CHUNK_FRAMES;
+    if (frames > totalFrames - frame) {
+      frames = totalFrames - frame;
+    }
+    // one buffer per channel, the framer interleaves them. The tone uses
+    // the sin(x + step) = 2 cos(step) sin(x) - sin(x - step) recurrence
+    // restarted from the exact phase at every chunk.
+    for (channel = 0; channel < numChannels; channel++) {
+      float* samples = planar + channel * CHUNK_FRAMES;
+      double k = 2 * cos(step[channel]);
+      double previous = sin(phase[channel] - step[channel]);
+      double current = sin(phase[channel]);
+      for (unsigned long n = 0; n < frames; n++) {
+        double next = k * current - previous;
+        samples[n] = 0.5f * (float)current;
+        previous = current;
+        current = next;
+      }
+      phase[channel] = fmod(phase[channel] + step[channel] * frames, 2 * M_PI);
+    }
+    framer.getAM824FramesPlanarAt(inputChannels, output, frames, frame);
+    if (fwrite(output, numChannels * 4, frames, outputFile) != frames) {
+      throwError(ERR_WRITE_FAILED, "Failed writing to %s", outputFileName);
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+  printf("Done in %.2f seconds\n", seconds);
+
+  fclose(outputFile);
+  free(planar);
+  free(output);
+  free(phase);
+  return ERR_OK;
+}
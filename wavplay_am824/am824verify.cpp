@@ -0,0 +1,288 @@
+/************************************************************************************************************
+ * WavPlay AM824
+ * Copyright (C) 2020, Dolby Laboratories Inc.
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ ************************************************************************************************************/
+
+/* Verifies an AM824 (L32) capture, for example recorded from the RAVENNA
+ * capture device with arecord -f S32_LE, checking parity, frame and block
+ * starts and channel status CRC of every channel */
+
+#define VERSION_STRING "1.0"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "am824_deframer.h"
+
+/* Frames validated at once, the PCM output is written per chunk */
+#define CHUNK_FRAMES 65536
+
+typedef enum {
+  ERR_FILE_NOT_FOUND = -101,
+  ERR_BAD_INPUT_FILE,
+  ERR_BAD_CMD_OPTION,
+  ERR_NO_MEMORY,
+  ERR_WRITE_FAILED,
+  ERR_VERIFY_FAILED = 1,
+  ERR_OK = 0
+} ErrorCode;
+
+static const char* errorNames[AM824_DEFRAMER_ERROR_TYPES] = {
+    "parity", "frame start", "block start", "channel status CRC"};
+
+void throwError(ErrorCode err, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  fprintf(stderr, "***Error: ");
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+  fflush(stderr);
+  exit(err);
+}
+
+static uint32_t read_le32(const unsigned char* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Locate the data chunk of a wav file and read the number of channels,
+ * returns 0 if the file is not a wav file */
+int find_wav_data(const unsigned char* file,
+                  size_t fileSize,
+                  size_t* dataOffset,
+                  size_t* dataSize,
+                  unsigned int* numChannels) {
+  size_t offset = 12;
+
+  if (fileSize < 12 || memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+    return 0;
+  }
+  while (offset + 8 <= fileSize) {
+    uint32_t chunkSize = read_le32(file + offset + 4);
+    if (!memcmp(file + offset, "fmt ", 4) && offset + 12 <= fileSize) {
+      *numChannels = file[offset + 10] | (file[offset + 11] << 8);
+    } else if (!memcmp(file + offset, "data", 4)) {
+      *dataOffset = offset + 8;
+      *dataSize = fileSize - *dataOffset;
+      if (chunkSize < *dataSize) {
+        *dataSize = chunkSize;
+      }
+      return 1;
+    }
+    offset += 8 + chunkSize + (chunkSize & 1);
+  }
+  throwError(ERR_BAD_INPUT_FILE, "Wav file without data chunk");
+  return 0;
+}
+
+void print_usage(void) {
+  fprintf(stderr, "am824verify [OPTION]... <CAPTURE FILE> v%s\n",
+          VERSION_STRING);
+  fprintf(stderr,
+          "Copyright Dolby Laboratories Inc., 2020. All rights reserved.\n\n");
+  fprintf(stderr, "-h                   Display this messgage\n");
+  fprintf(stderr,
+          "-c <channels>        Number of channels of a raw capture, default "
+          "2\n");
+  fprintf(stderr,
+          "-s <channels>        Channels of each independent stream, default "
+          "all\n");
+  fprintf(stderr, "-be                  Samples are big endian\n");
+  fprintf(stderr,
+          "-o <file>            Write the extracted PCM samples (S24_3LE)\n");
+  fprintf(stderr,
+          "-e <errors>          Number of error positions to report, default "
+          "16\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr,
+          "The capture file can be a raw file or a wav file containing 32 "
+          "bit AM824 samples\n");
+}
+
+int main(int argc, char* argv[]) {
+  char captureFileName[256] = "";
+  const char* pcmFileName = NULL;
+  unsigned int numChannels = 2;
+  unsigned int streamChannels = 0;
+  unsigned long maxErrors = 16;
+  AM824Endianess endian = AM824_LITTLE_ENDIAN;
+  FILE* pcmFile = NULL;
+  unsigned char* pcm = NULL;
+  const unsigned char* file;
+  const unsigned char* data;
+  size_t fileSize, dataOffset = 0, dataSize;
+  uint64_t totalFrames, frame;
+  struct stat st;
+  int fd, i;
+
+  for (i = 1; i < argc; i++) {
+    if ((argv[i][0] != '-') && (strlen(captureFileName) == 0)) {
+      strncpy(captureFileName, argv[i], sizeof(captureFileName) - 1);
+    } else if (!strcmp(argv[i], "-c")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find number of channels");
+      }
+      numChannels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-s")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find channels per stream");
+      }
+      streamChannels = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-be")) {
+      endian = AM824_BIG_ENDIAN;
+    } else if (!strcmp(argv[i], "-o")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find PCM output file");
+      }
+      pcmFileName = argv[++i];
+    } else if (!strcmp(argv[i], "-e")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find number of errors");
+      }
+      maxErrors = atol(argv[++i]);
+    } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help") ||
+               !strcmp(argv[i], "--help")) {
+      print_usage();
+      exit(0);
+    } else {
+      print_usage();
+      throwError(ERR_BAD_CMD_OPTION, "Option %s not recognized", argv[i]);
+    }
+  }
+  if (strlen(captureFileName) == 0) {
+    print_usage();
+    throwError(ERR_BAD_CMD_OPTION, "No capture file specified");
+  }
+
+  fd = open(captureFileName, O_RDONLY);
+  if (fd < 0) {
+    throwError(ERR_FILE_NOT_FOUND, "File %s not found", captureFileName);
+  }
+  if (fstat(fd, &st)) {
+    throwError(ERR_BAD_INPUT_FILE, "Can't stat %s", captureFileName);
+  }
+  fileSize = st.st_size;
+  if (fileSize == 0) {
+    throwError(ERR_BAD_INPUT_FILE, "File %s is empty", captureFileName);
+  }
+  file = (const unsigned char*)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE,
+                                    fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    throwError(ERR_BAD_INPUT_FILE, "Can't map %s", captureFileName);
+  }
+  madvise((void*)file, fileSize, MADV_SEQUENTIAL);
+
+  dataSize = fileSize;
+  if (find_wav_data(file, fileSize, &dataOffset, &dataSize, &numChannels)) {
+    printf("Wav file, data chunk at offset %zu\n", dataOffset);
+  }
+  if (numChannels == 0 || numChannels > 255) {
+    throwError(ERR_BAD_CMD_OPTION, "Unsupported number of channels %u",
+               numChannels);
+  }
+  data = file + dataOffset;
+  totalFrames = dataSize / (numChannels * 4);
+
+  if (pcmFileName) {
+    pcmFile = fopen(pcmFileName, "wb");
+    pcm = (unsigned char*)malloc(CHUNK_FRAMES * numChannels * 3);
+    if (!pcmFile) {
+      throwError(ERR_FILE_NOT_FOUND, "Can't create %s", pcmFileName);
+    }
+    if (!pcm) {
+      throwError(ERR_NO_MEMORY, "Memory allocation failed");
+    }
+  }
+
+  printf("Verifying %llu frames of %u channels\n",
+         (unsigned long long)totalFrames, numChannels);
+  fflush(stdout);
+
+  AM824Deframer deframer(numChannels, endian, maxErrors);
+  if (streamChannels &&
+      deframer.setStreamChannels(streamChannels) != AM824_ERR_OK) {
+    throwError(ERR_BAD_CMD_OPTION, "Unsupported channels per stream %u",
+               streamChannels);
+  }
+  auto startTime = std::chrono::steady_clock::now();
+  for (frame = 0; frame < totalFrames; frame += CHUNK_FRAMES) {
+    unsigned long frames = CHUNK_FRAMES;
+    if (frames > totalFrames - frame) {
+      frames = totalFrames - frame;
+    }
+    deframer.processFrames(data + frame * numChannels * 4, pcm, frames);
+    if (pcmFile &&
+        fwrite(pcm, numChannels * 3, frames, pcmFile) != frames) {
+      throwError(ERR_WRITE_FAILED, "Failed writing to %s", pcmFileName);
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+  printf("Frames: %llu, blocks checked: %llu, %.1f MB/s\n",
+         (unsigned long long)deframer.getFramesProcessed(),
+         (unsigned long long)deframer.getBlocksChecked(),
+         seconds > 0 ? totalFrames * numChannels * 4 / seconds / 1e6 : 0.0);
+  for (i = 0; i < AM824_DEFRAMER_ERROR_TYPES; i++) {
+    printf("%s errors: %llu\n", errorNames[i],
+           (unsigned long long)deframer.getErrorCount(
+               (AM824DeframerErrorType)i));
+  }
+
+  unsigned long numErrors;
+  const AM824DeframerError* errors = deframer.getErrors(numErrors);
+  for (unsigned long n = 0; n < numErrors; n++) {
+    printf("  %s error at frame %llu channel %u\n", errorNames[errors[n].type],
+           (unsigned long long)errors[n].frameIndex, errors[n].channel);
+  }
+  if (deframer.getBlocksChecked()) {
+    const uint8_t* status = deframer.getChannelStatus(0);
+    printf("Channel 0 status:");
+    for (i = 0; i < CHANNEL_STATUS_BYTES; i++) {
+      printf(" %02x", status[i]);
+    }
+    printf("\n");
+  }
+
+  if (pcmFile) {
+    fclose(pcmFile);
+    free(pcm);
+  }
+  munmap((void*)file, fileSize);
+
+  if (!deframer.getBlocksChecked()) {
+    printf("Result: no AM824 block start found\n");
+    return ERR_VERIFY_FAILED;
+  }
+  if (deframer.getErrorCount()) {
+    printf("Result: failed\n");
+    return ERR_VERIFY_FAILED;
+  }
+  printf("Result: OK\n");
+  return ERR_OK;
+}
@@ -6,4 +6,5 @@
 sudo apt update
 sudo apt-get install -y libsndfile1-dev
 sudo apt-get install -y libportaudio2
+sudo apt-get install -y libasound2-dev
 sudo apt-get install -y sox
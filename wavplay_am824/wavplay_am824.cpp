@@ -21,11 +21,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "portaudio.h"
 #include "am824_framer.h"
 
 #if defined(__linux__)
 #include "pa_linux_alsa.h"
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -41,6 +47,10 @@
 #endif
 #else
 #include <sndfile.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 typedef enum {
@@ -62,17 +72,34 @@ typedef enum {
   ERR_OK = 0
 } ErrorCode;
 
+/* Single producer single consumer ring buffer between the reader thread and
+ * the PortAudio callback. The counters only increase, the position in the
+ * buffer is the counter modulo the size. */
 typedef struct {
-  unsigned long frameIndex; /* Index into sample array. */
+  unsigned char* buffer;
+  uint64_t size;
+  std::atomic<uint64_t> readCount;  /* Bytes consumed by the callback */
+  std::atomic<uint64_t> writeCount; /* Bytes produced by the reader */
+} RingBuffer;
+
+typedef struct {
+  unsigned long frameIndex; /* Index into mapped sample array. */
   unsigned long maxFrameIndex;
+  std::atomic<unsigned long> framesPlayed;
+  unsigned int loop; /* Restart from the beginning at the end of file */
   unsigned int numChannels;
   unsigned int bytesPerSample;
-  unsigned char* audio;
   FileFormat waveFileFormat;
   unsigned int bitsPerSample;
   unsigned int fs;
   unsigned int blockAlign;
   unsigned long totalBytes;
+  unsigned int fileBlockAlign; /* Block align of the file, before AM824 */
+  unsigned long fileBytesLeft;
+  unsigned long fileDataOffset; /* Offset of the data chunk in the file */
+  const unsigned char* audio; /* Mapped PCM samples, NULL if streaming */
+  void* mapAddr;
+  size_t mapSize;
 #if defined(_WIN32) || defined(_WIN64)
   HMMIO waveFile;
 #else
@@ -82,8 +109,27 @@ typedef struct {
   AM824SamplingFrequency am824_fs;
   unsigned int am824_fs_match_wavfile;
   unsigned int am824_professional;
+  unsigned int am824_stream_channels; /* 0 if all channels are one stream */
+  AM824Framer* framer;
+  RingBuffer ring;
+  unsigned long framesPerChunk; /* Frames read and converted at once */
+  std::atomic<int> readerDone;
+  std::atomic<int> stopReader;
+  std::atomic<unsigned long> underruns;
 } UserData;
 
+#if defined(__linux__)
+/* Native ALSA output, the PortAudio callbacks fill the mmap areas directly */
+typedef struct {
+  snd_pcm_t* pcm;
+  snd_pcm_uframes_t periodFrames;
+  snd_pcm_uframes_t bufferFrames;
+  int rtPriority; /* SCHED_FIFO priority of the playback thread, 0 if none */
+  std::atomic<unsigned long> xruns;
+  std::atomic<int> done;
+} AlsaOutput;
+#endif
+
 void throwError(ErrorCode err, const char* format, ...) {
   va_list args;
   va_start(args, format);
@@ -96,6 +142,53 @@ void throwError(ErrorCode err, const char* format, ...) {
   exit(err);
 }
 
+int ringInit(RingBuffer* ring, uint64_t size) {
+  ring->buffer = (unsigned char*)malloc(size);
+  ring->size = size;
+  ring->readCount = 0;
+  ring->writeCount = 0;
+  return ring->buffer != NULL;
+}
+
+uint64_t ringFreeBytes(RingBuffer* ring) {
+  return ring->size - (ring->writeCount.load(std::memory_order_relaxed) -
+                       ring->readCount.load(std::memory_order_acquire));
+}
+
+/* Called by the reader only, the caller checks that there is enough space */
+void ringWrite(RingBuffer* ring, const unsigned char* src, uint64_t bytes) {
+  uint64_t writeCount = ring->writeCount.load(std::memory_order_relaxed);
+  uint64_t offset = writeCount % ring->size;
+  uint64_t firstPart = ring->size - offset;
+
+  if (firstPart > bytes) {
+    firstPart = bytes;
+  }
+  memcpy(ring->buffer + offset, src, firstPart);
+  memcpy(ring->buffer, src + firstPart, bytes - firstPart);
+  ring->writeCount.store(writeCount + bytes, std::memory_order_release);
+}
+
+/* Called by the callback only, returns the number of bytes read */
+uint64_t ringRead(RingBuffer* ring, unsigned char* dst, uint64_t bytes) {
+  uint64_t readCount = ring->readCount.load(std::memory_order_relaxed);
+  uint64_t available =
+      ring->writeCount.load(std::memory_order_acquire) - readCount;
+  uint64_t offset = readCount % ring->size;
+  uint64_t firstPart = ring->size - offset;
+
+  if (bytes > available) {
+    bytes = available;
+  }
+  if (firstPart > bytes) {
+    firstPart = bytes;
+  }
+  memcpy(dst, ring->buffer + offset, firstPart);
+  memcpy(dst + firstPart, ring->buffer, bytes - firstPart);
+  ring->readCount.store(readCount + bytes, std::memory_order_release);
+  return bytes;
+}
+
 /* This is the main callback functioned called by PortAudio. It is registered
  * when the stream is created */
 
@@ -106,39 +199,68 @@ static int playCallback(const void* inputBuffer,
                         PaStreamCallbackFlags statusFlags,
                         void* userData) {
   UserData* data = (UserData*)userData;
-  unsigned char* rptr =
-      &data->audio[data->frameIndex * data->numChannels * data->bytesPerSample];
   unsigned char* wptr = (unsigned char*)outputBuffer;
-  unsigned int i;
-  int finished;
-  unsigned int framesLeft = data->maxFrameIndex - data->frameIndex;
+  uint64_t bytes = framesPerBuffer * data->blockAlign;
+  uint64_t bytesRead;
+  /* Check before reading, if set all the audio is already in the ring */
+  int readerDone = data->readerDone.load(std::memory_order_acquire);
+
+  (void)inputBuffer; /* Prevent unused variable warnings. */
+  (void)timeInfo;
+  (void)statusFlags;
+
+  bytesRead = ringRead(&data->ring, wptr, bytes);
+  data->framesPlayed += bytesRead / data->blockAlign;
+  if (bytesRead < bytes) {
+    memset(wptr + bytesRead, 0, bytes - bytesRead);
+    if (readerDone) {
+      /* final buffer... */
+      return paComplete;
+    }
+    data->underruns++;
+  }
+  return paContinue;
+}
+
+/* Callback used when the PCM samples are memory mapped, the samples are
+ * copied directly from the mapped file */
+
+static int playMappedCallback(const void* inputBuffer,
+                              void* outputBuffer,
+                              unsigned long framesPerBuffer,
+                              const PaStreamCallbackTimeInfo* timeInfo,
+                              PaStreamCallbackFlags statusFlags,
+                              void* userData) {
+  UserData* data = (UserData*)userData;
+  unsigned char* wptr = (unsigned char*)outputBuffer;
+  unsigned long framesLeft;
 
   (void)inputBuffer; /* Prevent unused variable warnings. */
   (void)timeInfo;
   (void)statusFlags;
-  (void)userData;
 
-  if (framesLeft < framesPerBuffer) {
-    /* final buffer... */
-    for (i = 0; i < framesLeft * data->numChannels * data->bytesPerSample;
-         i++) {
-      *wptr++ = *rptr++;
+  while (framesPerBuffer) {
+    framesLeft = data->maxFrameIndex - data->frameIndex;
+    if (framesLeft == 0) {
+      if (!data->loop || !data->maxFrameIndex) {
+        /* final buffer... */
+        memset(wptr, 0, framesPerBuffer * data->blockAlign);
+        return paComplete;
+      }
+      data->frameIndex = 0;
+      continue;
     }
-    for (; i < framesPerBuffer * data->numChannels * data->bytesPerSample;
-         i++) {
-      *wptr++ = 0;
+    if (framesLeft > framesPerBuffer) {
+      framesLeft = framesPerBuffer;
     }
+    memcpy(wptr, data->audio + data->frameIndex * data->blockAlign,
+           framesLeft * data->blockAlign);
+    wptr += framesLeft * data->blockAlign;
     data->frameIndex += framesLeft;
-    finished = paComplete;
-  } else {
-    for (i = 0; i < framesPerBuffer * data->numChannels * data->bytesPerSample;
-         i++) {
-      *wptr++ = *rptr++;
-    }
-    data->frameIndex += framesPerBuffer;
-    finished = paContinue;
+    data->framesPlayed += framesLeft;
+    framesPerBuffer -= framesLeft;
   }
-  return finished;
+  return paContinue;
 }
 
 /* Two versions of the following two functions exist, one for Windows and one
@@ -192,6 +314,7 @@ int read_wav_file_header(char* playbackWaveFile, /* Input file name string */
   outputData->fs = format->Format.nSamplesPerSec;
   outputData->numChannels = format->Format.nChannels;
   outputData->totalBytes = mmckinfoSubchunk.cksize;
+  outputData->fileDataOffset = mmckinfoSubchunk.dwDataOffset;
   outputData->bitsPerSample = format->Format.wBitsPerSample;
   outputData->bytesPerSample = outputData->bitsPerSample / 8;
   outputData->blockAlign = format->Format.nBlockAlign;
@@ -204,7 +327,7 @@ int read_wav_file_header(char* playbackWaveFile, /* Input file name string */
     if (format->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) {
       outputData->waveFileFormat = FF_PCM;
     } else if (format->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
-      outputData->waveFileFormat == FF_FLOAT32;
+      outputData->waveFileFormat = FF_FLOAT32;
     } else {
       throwError(ERR_NOT_SUPPORTED,
                  "Error: Unsupported WAVEFORMAT EXTENSIBLE SUBTYPE!");
@@ -214,24 +337,41 @@ int read_wav_file_header(char* playbackWaveFile, /* Input file name string */
   return (0);
 }
 
-unsigned long read_entire_wav_file(
+unsigned long read_wav_file_chunk(
     UserData* outputData, /* Input options*/
-    void* audioData)      /* Output data read form file */
+    void* audioData,      /* Output data read form file */
+    unsigned long bytes)  /* Input max bytes to read */
 {
-  unsigned long readCount;
-
-  readCount =
-      mmioRead(outputData->waveFile, (char*)audioData, outputData->totalBytes);
+  LONG readCount;
 
-  mmioClose(outputData->waveFile, 0);
-
-  if (readCount != outputData->totalBytes) {
+  if (bytes > outputData->fileBytesLeft) {
+    bytes = outputData->fileBytesLeft;
+  }
+  readCount = mmioRead(outputData->waveFile, (char*)audioData, bytes);
+  if (readCount < 0) {
     throwError(ERR_INCOMPLETE_INPUT_FILE,
-               "Failed to read all of audio data in wave file");
+               "Failed to read audio data in wave file");
   }
+  outputData->fileBytesLeft -= readCount;
   return (readCount);
 }
 
+void seek_wav_file(UserData* outputData, /* Input options */
+                   unsigned long frame)  /* Input frame to read next */
+{
+  if (mmioSeek(outputData->waveFile,
+               outputData->fileDataOffset + frame * outputData->fileBlockAlign,
+               SEEK_SET) < 0) {
+    throwError(ERR_BAD_INPUT_FILE, "Failed to seek in wave file");
+  }
+  outputData->fileBytesLeft =
+      (outputData->maxFrameIndex - frame) * outputData->fileBlockAlign;
+}
+
+void close_wav_file(UserData* outputData) {
+  mmioClose(outputData->waveFile, 0);
+}
+
 #else
 int read_wav_file_header(char* playbackWaveFile, /* Input filename string */
                          UserData* outputData)   /* Output options */
@@ -285,21 +425,105 @@ int read_wav_file_header(char* playbackWaveFile, /* Input filename string */
   return (0);
 }
 
-unsigned long read_entire_wav_file(
+unsigned long read_wav_file_chunk(
     UserData* outputData, /* Input Options */
-    void* audioData)      /* Output Audio data from file */
+    void* audioData,      /* Output Audio data from file */
+    unsigned long bytes)  /* Input max bytes to read */
 {
-  unsigned long readCount;
+  sf_count_t readCount;
 
-  readCount =
-      sf_read_raw(outputData->waveFile, audioData, outputData->totalBytes);
-  if (readCount != outputData->totalBytes) {
+  if (bytes > outputData->fileBytesLeft) {
+    bytes = outputData->fileBytesLeft;
+  }
+  readCount = sf_read_raw(outputData->waveFile, audioData, bytes);
+  if (readCount < 0) {
     throwError(ERR_INCOMPLETE_INPUT_FILE,
-               "Failed to read all of audio data in wave file");
+               "Failed to read audio data in wave file");
   }
+  outputData->fileBytesLeft -= readCount;
   return (readCount);
 }
 
+void seek_wav_file(UserData* outputData, /* Input options */
+                   unsigned long frame)  /* Input frame to read next */
+{
+  if (sf_seek(outputData->waveFile, frame, SEEK_SET) < 0) {
+    throwError(ERR_BAD_INPUT_FILE, "Failed to seek in wave file");
+  }
+  outputData->fileBytesLeft =
+      (outputData->maxFrameIndex - frame) * outputData->fileBlockAlign;
+}
+
+void close_wav_file(UserData* outputData) {
+  sf_close(outputData->waveFile);
+  if (outputData->mapAddr) {
+    munmap(outputData->mapAddr, outputData->mapSize);
+  }
+}
+
+static uint32_t read_le32(const unsigned char* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Map the wav file in memory and locate the data chunk, the header has
+ * already been validated by read_wav_file_header().
+ * Returns 0 on success, the caller falls back to streaming on failure */
+int map_wav_file_data(char* playbackWaveFile, /* Input filename string */
+                      UserData* outputData)   /* Output options */
+{
+  struct stat st;
+  const unsigned char* file;
+  size_t offset = 12;
+  int fd;
+
+  fd = open(playbackWaveFile, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) || st.st_size < 12) {
+    close(fd);
+    return -1;
+  }
+  outputData->mapSize = st.st_size;
+  outputData->mapAddr =
+      mmap(NULL, outputData->mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (outputData->mapAddr == MAP_FAILED) {
+    outputData->mapAddr = NULL;
+    return -1;
+  }
+  file = (const unsigned char*)outputData->mapAddr;
+  if (memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4)) {
+    munmap(outputData->mapAddr, outputData->mapSize);
+    outputData->mapAddr = NULL;
+    return -1;
+  }
+
+  // Walk the chunks, every chunk is padded to an even size
+  while (offset + 8 <= outputData->mapSize) {
+    uint32_t chunkSize = read_le32(file + offset + 4);
+    if (!memcmp(file + offset, "data", 4)) {
+      unsigned long dataBytes = outputData->mapSize - (offset + 8);
+      if (chunkSize < dataBytes) {
+        dataBytes = chunkSize;
+      }
+      if (dataBytes < outputData->totalBytes) {
+        outputData->totalBytes =
+            dataBytes - (dataBytes % outputData->blockAlign);
+      }
+      outputData->audio = file + offset + 8;
+      // Let the kernel read ahead since the file is played sequentially
+      madvise(outputData->mapAddr, outputData->mapSize, MADV_SEQUENTIAL);
+      return 0;
+    }
+    offset += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  munmap(outputData->mapAddr, outputData->mapSize);
+  outputData->mapAddr = NULL;
+  return -1;
+}
+
 #endif
 
 unsigned int countBits(unsigned int a) {
@@ -311,29 +535,26 @@ unsigned int countBits(unsigned int a) {
   return (count);
 }
 
-/* This function takes standard PCM audio plus channel status options and
- * creates the samples for AM824 format */
+/* This function creates the framer used to convert standard PCM audio to
+ * AM824 format according to the channel status options and updates the
+ * output format, always 32bit */
 
-void am824Convert(UserData* userData, /* Input options */
-                  void* audio,        /* Input PCM samples */
-                  void** am824audio)  /* Output AM824 samples, always 32bit */
+void am824Setup(UserData* userData) /* Input/Output options */
 {
-  unsigned long bytesConverted = 0;
-  uint32_t inputSample32;
-  uint16_t inputSample16;
-  uint8_t* inputPtr;
-  uint32_t* outputPtr;
-  unsigned int channel;
-  unsigned long outputMemSize;
   AM824ErrorCode err;
 
-  if ((userData->bytesPerSample != 3) && (userData->bytesPerSample != 2)) {
+  if ((userData->bytesPerSample < 2) || (userData->bytesPerSample > 4)) {
     throwError(ERR_NOT_SUPPORTED,
-               "Only 2 or 3 bytes per sample supported for AM824 mode");
+               "Only 2, 3 or 4 bytes per sample supported for AM824 mode");
   }
 
-  AM824Framer framer(userData->numChannels, userData->bytesPerSample * 8,
-                     AM824_LITTLE_ENDIAN, err);
+  // 32 bit integer and float samples are reduced to 24 bit by the framer
+  userData->framer = new AM824Framer(
+      userData->numChannels, userData->bytesPerSample * 8, AM824_LITTLE_ENDIAN,
+      err,
+      userData->waveFileFormat == FF_FLOAT32 ? AM824_INPUT_FLOAT
+                                             : AM824_INPUT_PCM);
+  AM824Framer& framer = *userData->framer;
   if (err != AM824_ERR_OK) {
     if (err == AM824_ERR_UNSUPPORTED_BITDEPTH) {
       throwError(ERR_NOT_SUPPORTED,
@@ -371,33 +592,282 @@ void am824Convert(UserData* userData, /* Input options */
   } else {
     framer.setConsumerMode();
   }
-  outputMemSize =
-      (userData->totalBytes * sizeof(uint32_t)) / userData->bytesPerSample;
-  *am824audio = malloc(outputMemSize);
-  outputPtr = (uint32_t*)*am824audio;
-  inputPtr = (uint8_t*)audio;
-
-  while (bytesConverted < userData->totalBytes) {
-    for (channel = 0; channel < userData->numChannels; channel++) {
-      if (userData->bytesPerSample == 3) {
-        inputSample32 = *((uint32_t*)inputPtr) & 0xffffff;
-        framer.getAM824Sample(inputSample32, (uint8_t*)outputPtr);
-      } else {
-        inputSample16 = *((uint16_t*)inputPtr);
-        framer.getAM824Sample(inputSample16, (uint8_t*)outputPtr);
-      }
-      outputPtr += 1;
-      inputPtr += userData->bytesPerSample;
-      bytesConverted += userData->bytesPerSample;
-    }
+  // Frame every channel pair as an independent AES3 stream
+  if (userData->am824_stream_channels &&
+      framer.setStreamChannels(userData->am824_stream_channels) !=
+          AM824_ERR_OK) {
+    throwError(ERR_NOT_SUPPORTED, "Cannot split %u channels in streams of %u",
+               userData->numChannels, userData->am824_stream_channels);
   }
   userData->totalBytes =
       (userData->totalBytes * sizeof(uint32_t)) / userData->bytesPerSample;
   userData->bytesPerSample = sizeof(uint32_t);
   userData->bitsPerSample = 32;
+  userData->waveFileFormat = FF_PCM;
   userData->blockAlign = userData->numChannels * userData->bytesPerSample;
 }
 
+/* Reader thread, reads the file in chunks, converts them to AM824 if
+ * required and feeds the ring buffer consumed by the callback */
+
+void readerThread(UserData* data) {
+  unsigned long fileChunkBytes = data->framesPerChunk * data->fileBlockAlign;
+  unsigned char* fileChunk = (unsigned char*)malloc(fileChunkBytes);
+  unsigned char* am824Chunk = NULL;
+  unsigned long bytesRead;
+  unsigned long frames;
+  uint64_t am824FrameIndex = 0;
+
+  if (data->framer) {
+    am824Chunk =
+        (unsigned char*)malloc(data->framesPerChunk * data->blockAlign);
+  }
+  if (!fileChunk || (data->framer && !am824Chunk)) {
+    throwError(ERR_NO_MEMORY, "Memory allocation failed");
+  }
+
+  while (!data->stopReader) {
+    if (ringFreeBytes(&data->ring) < data->framesPerChunk * data->blockAlign) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    bytesRead = read_wav_file_chunk(data, fileChunk, fileChunkBytes);
+    frames = bytesRead / data->fileBlockAlign;
+    if (frames == 0) {
+      if (data->loop && data->maxFrameIndex) {
+        seek_wav_file(data, 0);
+        continue;
+      }
+      break;
+    }
+    if (data->framer) {
+      // Frame by the position in the output stream, this keeps the channel
+      // status blocks aligned across seeks and loops
+      data->framer->getAM824FramesAt(fileChunk, am824Chunk, frames,
+                                     am824FrameIndex);
+      am824FrameIndex += frames;
+      ringWrite(&data->ring, am824Chunk, frames * data->blockAlign);
+    } else {
+      ringWrite(&data->ring, fileChunk, frames * data->blockAlign);
+    }
+  }
+
+  data->readerDone.store(1, std::memory_order_release);
+  free(fileChunk);
+  free(am824Chunk);
+}
+
+#if defined(__linux__)
+/* Open the ALSA device for mmap interleaved access with periodFrames
+ * frames per period, the driver interrupt period when aligned to the
+ * daemon tic_frame_size_at_1fs, and periods periods per buffer */
+
+void alsa_open(AlsaOutput* out,        /* Output ALSA stream */
+               const char* device,     /* Input ALSA device name */
+               UserData* data,         /* Input format */
+               unsigned int periodFrames, /* Input frames per period */
+               unsigned int periods)      /* Input periods per buffer */
+{
+  snd_pcm_hw_params_t* hwParams;
+  snd_pcm_sw_params_t* swParams;
+  snd_pcm_format_t format;
+  snd_pcm_uframes_t frames;
+  unsigned int rate = data->fs;
+  int err;
+
+  switch (data->bitsPerSample) {
+    case 8:
+      format = SND_PCM_FORMAT_U8;
+      break;
+    case 16:
+      format = SND_PCM_FORMAT_S16_LE;
+      break;
+    case 24:
+      format = SND_PCM_FORMAT_S24_3LE;
+      break;
+    default:
+      format = (data->waveFileFormat == FF_FLOAT32) ? SND_PCM_FORMAT_FLOAT_LE
+                                                    : SND_PCM_FORMAT_S32_LE;
+  }
+
+  err = snd_pcm_open(&out->pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
+  if (err < 0) {
+    throwError(ERR_NO_DEVICE, "Can't open ALSA device %s: %s", device,
+               snd_strerror(err));
+  }
+
+  snd_pcm_hw_params_alloca(&hwParams);
+  snd_pcm_hw_params_any(out->pcm, hwParams);
+  if ((err = snd_pcm_hw_params_set_access(out->pcm, hwParams,
+                                          SND_PCM_ACCESS_MMAP_INTERLEAVED)) <
+          0 ||
+      (err = snd_pcm_hw_params_set_format(out->pcm, hwParams, format)) < 0 ||
+      (err = snd_pcm_hw_params_set_channels(out->pcm, hwParams,
+                                            data->numChannels)) < 0 ||
+      (err = snd_pcm_hw_params_set_rate(out->pcm, hwParams, rate, 0)) < 0) {
+    throwError(ERR_NOT_SUPPORTED, "ALSA device %s doesn't support %s, %u "
+               "channels, %u Hz, mmap access: %s", device,
+               snd_pcm_format_name(format), data->numChannels, rate,
+               snd_strerror(err));
+  }
+  frames = periodFrames;
+  snd_pcm_hw_params_set_period_size_near(out->pcm, hwParams, &frames, NULL);
+  frames *= periods;
+  snd_pcm_hw_params_set_buffer_size_near(out->pcm, hwParams, &frames);
+  err = snd_pcm_hw_params(out->pcm, hwParams);
+  if (err < 0) {
+    throwError(ERR_NOT_SUPPORTED, "Can't set ALSA hw params: %s",
+               snd_strerror(err));
+  }
+  snd_pcm_hw_params_get_period_size(hwParams, &out->periodFrames, NULL);
+  snd_pcm_hw_params_get_buffer_size(hwParams, &out->bufferFrames);
+  if (out->periodFrames != periodFrames) {
+    printf("Warning: ALSA period is %lu frames instead of %u\n",
+           (unsigned long)out->periodFrames, periodFrames);
+  }
+
+  // Start once the buffer is full and wake up every period
+  snd_pcm_sw_params_alloca(&swParams);
+  snd_pcm_sw_params_current(out->pcm, swParams);
+  snd_pcm_sw_params_set_start_threshold(out->pcm, swParams,
+                                        out->bufferFrames);
+  snd_pcm_sw_params_set_avail_min(out->pcm, swParams, out->periodFrames);
+  err = snd_pcm_sw_params(out->pcm, swParams);
+  if (err < 0) {
+    throwError(ERR_NOT_SUPPORTED, "Can't set ALSA sw params: %s",
+               snd_strerror(err));
+  }
+
+  printf("ALSA device: %s\nperiod: %lu frames\nbuffer: %lu frames (%.2f "
+         "ms)\n",
+         device, (unsigned long)out->periodFrames,
+         (unsigned long)out->bufferFrames,
+         out->bufferFrames * 1000.0 / data->fs);
+}
+
+/* Recover from an xrun or a suspend, any other error is fatal */
+void alsa_recover(AlsaOutput* out, int err) {
+  if (err == -EPIPE) {
+    out->xruns++;
+  }
+  err = snd_pcm_recover(out->pcm, err, 1);
+  if (err < 0) {
+    throwError(ERR_NO_STREAM, "ALSA playback failed: %s", snd_strerror(err));
+  }
+}
+
+/* ALSA playback thread, fills the available periods with the same callbacks
+ * used by PortAudio, directly in the mmap areas of the device */
+
+void alsaPlaybackThread(AlsaOutput* out, UserData* data) {
+  PaStreamCallback* callback = data->audio ? playMappedCallback : playCallback;
+  const snd_pcm_channel_area_t* areas;
+  snd_pcm_uframes_t offset, frames;
+  snd_pcm_sframes_t avail, committed;
+  int result = paContinue;
+  int err;
+
+  if (out->rtPriority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = out->rtPriority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+      printf("Warning: can't set real time priority %d\n", out->rtPriority);
+    } else {
+      printf("RealTime Scheduling enabled, priority %d\n", out->rtPriority);
+    }
+  }
+
+  while (result == paContinue && !data->stopReader) {
+    avail = snd_pcm_avail_update(out->pcm);
+    if (avail < 0) {
+      alsa_recover(out, avail);
+      continue;
+    }
+    if ((snd_pcm_uframes_t)avail < out->periodFrames) {
+      err = snd_pcm_wait(out->pcm, 1000);
+      if (err < 0) {
+        alsa_recover(out, err);
+      }
+      continue;
+    }
+    // Write whole periods, in up to two parts at the buffer wrap around
+    avail -= avail % out->periodFrames;
+    while (avail > 0 && result == paContinue) {
+      frames = avail;
+      err = snd_pcm_mmap_begin(out->pcm, &areas, &offset, &frames);
+      if (err < 0) {
+        alsa_recover(out, err);
+        break;
+      }
+      result = callback(NULL,
+                        (unsigned char*)areas[0].addr +
+                            (areas[0].first + offset * areas[0].step) / 8,
+                        frames, NULL, 0, data);
+      committed = snd_pcm_mmap_commit(out->pcm, offset, frames);
+      if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+        alsa_recover(out, committed < 0 ? committed : -EPIPE);
+        break;
+      }
+      avail -= frames;
+    }
+  }
+
+  if (result == paComplete) {
+    // Short files may end before the buffer is full and the stream starts
+    if (snd_pcm_state(out->pcm) == SND_PCM_STATE_PREPARED) {
+      snd_pcm_start(out->pcm);
+    }
+    snd_pcm_drain(out->pcm);
+  } else {
+    snd_pcm_drop(out->pcm);
+  }
+  out->done.store(1, std::memory_order_release);
+}
+
+/* Play the file on an ALSA device bypassing PortAudio */
+
+void alsa_play(UserData* data,       /* Input options */
+               const char* device,   /* Input ALSA device name */
+               unsigned int periodFrames, /* Input frames per period */
+               unsigned int periods,      /* Input periods per buffer */
+               int rtPriority)            /* Input SCHED_FIFO priority */
+{
+  AlsaOutput out;
+  unsigned long xruns = 0;
+  unsigned long underruns = 0;
+  std::thread playback;
+
+  out.xruns = 0;
+  out.done = 0;
+  out.rtPriority = rtPriority;
+  alsa_open(&out, device, data, periodFrames, periods);
+  if (rtPriority > 0) {
+    // Avoid page faults in the playback thread, before it starts since
+    // locking stalls the process
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+  }
+
+  playback = std::thread(alsaPlaybackThread, &out, data);
+
+  printf("Waiting for playback to finish.\n");
+  fflush(stdout);
+  while (!out.done.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (out.xruns != xruns || data->underruns != underruns) {
+      xruns = out.xruns;
+      underruns = data->underruns;
+      printf("Xruns: %lu, underruns: %lu, frames played: %lu\n", xruns,
+             underruns, (unsigned long)data->framesPlayed);
+      fflush(stdout);
+    }
+  }
+  playback.join();
+  snd_pcm_close(out.pcm);
+  printf("\nXruns: %lu\n", (unsigned long)out.xruns);
+}
+#endif
+
 void list_devices(void) {
   int i, numDevices, defaultDisplayed;
   const PaDeviceInfo* deviceInfo;
@@ -494,6 +964,10 @@ void print_usage(void) {
           "-buf <samples>       Playout buffer size in frames (samples x "
           "channels)\n");
   fprintf(stderr, "-d <index>           Device index to use for playback\n");
+  fprintf(stderr,
+          "-start <seconds>     Start playback at the specified position\n");
+  fprintf(stderr,
+          "-loop                Play the file in a loop until interrupted\n");
   fprintf(stderr,
           "-am824               Using virtual sound card feeding an "
           "AM824/2110-31 stream\n");
@@ -502,11 +976,24 @@ void print_usage(void) {
           "switch to modify channel status:\n");
   fprintf(stderr,
           "    audio, nonaudio, fs_not_indicated, fs_48k, fs_441k, fs_32k, "
-          "professional, consumer\n");
+          "professional, consumer, pairs\n");
 #if defined(_WIN32) || defined(_WIN64)
   fprintf(stderr,
           "-e <index>           Uses WASPI exclusive mode if selected device "
           "is a WASAPI device\n");
+#endif
+#if defined(__linux__)
+  fprintf(stderr,
+          "-alsa <device>       Play directly on an ALSA device using mmap "
+          "access, e.g. hw:RAVENNA\n");
+  fprintf(stderr,
+          "-tic <frames>        ALSA period at 1FS, set to the daemon "
+          "tic_frame_size_at_1fs, default 48\n");
+  fprintf(stderr,
+          "-periods <periods>   ALSA periods per buffer, default 4\n");
+  fprintf(stderr,
+          "-rt <priority>       SCHED_FIFO priority of the ALSA playback "
+          "thread\n");
 #endif
   fprintf(stderr, "\n");
 }
@@ -518,22 +1005,37 @@ int main(int argc, char* argv[]) {
   PaError err = paNoError;
   UserData data;
   int i;
-  unsigned long bytesRead;
   unsigned int framesPerBuffer = 128;
   float userLatency = 0.0;
+  float startPosition = 0.0;
+  unsigned long startFrame;
   char playbackWavFileName[256] = "";
   double sampleRate = 48000.0;
   double startTime/*,finishTime*/;
-  void* audio;
+  std::thread reader;
+  unsigned long ringFrames;
+  unsigned long underruns = 0;
 #if defined(_WIN32) || defined(_WIN64)
   struct PaWasapiStreamInfo wasapiInfo;
   int waspiExclusiveMode = 0;
+#endif
+  const char* alsaDevice = NULL;
+#if defined(__linux__)
+  unsigned int ticFrameSizeAt1fs = 48;
+  unsigned int alsaPeriods = 4;
+  int rtPriority = 0;
 #endif
   unsigned int am824Mode = 0;
-  void* am824audio;
 
   outputParameters.device = paNoDevice;
-  audio = NULL;
+  data.framer = NULL;
+  data.audio = NULL;
+  data.mapAddr = NULL;
+  data.loop = 0;
+  data.framesPlayed = 0;
+  data.readerDone = 0;
+  data.stopReader = 0;
+  data.underruns = 0;
 
   err = Pa_Initialize();
 
@@ -566,6 +1068,39 @@ int main(int argc, char* argv[]) {
     else if (!strcmp(argv[i], "-e")) {
       waspiExclusiveMode = 1;
     }
+#endif
+#if defined(__linux__)
+    else if (!strcmp(argv[i], "-alsa")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_NO_DEVICE, "Can't find ALSA device");
+      }
+      alsaDevice = argv[++i];
+    } else if (!strcmp(argv[i], "-tic")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find tic frame size");
+      }
+      ticFrameSizeAt1fs = atoi(argv[++i]);
+      if (ticFrameSizeAt1fs == 0) {
+        throwError(ERR_BAD_CMD_OPTION, "Bad tic frame size");
+      }
+    } else if (!strcmp(argv[i], "-periods")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find number of periods");
+      }
+      alsaPeriods = atoi(argv[++i]);
+      if (alsaPeriods < 2) {
+        throwError(ERR_BAD_CMD_OPTION, "At least 2 periods required");
+      }
+    } else if (!strcmp(argv[i], "-rt")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find real time priority");
+      }
+      rtPriority = atoi(argv[++i]);
+    }
 #endif
     else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help") ||
              !strcmp(argv[i], "--help")) {
@@ -589,6 +1124,17 @@ int main(int argc, char* argv[]) {
       // We increment i here to step over the next parameter
       // which has been parsed as the value
       i++;
+    } else if (!strcmp(argv[i], "-start")) {
+      if (i == (argc - 1)) {
+        print_usage();
+        throwError(ERR_BAD_CMD_OPTION, "Can't find start position");
+      }
+      startPosition = atof(argv[i + 1]);
+      // We increment i here to step over the next parameter
+      // which has been parsed as the value
+      i++;
+    } else if (!strcmp(argv[i], "-loop")) {
+      data.loop = 1;
     } else if (!strcmp(argv[i], "-ld")) {
       list_devices();
       exit(0);
@@ -597,6 +1143,7 @@ int main(int argc, char* argv[]) {
       data.am824_audio = 1;
       data.am824_professional = 0;
       data.am824_fs_match_wavfile = 1;
+      data.am824_stream_channels = 0;
       i++;
       while ((i < argc) && (argv[i][0] != '-')) {
         if (!strcmp(argv[i], "audio")) {
@@ -620,6 +1167,8 @@ int main(int argc, char* argv[]) {
           data.am824_professional = 1;
         } else if (!strcmp(argv[i], "consumer")) {
           data.am824_professional = 0;
+        } else if (!strcmp(argv[i], "pairs")) {
+          data.am824_stream_channels = 2;
         } else {
           break;
         }
@@ -636,28 +1185,19 @@ int main(int argc, char* argv[]) {
     throwError(ERR_BAD_WAV_FORMAT, "Bad wav header");
   }
 
-  audio = malloc(data.totalBytes);
-  if (!audio) {
-    throwError(ERR_NO_MEMORY, "Memory allocation failed");
-  }
-
-  bytesRead = read_entire_wav_file(&data, audio);
-  if (bytesRead != data.totalBytes) {
-    throwError(ERR_INCOMPLETE_INPUT_FILE, "Couldn't read all input data");
-  }
+  data.fileBlockAlign = data.blockAlign;
+  data.fileBytesLeft = data.totalBytes;
 
   if (am824Mode) {
     printf("AM824 output mode selected\n");
-    am824Convert(&data, audio, &am824audio);
-    free(audio);
-    audio = am824audio;
+    am824Setup(&data);
   }
 
-  if (outputParameters.device == paNoDevice) {
+  if (!alsaDevice && outputParameters.device == paNoDevice) {
     outputParameters.device = Pa_GetDefaultOutputDevice();
   }
 
-  if (outputParameters.device == paNoDevice) {
+  if (!alsaDevice && outputParameters.device == paNoDevice) {
     throwError(ERR_NO_DEVICE, "No default output device");
   }
 
@@ -684,7 +1224,7 @@ int main(int argc, char* argv[]) {
 
   if (userLatency > 0.0) {
     outputParameters.suggestedLatency = userLatency;
-  } else {
+  } else if (!alsaDevice) {
     outputParameters.suggestedLatency =
         Pa_GetDeviceInfo(outputParameters.device)->defaultHighOutputLatency;
   }
@@ -729,37 +1269,88 @@ int main(int argc, char* argv[]) {
 
   outputParameters.channelCount = data.numChannels;
   sampleRate = (double)data.fs;
-  err = Pa_IsFormatSupported(NULL, &outputParameters, sampleRate);
-  if (err != paNoError) {
-    throwError(ERR_NOT_SUPPORTED, "Pa_IsFormatSupported returned %d, %s", err,
-               Pa_GetErrorText(err));
-  }
+#if defined(__linux__)
+  if (alsaDevice) {
+    // The driver runs one tic per period, the tic is given at 1FS
+    framesPerBuffer = ticFrameSizeAt1fs * (data.fs >= 88200 ? data.fs / 44100
+                                                            : 1);
+  } else
+#endif
+  {
+    err = Pa_IsFormatSupported(NULL, &outputParameters, sampleRate);
+    if (err != paNoError) {
+      throwError(ERR_NOT_SUPPORTED, "Pa_IsFormatSupported returned %d, %s",
+                 err, Pa_GetErrorText(err));
+    }
 
-  printf("Pa_IsFormatSupported succeeded\n");
+    printf("Pa_IsFormatSupported succeeded\n");
 
-  printf(
-      "device: %u\nchannels: %u\nsampleFormat: %lu\nlatency: %f\nsampleRate: "
-      "%u\n",
-      outputParameters.device, outputParameters.channelCount,
-      outputParameters.sampleFormat, outputParameters.suggestedLatency,
-      data.fs);
+    printf(
+        "device: %u\nchannels: %u\nsampleFormat: %lu\nlatency: "
+        "%f\nsampleRate: %u\n",
+        outputParameters.device, outputParameters.channelCount,
+        outputParameters.sampleFormat, outputParameters.suggestedLatency,
+        data.fs);
+  }
+
+#if !defined(_WIN32) && !defined(_WIN64)
+  // Plain PCM samples are played directly from the mapped file
+  if (!am824Mode && !map_wav_file_data(playbackWavFileName, &data)) {
+    printf("Playing from memory mapped file\n");
+  }
+#endif
 
   // Set callback parameters
-  data.frameIndex = 0; /* Index into sample array. */
   data.maxFrameIndex = (unsigned long)data.totalBytes / data.blockAlign;
-  data.audio = (unsigned char*)audio;
+  startFrame = (unsigned long)(startPosition * data.fs);
+  if (startPosition < 0.0 || (startFrame && startFrame >= data.maxFrameIndex)) {
+    throwError(ERR_BAD_CMD_OPTION, "Start position %f out of range",
+               startPosition);
+  }
+  data.frameIndex = startFrame; /* Index into sample array. */
+
+  data.ring.buffer = NULL;
+  if (!data.audio) {
+    // Buffer one second of audio, read and converted in chunks, so memory
+    // use doesn't depend on the file length
+    ringFrames = data.fs;
+    if (ringFrames < 8 * framesPerBuffer) {
+      ringFrames = 8 * framesPerBuffer;
+    }
+    data.framesPerChunk = ringFrames / 8;
+    if (startFrame) {
+      seek_wav_file(&data, startFrame);
+    }
+    if (!ringInit(&data.ring, (uint64_t)ringFrames * data.blockAlign)) {
+      throwError(ERR_NO_MEMORY, "Memory allocation failed");
+    }
+    reader = std::thread(readerThread, &data);
+    // Wait for the ring buffer to fill up before starting the playback
+    while (!data.readerDone &&
+           ringFreeBytes(&data.ring) >= data.framesPerChunk * data.blockAlign) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
 
   printf("\n=== Now playing back. ===\n");
   fflush(stdout);
-  err = Pa_OpenStream(&stream, NULL, /* no input */
-                      &outputParameters, data.fs, framesPerBuffer,
-                      paClipOff, /* we won't output out of range samples so
-                                    don't bother clipping them */
-                      playCallback, &data);
-  if (err != paNoError) {
-    Pa_Terminate();
-    throwError(ERR_NO_STREAM, "Pa_OpenStream returned %d, %s", err,
-               Pa_GetErrorText(err));
+  stream = NULL;
+#if defined(__linux__)
+  if (alsaDevice) {
+    alsa_play(&data, alsaDevice, framesPerBuffer, alsaPeriods, rtPriority);
+  } else
+#endif
+  {
+    err = Pa_OpenStream(&stream, NULL, /* no input */
+                        &outputParameters, data.fs, framesPerBuffer,
+                        paClipOff, /* we won't output out of range samples so
+                                      don't bother clipping them */
+                        data.audio ? playMappedCallback : playCallback, &data);
+    if (err != paNoError) {
+      Pa_Terminate();
+      throwError(ERR_NO_STREAM, "Pa_OpenStream returned %d, %s", err,
+                 Pa_GetErrorText(err));
+    }
   }
 
   if (stream) {
@@ -784,6 +1375,11 @@ int main(int argc, char* argv[]) {
     //finishTime = data.maxFrameIndex / data.fs;
     while ((err = Pa_IsStreamActive(stream)) == 1) {
       Pa_Sleep(1000);
+      if (data.underruns != underruns) {
+        underruns = data.underruns;
+        printf("Underruns: %lu\n", underruns);
+        fflush(stdout);
+      }
     }
     printf("\n");
 
@@ -800,9 +1396,15 @@ int main(int argc, char* argv[]) {
     fflush(stdout);
   }
 
-  if (audio) {
-    free(audio);
+  data.stopReader = 1;
+  if (reader.joinable()) {
+    reader.join();
   }
+  close_wav_file(&data);
+  printf("Frames played: %lu, underruns: %lu\n",
+         (unsigned long)data.framesPlayed, (unsigned long)data.underruns);
+  free(data.ring.buffer);
+  delete data.framer;
   Pa_Terminate();
   exit(0);
 }